@@ -0,0 +1,503 @@
+/*
+ * Times the DSP kernels on burst and frame sized input made with modulate()
+ * and checks the faster variants of some of them against the plain ones.
+ *
+ * For each kernel it prints the time per call, samples per second and, on
+ * x86, time stamp counter cycles per sample.  With -j the results are written
+ * as JSON so they can be kept and compared between builds.  The exit status
+ * is 1 if a check fails.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <math.h>
+#include <sys/time.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "gsm_bursts.h"
+#include "usrp_complex.h"
+#include "dsp.h"
+#include "mtsc.h"
+#include "nco.h"
+#include "sch.h"
+#include "fcch_detector.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+typedef struct {
+	const char *	name;
+	void		(*fn)();
+	const unsigned int *samples;	// input samples per call
+} bench_s;
+
+typedef struct {
+	const char *	name;
+	double		(*fn)();	// returns the largest relative error
+	double		tolerance;
+} check_s;
+
+static const float		SNR		= 100.0;
+static const unsigned int	CR_LEN		= 6;	// as demod_burst
+static const unsigned int	DFE_LEN		= 5;
+static const unsigned int	SEARCH		= 16;	// symbols either side for the windowed correlations
+static const unsigned int	H_LEN		= 2 * CR_LEN - 1;
+static const unsigned int	SOFT_LEN	= SB_EDATA_OS_2 + SB_EDATA_LEN_2;
+static const unsigned int	FILTER_LEN	= 21;	// as delay
+
+static float			g_sps;
+static unsigned char		g_bits[51 * 1250];	// a 51-multiframe with frequency bursts
+
+static complex *		g_burst;	// one synchronization burst
+static unsigned int		g_burst_len;
+static complex *		g_frames;	// 12 frames and a burst
+static unsigned int		g_frames_len;
+static complex *		g_tsc;		// modulated synchronization sequence
+static unsigned int		g_tsc_len;
+static complex *		g_corr;		// g_burst correlated with g_tsc
+static complex			g_filter[FILTER_LEN];
+static complex			g_h[H_LEN];	// symbol spaced channel
+static complex *		g_v;		// matched filter output
+static unsigned int		g_v_len;
+static complex			*g_ff, *g_fb;
+static unsigned int		g_ff_len, g_fb_len;
+static float			g_soft[SOFT_LEN];
+static complex *		g_work;
+static fcch_detector *		g_fcch;
+static nco *			g_nco;
+
+// keeps the compiler from dropping results
+static volatile float		g_sink;
+
+
+static double now() {
+
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+static unsigned long long ticks() {
+
+#ifdef HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+static void bench_correlate_nodelay() {
+
+	complex *y;
+
+	y = correlate_nodelay(g_burst, g_burst_len, g_tsc, g_tsc_len, 0);
+	g_sink = y[0].real();
+	delete[] y;
+}
+
+
+static unsigned int window_os() {
+
+	return (unsigned int)((SB_ETS_OS + SB_CODE_LEN / 2 - SEARCH) * g_sps);
+}
+
+
+static void bench_correlate_nodelay_window() {
+
+	complex *y;
+
+	y = correlate_nodelay_window(g_burst, g_burst_len, g_tsc, g_tsc_len, window_os(), (unsigned int)(2 * SEARCH * g_sps), 0);
+	g_sink = y[0].real();
+	delete[] y;
+}
+
+
+static void bench_correlate_bits_nodelay_window() {
+
+	const unsigned char *bv = sb_etsc;
+
+	correlate_bits_nodelay_window(g_work, g_burst, g_burst_len, &bv, 1, SB_CODE_LEN, SB_ETS_OS, g_sps, window_os(), (unsigned int)(2 * SEARCH * g_sps));
+	g_sink = g_work[0].real();
+}
+
+
+static void bench_convolve() {
+
+	complex *y;
+
+	y = convolve(g_burst, g_burst_len, g_filter, FILTER_LEN, 0);
+	g_sink = y[0].real();
+	delete[] y;
+}
+
+
+static void bench_delay() {
+
+	memcpy(g_work, g_burst, g_burst_len * sizeof(complex));
+	delay(g_work, g_burst_len, 2.37);
+	g_sink = g_work[0].real();
+}
+
+
+static void bench_peak_detect() {
+
+	complex peak;
+	float avg_power;
+
+	g_sink = peak_detect(g_corr, g_burst_len, &peak, &avg_power);
+}
+
+
+static void bench_design_DFE() {
+
+	complex *ff, *fb;
+	unsigned int ff_len, fb_len;
+
+	design_DFE(g_h, H_LEN, SNR, H_LEN, &ff, &ff_len, &fb, &fb_len);
+	g_sink = ff[0].real();
+	delete[] ff;
+	delete[] fb;
+}
+
+
+static void bench_equalize() {
+
+	float *b;
+	unsigned int b_len;
+
+	memcpy(g_work, g_v, g_v_len * sizeof(complex));
+	b = equalize(g_work, g_v_len, g_ff, g_ff_len, g_fb, g_fb_len, &b_len);
+	g_sink = b[0];
+	delete[] b;
+}
+
+
+static void bench_fcch_scan() {
+
+	float offset;
+	unsigned int consumed;
+
+	g_fcch->scan(g_frames, g_frames_len, &offset, &consumed);
+	g_sink = offset;
+}
+
+
+static void bench_decode_sch_soft() {
+
+	int fn, bsic;
+
+	decode_sch_soft(g_soft, &fn, &bsic);
+	g_sink = fn;
+}
+
+
+static void bench_nco_mix() {
+
+	memcpy(g_work, g_frames, g_frames_len * sizeof(complex));
+	g_nco->mix(g_work, g_frames_len);
+	g_sink = g_work[0].real();
+}
+
+
+static double max_error(const complex *a, const complex *b, const unsigned int len) {
+
+	unsigned int i;
+	double e = 0.0, scale = 0.0;
+
+	for(i = 0; i < len; i++) {
+		if(abs(a[i] - b[i]) > e)
+			e = abs(a[i] - b[i]);
+		if(abs(a[i]) > scale)
+			scale = abs(a[i]);
+	}
+	return (scale > 0.0)? e / scale : e;
+}
+
+
+/*
+ * correlate_nodelay_window over the whole burst is correlate_nodelay.
+ */
+static double check_correlate_nodelay_window() {
+
+	double e;
+	complex *y, *r;
+
+	r = correlate_nodelay(g_burst, g_burst_len, g_tsc, g_tsc_len, 0);
+	y = correlate_nodelay_window(g_burst, g_burst_len, g_tsc, g_tsc_len, 0, g_burst_len, 0);
+	e = max_error(r, y, g_burst_len);
+	delete[] y;
+	delete[] r;
+	return e;
+}
+
+
+/*
+ * correlate_bits_nodelay_window against correlating with the modulated bits.
+ */
+static double check_correlate_bits_nodelay_window() {
+
+	unsigned int os, len;
+	double e;
+	const unsigned char *bv = sb_etsc;
+	complex *r;
+
+	os = window_os();
+	len = (unsigned int)(2 * SEARCH * g_sps);
+	r = correlate_nodelay_window(g_burst, g_burst_len, g_tsc, g_tsc_len, os, len, 0);
+	if(correlate_bits_nodelay_window(g_work, g_burst, g_burst_len, &bv, 1, SB_CODE_LEN, SB_ETS_OS, g_sps, os, len)) {
+		delete[] r;
+		return HUGE_VAL;
+	}
+	e = max_error(r + os, g_work + os, len);
+	delete[] r;
+	return e;
+}
+
+
+/*
+ * The table driven nco against mixing with exp().
+ */
+static double check_nco_mix() {
+
+	unsigned int i;
+	double e, w;
+	complex *r;
+	nco n(g_sps * GSM_RATE);
+
+	n.set_freq(1234.5);
+	r = new complex[g_frames_len];
+	memcpy(g_work, g_frames, g_frames_len * sizeof(complex));
+	n.mix(g_work, g_frames_len);
+	w = -2.0 * M_PI * 1234.5 / (g_sps * GSM_RATE);
+	for(i = 0; i < g_frames_len; i++)
+		r[i] = g_frames[i] * complex(cos(w * i), sin(w * i));
+	e = max_error(r, g_work, g_frames_len);
+	delete[] r;
+	return e;
+}
+
+
+static const bench_s benches[] = {
+	{"correlate_nodelay", bench_correlate_nodelay, &g_burst_len},
+	{"correlate_nodelay_window", bench_correlate_nodelay_window, &g_burst_len},
+	{"correlate_bits_nodelay_window", bench_correlate_bits_nodelay_window, &g_burst_len},
+	{"convolve", bench_convolve, &g_burst_len},
+	{"delay", bench_delay, &g_burst_len},
+	{"peak_detect", bench_peak_detect, &g_burst_len},
+	{"design_DFE", bench_design_DFE, &H_LEN},
+	{"equalize", bench_equalize, &g_v_len},
+	{"fcch_detector::scan", bench_fcch_scan, &g_frames_len},
+	{"decode_sch_soft", bench_decode_sch_soft, &SOFT_LEN},
+	{"nco::mix", bench_nco_mix, &g_frames_len}
+};
+static const unsigned int BENCHES_LEN = sizeof(benches) / sizeof(benches[0]);
+
+static const check_s checks[] = {
+	{"correlate_nodelay_window", check_correlate_nodelay_window, 1e-5},
+	{"correlate_bits_nodelay_window", check_correlate_bits_nodelay_window, 1e-3},
+	{"nco::mix", check_nco_mix, 4e-3}	// the phase table has 4096 entries
+};
+static const unsigned int CHECKS_LEN = sizeof(checks) / sizeof(checks[0]);
+
+
+static int setup(const float sps) {
+
+	unsigned int i, len;
+	float toa;
+	complex *m;
+
+	g_sps = sps;
+
+	// random bits with a frequency burst on time slot 0 every 10 frames
+	srand(1);
+	for(i = 0; i < sizeof(g_bits); i++)
+		g_bits[i] = rand() & 1;
+	for(i = 0; i < 50; i += 10)
+		memset(g_bits + i * 1250 + 3, 0, 142);
+
+	// a synchronization burst
+	memcpy(g_bits + 1250 + SB_ETS_OS, sb_etsc, SB_CODE_LEN);
+	if(!(g_burst = modulate(g_bits + 1250, 156, 0, sps, &g_burst_len)))
+		return -1;
+	if(!(g_frames = modulate(g_bits, (unsigned int)ceil(12 * FRAME_LEN + BURST_LEN), 0, sps, &g_frames_len)))
+		return -1;
+	if(!(g_tsc = generate_modulated_tsc(sps, sb_etsc, SB_CODE_LEN, SB_ETS_OS, &toa, 0, &g_tsc_len)))
+		return -1;
+	if(!(g_corr = correlate_nodelay(g_burst, g_burst_len, g_tsc, g_tsc_len, &len)))
+		return -1;
+
+	len = (g_frames_len > g_burst_len)? g_frames_len : g_burst_len;
+	g_work = new complex[len];
+
+	for(i = 0; i < FILTER_LEN; i++)
+		g_filter[i] = sinc(M_PI * (i - (FILTER_LEN - 1) / 2.0 - 0.37));
+
+	// a mild two path channel, main tap 1, symmetric as after the matched filter
+	for(i = 0; i < H_LEN; i++)
+		g_h[i] = 0.0;
+	g_h[CR_LEN - 1] = 1.0;
+	g_h[CR_LEN - 2] = g_h[CR_LEN] = complex(0.3, 0.1);
+	g_h[CR_LEN - 3] = g_h[CR_LEN + 1] = complex(0.05, -0.02);
+	if(design_DFE(g_h, H_LEN, SNR, (DFE_LEN > H_LEN)? DFE_LEN : H_LEN, &g_ff, &g_ff_len, &g_fb, &g_fb_len))
+		return -1;
+
+	// symbol spaced input for the equalizer: the burst through the channel
+	g_v_len = DATA_LEN + H_LEN - 1;
+	if(!(m = modulate(g_bits + 1250 + 3, g_v_len, 0, 1.0, &len)))
+		return -1;
+	g_v = new complex[len];
+	convolve_nodelay(g_v, m, len, g_h, H_LEN);
+	delete[] m;
+
+	for(i = 0; i < SOFT_LEN; i++)
+		g_soft[i] = g_bits[1250 + 3 + i]? -1.0 : 1.0;
+
+	try {
+		g_fcch = new fcch_detector(sps * GSM_RATE);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	g_nco = new nco(sps * GSM_RATE);
+	g_nco->set_freq(1234.5);
+
+	return 0;
+}
+
+
+/*
+ * Run a kernel until min_time seconds have passed, doubling the calls each
+ * time round.
+ */
+static void run(const bench_s *b, const double min_time, unsigned long long *calls_o,
+   double *seconds_o, unsigned long long *ticks_o) {
+
+	unsigned long long calls, i, t;
+	double start, elapsed;
+
+	b->fn();
+	for(calls = 1; ; calls *= 2) {
+		start = now();
+		t = ticks();
+		for(i = 0; i < calls; i++)
+			b->fn();
+		t = ticks() - t;
+		elapsed = now() - start;
+		if(elapsed >= min_time)
+			break;
+	}
+	*calls_o = calls;
+	*seconds_o = elapsed;
+	*ticks_o = t;
+}
+
+
+static void usage(char *prog) {
+
+	printf("Usage:\n");
+	printf("\t%s [options]\n", basename(prog));
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-S <sps>\tsamples per symbol (1, 2 or 4), defaults to 1\n");
+	printf("\t-t <sec>\tminimum time per kernel, defaults to 0.5\n");
+	printf("\t-k <name>\tonly run kernels whose name contains this\n");
+	printf("\t-j\t\twrite JSON\n");
+	printf("\t-h\t\thelp\n");
+	exit(-1);
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, json = 0, failed = 0, first = 1;
+	unsigned int i, samples;
+	unsigned long long calls, t;
+	float sps = 1.0;
+	double min_time = 0.5, seconds, ns, e;
+	const char *only = 0;
+
+	while((c = getopt(argc, argv, "S:t:k:jh?")) != EOF) {
+		switch(c) {
+			case 'S':
+				sps = strtod(optarg, 0);
+				if((sps != 1.0) && (sps != 2.0) && (sps != 4.0))
+					usage(argv[0]);
+				break;
+
+			case 't':
+				if((min_time = strtod(optarg, 0)) <= 0.0)
+					usage(argv[0]);
+				break;
+
+			case 'k':
+				only = optarg;
+				break;
+
+			case 'j':
+				json = 1;
+				break;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+
+	if(build_rotators() || setup(sps)) {
+		fprintf(stderr, "error: setup\n");
+		return -1;
+	}
+
+	if(json)
+		printf("{\n\t\"sps\": %g,\n\t\"benchmarks\": [", sps);
+	for(i = 0; i < BENCHES_LEN; i++) {
+		if(only && (!strstr(benches[i].name, only)))
+			continue;
+		samples = *benches[i].samples;
+		run(&benches[i], min_time, &calls, &seconds, &t);
+		ns = seconds * 1e9 / calls;
+
+		if(json) {
+			printf("%s\n\t\t{\"name\": \"%s\", \"samples\": %u, \"calls\": %llu, \"ns_per_call\": %.1f, \"samples_per_s\": %.0f, \"cycles_per_sample\": ",
+			   first? "" : ",", benches[i].name, samples, calls, ns, samples * 1e9 / ns);
+			if(t)
+				printf("%.2f}", (double)t / calls / samples);
+			else
+				printf("null}");
+		} else {
+			printf("%-32s%12.1f ns/call%10.2f Msps", benches[i].name, ns, samples * 1e3 / ns);
+			if(t)
+				printf("%10.2f cycles/sample", (double)t / calls / samples);
+			printf("\n");
+		}
+		first = 0;
+	}
+
+	if(json)
+		printf("\n\t],\n\t\"checks\": [");
+	else
+		printf("\n");
+	for(i = 0; i < CHECKS_LEN; i++) {
+		e = checks[i].fn();
+		if(e > checks[i].tolerance)
+			failed = 1;
+		if(json)
+			printf("%s\n\t\t{\"name\": \"%s\", \"max_error\": %g, \"pass\": %s}", i? "," : "", checks[i].name, e, (e > checks[i].tolerance)? "false" : "true");
+		else
+			printf("check %-32s max error %10.3g  %s\n", checks[i].name, e, (e > checks[i].tolerance)? "FAILED" : "ok");
+	}
+	if(json)
+		printf("\n\t]\n}\n");
+
+	return failed;
+}
@@ -0,0 +1,305 @@
+/*
+ * Runs the receiver on carriers made by synth_source, with no device.
+ *
+ * Each trial starts a carrier with a random BSIC, frame number, position in
+ * the frame, carrier phase, SNR and carrier offset, optionally through a
+ * fading channel and with the sample clock drifting, and acquires it with
+ * camp_acquire, i.e., fcch_detector::scan in get_burst_sch, then the SCH
+ * demodulated and decoded.  The time to the first SCH is counted both in
+ * signal (how long a receiver on the air would wait) and in CPU time.  Once
+ * acquired, the trial camps for a number of frames and every burst is
+ * demodulated as layer1_usrp -C would.  Time slots 1-7 are fully loaded so
+ * there is a normal burst to demodulate on each.
+ *
+ * The real-time factor is the signal time camped over the CPU time it took,
+ * not counting the time spent making the signal.  Its whole part is the
+ * number of carriers this build keeps up with on one core.  With -j the
+ * results are written as JSON.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <math.h>
+#include <sys/time.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "dsp.h"
+#include "mtsc.h"
+#include "gsm_demod.h"
+#include "camp.h"
+#include "util.h"
+#include "synth_source.h"
+
+typedef struct {
+	int		bsic;
+	int		fn;
+	float		snr;		// dB
+	float		offset;		// Hz
+	int		acquired;	// the clock agrees with the carrier
+	float		sync_signal;	// seconds of signal to the first SCH
+	float		sync_cpu;	// CPU seconds to the first SCH
+	float		camp_signal;	// seconds of signal camped on
+	float		camp_cpu;	// CPU seconds camping
+	unsigned int	bursts;		// demodulated while camping
+	int		lost;		// camp lost synchronization
+} trial_s;
+
+
+static double now() {
+
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+static double uniform(unsigned int *seed) {
+
+	return (double)rand_r(seed) / RAND_MAX;
+}
+
+
+static void count_burst(void *ctx, const int, const int, const float,
+   const float, const llr_t *, const unsigned int) {
+
+	*(unsigned int *)ctx += 1;
+}
+
+
+static int run_trial(const float sps, const mtsc_s *m, unsigned int *seed,
+   const float snr_lo, const float snr_hi, const float max_offset,
+   const char *channel, const float drift, const unsigned int frames,
+   trial_s *t) {
+
+	int fn, bsic, ts, c_fn, c_ts, r;
+	unsigned int skip;
+	double start, gen, pos;
+	synth_source *s;
+
+	memset(t, 0, sizeof(*t));
+	t->bsic = rand_r(seed) & 0x3f;
+	t->fn = rand_r(seed) % MAX_FN;
+	t->snr = snr_lo + (snr_hi - snr_lo) * uniform(seed);
+	t->offset = max_offset * (2.0 * uniform(seed) - 1.0);
+	skip = rand_r(seed) % (unsigned int)(sps * FRAME_LEN);
+
+	try {
+		s = new synth_source(sps * GSM_RATE, t->bsic, rand_r(seed));
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	if(s->set_channel(channel)) {
+		delete s;
+		return -1;
+	}
+	s->set_snr(t->snr);
+	s->set_offset(t->offset);
+	s->set_drift(drift);
+	s->set_load(1.0);
+	s->set_frame(t->fn, skip);
+
+	start = now();
+	gen = s->gen_time();
+	r = camp_acquire(s, m, &fn, &bsic);
+	t->sync_cpu = now() - start - (s->gen_time() - gen);
+	t->sync_signal = s->position() / s->sample_rate();
+
+	// the middle of the next frame's first burst, by the clock
+	if(!r && (bsic == t->bsic) && !s->get_fn_ts(&c_fn, &c_ts)) {
+		c_fn = (c_fn + 1) % MAX_FN;
+		pos = s->get_clock()->burst_pos(c_fn, 0) + s->get_clock()->sps() * BURST_LEN / 2;
+		t->acquired = (s->frame_at(pos, &ts) == c_fn) && !ts;
+	}
+
+	if(t->acquired && frames) {
+		start = now();
+		gen = s->gen_time();
+		pos = s->position() - s->get_buffer()->data_available();
+		r = camp(s, bsic, count_burst, &t->bursts, frames);
+		t->camp_cpu = now() - start - (s->gen_time() - gen);
+		t->camp_signal = (s->position() - s->get_buffer()->data_available() - pos) / s->sample_rate();
+		if(r < 0) {
+			delete s;
+			return -1;
+		}
+		t->lost = (r == 1);
+	}
+
+	delete s;
+	return 0;
+}
+
+
+/*
+ * The value a fraction q of the way through sorted values.
+ */
+static float quantile(const float *v, const unsigned int len, const float q) {
+
+	unsigned int i;
+
+	if(!len)
+		return 0.0;
+	i = (unsigned int)(q * (len - 1) + 0.5);
+	return v[(i < len)? i : len - 1];
+}
+
+
+static void print_dist(const char *name, float *v, const unsigned int len, const int json) {
+
+	sort(v, len);
+	if(json)
+		printf("\t\"%s\": {\"min\": %.4f, \"median\": %.4f, \"p90\": %.4f, \"max\": %.4f},\n",
+		   name, quantile(v, len, 0.0), quantile(v, len, 0.5), quantile(v, len, 0.9), quantile(v, len, 1.0));
+	else
+		printf("%-24s%10.1f%10.1f%10.1f%10.1f ms\n", name,
+		   1e3 * quantile(v, len, 0.0), 1e3 * quantile(v, len, 0.5), 1e3 * quantile(v, len, 0.9), 1e3 * quantile(v, len, 1.0));
+}
+
+
+static void usage(char *prog) {
+
+	printf("Usage:\n");
+	printf("\t%s [options]\n", basename(prog));
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-S <sps>\tsamples per symbol (1, 2 or 4), defaults to 1\n");
+	printf("\t-n <trials>\tnumber of carriers to acquire, defaults to 20\n");
+	printf("\t-s <lo[:hi]>\tSNR range in dB, defaults to 6:30\n");
+	printf("\t-o <Hz>\t\tlargest carrier offset, defaults to 20000\n");
+	printf("\t-p <profile>\tchannel, e.g., TU50 or HT100, defaults to static\n");
+	printf("\t-d <ppm>\tsample clock error, defaults to 0\n");
+	printf("\t-F <frames>\tframes to camp on each carrier, defaults to 204\n");
+	printf("\t-r <seed>\trandom seed, defaults to 1\n");
+	printf("\t-M\t\tequalize with MLSE instead of a DFE\n");
+	printf("\t-j\t\twrite JSON\n");
+	printf("\t-h\t\thelp\n");
+	exit(-1);
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, json = 0;
+	unsigned int i, n = 20, frames = 204, seed = 1, acquired = 0, lost = 0, bursts = 0;
+	float sps = 1.0, snr_lo = 6.0, snr_hi = 30.0, max_offset = 20000.0, drift = 0.0, *sync_signal, *sync_cpu;
+	double camp_cpu = 0.0, camp_signal = 0.0, rtf;
+	const char *channel = 0;
+	const mtsc_s *m;
+	trial_s *t;
+
+	while((c = getopt(argc, argv, "S:n:s:o:p:d:F:r:Mjh?")) != EOF) {
+		switch(c) {
+			case 'S':
+				sps = strtod(optarg, 0);
+				if((sps != 1.0) && (sps != 2.0) && (sps != 4.0))
+					usage(argv[0]);
+				break;
+
+			case 'n':
+				if((n = strtoul(optarg, 0, 0)) < 1)
+					usage(argv[0]);
+				break;
+
+			case 's':
+				c = sscanf(optarg, "%f:%f", &snr_lo, &snr_hi);
+				if(c == 1)
+					snr_hi = snr_lo;
+				if((c < 1) || (snr_hi < snr_lo))
+					usage(argv[0]);
+				break;
+
+			case 'o':
+				max_offset = fabs(strtod(optarg, 0));
+				break;
+
+			case 'p':
+				channel = optarg;
+				break;
+
+			case 'd':
+				drift = strtod(optarg, 0);
+				break;
+
+			case 'F':
+				frames = strtoul(optarg, 0, 0);
+				break;
+
+			case 'r':
+				seed = strtoul(optarg, 0, 0);
+				break;
+
+			case 'M':
+				set_equalizer(EQ_MLSE);
+				break;
+
+			case 'j':
+				json = 1;
+				break;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+
+	if(!(m = get_mtsc(MTSC_SB, 0, sps))) {
+		fprintf(stderr, "error: get_mtsc\n");
+		return -1;
+	}
+
+	t = new trial_s[n];
+	sync_signal = new float[n];
+	sync_cpu = new float[n];
+
+	if(!json)
+		printf("%5s %6s %6s %9s %10s %10s %8s\n", "bsic", "snr", "offset", "result", "sync (ms)", "cpu (ms)", "bursts");
+	for(i = 0; i < n; i++) {
+		if(run_trial(sps, m, &seed, snr_lo, snr_hi, max_offset, channel, drift, frames, &t[i])) {
+			fprintf(stderr, "error: trial %u\n", i);
+			return -1;
+		}
+		if(!json)
+			printf("%5d %6.1f %6.0f %9s %10.1f %10.1f %8u\n", t[i].bsic, t[i].snr, t[i].offset,
+			   t[i].acquired? (t[i].lost? "lost" : "ok") : "failed",
+			   1e3 * t[i].sync_signal, 1e3 * t[i].sync_cpu, t[i].bursts);
+		if(!t[i].acquired)
+			continue;
+		sync_signal[acquired] = t[i].sync_signal;
+		sync_cpu[acquired] = t[i].sync_cpu;
+		acquired += 1;
+		lost += t[i].lost;
+		bursts += t[i].bursts;
+		camp_signal += t[i].camp_signal;
+		camp_cpu += t[i].camp_cpu;
+	}
+	rtf = (camp_cpu > 0.0)? camp_signal / camp_cpu : 0.0;
+
+	if(json) {
+		printf("{\n\t\"sps\": %g,\n\t\"channel\": \"%s\",\n\t\"drift_ppm\": %g,\n\t\"trials\": %u,\n\t\"acquired\": %u,\n\t\"lost\": %u,\n", sps, channel? channel : "static", drift, n, acquired, lost);
+		print_dist("sync_signal_s", sync_signal, acquired, json);
+		print_dist("sync_cpu_s", sync_cpu, acquired, json);
+		printf("\t\"bursts\": %u,\n\t\"bursts_per_s\": %.0f,\n\t\"real_time_factor\": %.2f,\n\t\"carriers\": %u\n}\n",
+		   bursts, (camp_cpu > 0.0)? bursts / camp_cpu : 0.0, rtf, (unsigned int)rtf);
+	} else {
+		printf("\nacquired %u of %u, lost %u\n", acquired, n, lost);
+		printf("%-24s%10s%10s%10s%10s\n", "time to first SCH", "min", "median", "p90", "max");
+		print_dist("  signal", sync_signal, acquired, json);
+		print_dist("  cpu", sync_cpu, acquired, json);
+		printf("camping: %u bursts, %.0f bursts/s, real-time factor %.2f\n",
+		   bursts, (camp_cpu > 0.0)? bursts / camp_cpu : 0.0, rtf);
+		printf("carriers per core: %u\n", (unsigned int)rtf);
+	}
+
+	delete[] sync_cpu;
+	delete[] sync_signal;
+	delete[] t;
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Packed bit vectors.
+ *
+ * Bit i of a vector is kept in bit (i % 64) of word (i / 64).  Any field of up
+ * to 64 bits can be pulled out with at most two word reads and a field that
+ * starts at bit os comes back with bit os in the least significant position.
+ *
+ * BV_MAX_BITS is enough to hold a complete burst including the guard period.
+ */
+static const unsigned int BV_WORD_BITS	= 64;
+static const unsigned int BV_MAX_BITS	= 192;
+static const unsigned int BV_WORDS	= BV_MAX_BITS / BV_WORD_BITS;
+
+typedef struct {
+	uint64_t	w[BV_WORDS];	// packed bits
+	unsigned int	len;		// number of valid bits
+} bitvec_s;
+
+
+/*
+ * Soft bits are signed 8-bit log-likelihood ratios.  A positive value favors
+ * a 0 bit, a negative value favors a 1 bit and the magnitude is the
+ * confidence.  This matches the polarization used by modulate(), i.e., a
+ * symbol is 1 - 2 * bit.
+ */
+typedef int8_t llr_t;
+
+static const int LLR_MAX	= 127;
+
+
+static inline void bv_clear(bitvec_s *bv, const unsigned int len) {
+
+	memset(bv->w, 0, sizeof(bv->w));
+	bv->len = len;
+}
+
+
+static inline unsigned int bv_get(const bitvec_s *bv, const unsigned int i) {
+
+	return (bv->w[i / BV_WORD_BITS] >> (i % BV_WORD_BITS)) & 1;
+}
+
+
+static inline void bv_set(bitvec_s *bv, const unsigned int i, const unsigned int b) {
+
+	uint64_t m = (uint64_t)1 << (i % BV_WORD_BITS);
+
+	if(b)
+		bv->w[i / BV_WORD_BITS] |= m;
+	else
+		bv->w[i / BV_WORD_BITS] &= ~m;
+}
+
+
+static inline uint64_t bv_mask(const unsigned int n) {
+
+	return (n >= BV_WORD_BITS)? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+}
+
+
+/*
+ * Return the n bits (n <= 64) starting at bit os.
+ */
+static inline uint64_t bv_extract(const bitvec_s *bv, const unsigned int os, const unsigned int n) {
+
+	unsigned int wi = os / BV_WORD_BITS, bi = os % BV_WORD_BITS;
+	uint64_t v;
+
+	v = bv->w[wi] >> bi;
+	if(bi && (bi + n > BV_WORD_BITS))
+		v |= bv->w[wi + 1] << (BV_WORD_BITS - bi);
+	return v & bv_mask(n);
+}
+
+
+/*
+ * Write the low n bits (n <= 64) of v starting at bit os.
+ */
+static inline void bv_insert(bitvec_s *bv, const unsigned int os, const unsigned int n, const uint64_t v) {
+
+	unsigned int wi = os / BV_WORD_BITS, bi = os % BV_WORD_BITS;
+	uint64_t m = bv_mask(n), x = v & m;
+
+	bv->w[wi] = (bv->w[wi] & ~(m << bi)) | (x << bi);
+	if(bi && (bi + n > BV_WORD_BITS)) {
+		bv->w[wi + 1] = (bv->w[wi + 1] & ~(m >> (BV_WORD_BITS - bi))) |
+		   (x >> (BV_WORD_BITS - bi));
+	}
+}
+
+
+/*
+ * Copy n bits from src (starting at src_os) to dst (starting at dst_os).
+ */
+static inline void bv_copy(bitvec_s *dst, const unsigned int dst_os, const bitvec_s *src, const unsigned int src_os, const unsigned int n) {
+
+	unsigned int i, t;
+
+	for(i = 0; i < n; i += t) {
+		t = (n - i < BV_WORD_BITS)? n - i : BV_WORD_BITS;
+		bv_insert(dst, dst_os + i, t, bv_extract(src, src_os + i, t));
+	}
+}
+
+
+/*
+ * Pack one bit per unsigned char (only the least significant bit is used).
+ */
+static inline void bv_pack(bitvec_s *bv, const unsigned char *bits, const unsigned int len) {
+
+	unsigned int i, j, n;
+	uint64_t w;
+
+	bv_clear(bv, len);
+	for(i = 0; i < len; i += BV_WORD_BITS) {
+		n = (len - i < BV_WORD_BITS)? len - i : BV_WORD_BITS;
+		for(w = 0, j = 0; j < n; j++)
+			w |= (uint64_t)(bits[i + j] & 1) << j;
+		bv->w[i / BV_WORD_BITS] = w;
+	}
+}
+
+
+static inline void bv_unpack(unsigned char *bits, const bitvec_s *bv) {
+
+	unsigned int i;
+
+	for(i = 0; i < bv->len; i++)
+		bits[i] = bv_get(bv, i);
+}
+
+
+/*
+ * Convert soft bits in [0, 1] (probability of a 1 bit, as returned by
+ * slice_soft) to LLRs.
+ */
+static inline void llr_from_soft(llr_t *l, const float *s, const unsigned int len) {
+
+	unsigned int i;
+	float v;
+
+	for(i = 0; i < len; i++) {
+		v = LLR_MAX * (1.0 - 2.0 * s[i]);
+		if(v > LLR_MAX)
+			v = LLR_MAX;
+		else if(v < -LLR_MAX)
+			v = -LLR_MAX;
+		l[i] = (llr_t)((v < 0)? v - 0.5 : v + 0.5);
+	}
+}
@@ -0,0 +1,225 @@
+#include <math.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "dsp.h"
+#include "mtsc.h"
+#include "burst_classifier.h"
+
+
+const float burst_classifier::EMPTY_RATIO	= 0.1;	// -10 dB from the reference is no burst
+const float burst_classifier::LONG_THRESHOLD	= 0.5;	// dummy, frequency or synchronization burst
+
+
+burst_classifier::burst_classifier(const float sps,
+   const unsigned int max_len) {
+
+	int i;
+	template_s t;
+
+	m_sps = sps;
+	m_max_len = max_len;
+	make_template(&m_dummy, MTSC_DUMMY, 0);
+	make_template(&m_fb, MTSC_FB, 0);
+	make_template(&m_sb, MTSC_SB, 0);
+
+	// the normal burst sequences are correlated together, we only need their energy
+	for(i = 0; i < N_TSC_NUM; i++) {
+		make_template(&t, MTSC_NB, i);
+		m_nb_energy[i] = t.energy;
+		m_nb_len = t.len;
+		m_nb[i] = n_tsc[i];
+	}
+	m_c = new complex[N_TSC_NUM * max_len];
+}
+
+
+burst_classifier::~burst_classifier() {
+
+	delete[] m_c;
+}
+
+
+void burst_classifier::make_template(template_s *t, const int type,
+   const unsigned int index) {
+
+	unsigned int len, os;
+	const unsigned char *bits;
+	const mtsc_s *m;
+
+	if(mtsc_sequence(type, index, &bits, &len, &os) || !(m = get_mtsc(type, index, m_sps)))
+		throw std::runtime_error("burst_classifier: get_mtsc");
+	t->t = m->tsc;
+	t->len = m->len;
+	t->energy = vectornorm2(t->t, t->len);
+	t->os = os * m_sps;
+}
+
+
+/*
+ * Best normalized correlation of t with s within window samples of where it
+ * belongs in a burst starting at toa.
+ */
+float burst_classifier::score(const template_s *t, const complex *s,
+   const unsigned int s_len, const float toa, const float window) {
+
+	int p, lo, hi;
+	unsigned int i;
+	float e, r, cr, ci, sr, si, tr, ti, best = 0.0;
+
+	lo = (int)floor(toa + t->os - window);
+	hi = (int)ceil(toa + t->os + window);
+	if(lo < 0)
+		lo = 0;
+	for(p = lo; (p <= hi) && (p + t->len <= s_len); p++) {
+
+		// spelled out since complex multiplication checks for NaNs
+		cr = ci = e = 0.0;
+		for(i = 0; i < t->len; i++) {
+			sr = s[p + i].real();
+			si = s[p + i].imag();
+			tr = t->t[i].real();
+			ti = t->t[i].imag();
+			cr += sr * tr + si * ti;
+			ci += si * tr - sr * ti;
+			e += sr * sr + si * si;
+		}
+		if(e <= 0.0)
+			continue;
+		r = (cr * cr + ci * ci) / (e * t->energy);
+		if(r > best)
+			best = r;
+	}
+
+	return best;
+}
+
+
+/*
+ * Best normalized correlation of any normal burst training sequence, all of
+ * them correlated in one pass.
+ */
+float burst_classifier::score_nb(const complex *s, const unsigned int s_len,
+   const float toa, const float window, int *tsc_o) {
+
+	int p, lo, hi, i, tsc = 0;
+	unsigned int d, k;
+	float e, r, best = 0.0;
+	complex *c, *c_new = 0;
+
+	lo = (int)floor(toa + N_TSC_OS * m_sps - window);
+	hi = (int)ceil(toa + N_TSC_OS * m_sps + window);
+	if(lo < 0)
+		lo = 0;
+	if(hi + m_nb_len > s_len)
+		hi = (int)s_len - (int)m_nb_len;
+	if(hi < lo)
+		return 0.0;
+
+	/*
+	 * Output n of the correlation is for the sequence starting at
+	 * s[n + d - m_nb_len + 1].
+	 */
+	d = (m_nb_len - 1) / 2;
+	if(s_len <= m_max_len)
+		c = m_c;
+	else
+		c = c_new = new complex[N_TSC_NUM * s_len];
+	if(correlate_bits_nodelay_window(c, s, s_len, m_nb, N_TSC_NUM, N_TSC_CODE_LEN, N_TSC_OS, m_sps, lo + m_nb_len - 1 - d, hi - lo + 1)) {
+		delete[] c_new;
+		return 0.0;
+	}
+
+	for(p = lo; p <= hi; p++) {
+		e = vectornorm2(s + p, m_nb_len);
+		if(e <= 0.0)
+			continue;
+		k = p + m_nb_len - 1 - d;
+		for(i = 0; i < N_TSC_NUM; i++) {
+			r = norm(c[i * s_len + k]) / (e * m_nb_energy[i]);
+			if(r > best) {
+				best = r;
+				tsc = i;
+			}
+		}
+	}
+	delete[] c_new;
+
+	if(tsc_o)
+		*tsc_o = tsc;
+	return best;
+}
+
+
+/*
+ * Average power of the burst starting at toa.
+ */
+float burst_classifier::power(const complex *s, const unsigned int s_len,
+   const float toa) {
+
+	unsigned int os, len;
+
+	os = (toa > 0)? (unsigned int)nearbyintf(toa) : 0;
+	len = (unsigned int)(DATA_LEN * m_sps);
+	if(os >= s_len)
+		return 0.0;
+	if(os + len > s_len)
+		len = s_len - os;
+
+	return vectornorm2(s + os, len) / len;
+}
+
+
+/*
+ * classify
+ *
+ * 	toa		predicted offset from s to the start of the burst
+ * 	window		samples either side of toa to look
+ * 	ref_power	power of a known good burst on this carrier (e.g., the
+ * 			last synchronization burst), 0 to skip the energy test
+ * 	tsc		training sequence of a normal burst
+ * 	score		normalized correlation of the winning sequence
+ *
+ * 	returns	one of the BURST_ constants
+ *
+ * A window that has energy but doesn't match anything well enough is called a
+ * normal burst with the best training sequence so that it is still handed to
+ * the equalizer; we only throw away what we are sure of.
+ */
+int burst_classifier::classify(const complex *s, const unsigned int s_len,
+   const float toa, const float window, const float ref_power,
+   int *tsc_o, float *score_o) {
+
+	int type, tsc = 0;
+	float r, best;
+
+	if((ref_power > 0.0) && (power(s, s_len, toa) < EMPTY_RATIO * ref_power)) {
+		if(score_o)
+			*score_o = 0.0;
+		return BURST_EMPTY;
+	}
+
+	type = BURST_DUMMY;
+	best = score(&m_dummy, s, s_len, toa, window);
+	if(best < LONG_THRESHOLD) {
+		if((r = score(&m_fb, s, s_len, toa, window)) > best) {
+			best = r;
+			type = BURST_FB;
+		}
+		if((r = score(&m_sb, s, s_len, toa, window)) > best) {
+			best = r;
+			type = BURST_SB;
+		}
+	}
+
+	if(best < LONG_THRESHOLD) {
+		type = BURST_NB;
+		best = score_nb(s, s_len, toa, window, &tsc);
+	}
+
+	if(tsc_o)
+		*tsc_o = tsc;
+	if(score_o)
+		*score_o = best;
+	return type;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "usrp_complex.h"
+#include "gsm_bursts.h"
+
+enum {
+	BURST_EMPTY,
+	BURST_FB,
+	BURST_SB,
+	BURST_NB,
+	BURST_DUMMY
+};
+
+
+/*
+ * burst_classifier
+ *
+ * Decides what kind of burst is in a window before anything expensive is
+ * done with it.  The burst must already be roughly located (e.g., by the TDMA
+ * clock): the known part of each burst type is correlated with the window
+ * only within a few samples of where it should be.
+ *
+ * Each score is the normalized correlation |<s, t>|^2 / (|s|^2 |t|^2), so it
+ * is 1 for a perfect match whatever the signal level.  The long sequences
+ * (dummy, frequency and synchronization bursts) are tried first since a
+ * match there is the most reliable and, on an idle C0, the most likely.
+ * The eight normal burst training sequences are scored in one pass, into a
+ * buffer kept for windows of up to max_len samples.
+ */
+class burst_classifier {
+public:
+	burst_classifier(const float sps, const unsigned int max_len);
+	~burst_classifier();
+
+	int classify(const complex *s, const unsigned int s_len,
+	   const float toa, const float window, const float ref_power,
+	   int *tsc_o = 0, float *score_o = 0);
+
+	float power(const complex *s, const unsigned int s_len,
+	   const float toa);
+
+private:
+	typedef struct {
+		const complex *	t;		// modulated sequence
+		unsigned int	len;
+		float		energy;		// |t|^2
+		float		os;		// samples from start of burst
+	} template_s;
+
+	void make_template(template_s *t, const int type,
+	   const unsigned int index);
+	float score(const template_s *t, const complex *s,
+	   const unsigned int s_len, const float toa, const float window);
+	float score_nb(const complex *s, const unsigned int s_len,
+	   const float toa, const float window, int *tsc_o);
+
+	float		m_sps;
+	unsigned int	m_max_len;
+	complex *	m_c;		// normal burst correlations
+
+	template_s	m_fb;
+	template_s	m_sb;
+	template_s	m_dummy;
+	const unsigned char *	m_nb[N_TSC_NUM];
+	float		m_nb_energy[N_TSC_NUM];
+	unsigned int	m_nb_len;
+
+	static const float	EMPTY_RATIO;
+	static const float	LONG_THRESHOLD;
+};
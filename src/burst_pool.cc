@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+
+#include "burst_pool.h"
+
+
+burst_pool::burst_pool(const unsigned int n_threads, const float sps,
+   const unsigned int max_len, burst_cb_t cb, void *ctx) {
+
+	unsigned int i;
+
+	if(!n_threads)
+		throw std::runtime_error("burst_pool: no threads");
+
+	m_sps = sps;
+	m_max_len = max_len;
+	m_cb = cb;
+	m_ctx = ctx;
+	m_submitted = m_taken = m_delivered = 0;
+	m_delivering = 0;
+	m_stop = 0;
+	for(i = 0; i < 8; i++) {
+		m_dev_sum[i] = 0.0;
+		m_dev_n[i] = 0;
+	}
+
+	for(i = 0; i < QUEUE_LEN; i++) {
+		memset(&m_jobs[i], 0, sizeof(m_jobs[i]));
+		m_jobs[i].s = new complex[max_len];
+	}
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_work, 0);
+	pthread_cond_init(&m_space, 0);
+
+	m_threads = new pthread_t[n_threads];
+	for(m_n_threads = 0; m_n_threads < n_threads; m_n_threads++) {
+		if(pthread_create(&m_threads[m_n_threads], 0, worker_thread, this)) {
+			perror("pthread_create");
+			break;
+		}
+	}
+	if(!m_n_threads) {
+		delete[] m_threads;
+		for(i = 0; i < QUEUE_LEN; i++)
+			delete[] m_jobs[i].s;
+		throw std::runtime_error("burst_pool: pthread_create");
+	}
+}
+
+
+/*
+ * Outstanding jobs are finished and delivered before the workers exit.
+ */
+burst_pool::~burst_pool() {
+
+	unsigned int i;
+
+	drain();
+
+	pthread_mutex_lock(&m_mutex);
+	m_stop = 1;
+	pthread_cond_broadcast(&m_work);
+	pthread_mutex_unlock(&m_mutex);
+
+	for(i = 0; i < m_n_threads; i++)
+		pthread_join(m_threads[i], 0);
+	delete[] m_threads;
+
+	for(i = 0; i < QUEUE_LEN; i++)
+		delete[] m_jobs[i].s;
+
+	pthread_cond_destroy(&m_space);
+	pthread_cond_destroy(&m_work);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+unsigned int burst_pool::threads() {
+
+	return m_n_threads;
+}
+
+
+unsigned int burst_pool::max_len() {
+
+	return m_max_len;
+}
+
+
+/*
+ * Queue burst (fn, ts) for demodulation.  The window s is copied so it need
+ * not outlive the call.  Blocks while every slot is in use.
+ *
+ * 	toa	start of the burst in s by the clock, negative to search all of s
+ * 	window	samples either side of toa + dev to search (see
+ * 		demod_burst_tracked)
+ * 	dev	how far from toa bursts of this time slot have been lately
+ */
+int burst_pool::submit(const int fn, const int ts, const complex *s,
+   const unsigned int s_len, const mtsc_s *mtsc, const float toa,
+   const float window, const float dev) {
+
+	burst_job_s *j;
+
+	if(s_len > m_max_len) {
+		fprintf(stderr, "error: burst_pool::submit: window too long (%u > %u)\n", s_len, m_max_len);
+		return -1;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	while(m_submitted - m_delivered >= QUEUE_LEN)
+		pthread_cond_wait(&m_space, &m_mutex);
+
+	j = &m_jobs[m_submitted % QUEUE_LEN];
+	j->fn = fn;
+	j->ts = ts;
+	j->mtsc = mtsc;
+	memcpy(j->s, s, s_len * sizeof(complex));
+	j->s_len = s_len;
+	j->toa = toa;
+	j->dev = dev;
+	j->window = window;
+	j->bits_len = 0;
+	j->done = 0;
+	m_submitted += 1;
+
+	pthread_cond_signal(&m_work);
+	pthread_mutex_unlock(&m_mutex);
+
+	return 0;
+}
+
+
+/*
+ * How far from the clock the bursts of time slot ts that have been
+ * demodulated since the last call were found, on average (samples).
+ *
+ * 	returns	the number of bursts averaged, 0 if there were none
+ */
+unsigned int burst_pool::timing(const int ts, float *dev_o) {
+
+	unsigned int n;
+
+	pthread_mutex_lock(&m_mutex);
+	n = m_dev_n[ts & 7];
+	if(n && dev_o)
+		*dev_o = m_dev_sum[ts & 7] / n;
+	m_dev_sum[ts & 7] = 0.0;
+	m_dev_n[ts & 7] = 0;
+	pthread_mutex_unlock(&m_mutex);
+
+	return n;
+}
+
+
+/*
+ * Wait until every submitted burst has been delivered.
+ */
+void burst_pool::drain() {
+
+	pthread_mutex_lock(&m_mutex);
+	while(m_delivered != m_submitted)
+		pthread_cond_wait(&m_space, &m_mutex);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void *burst_pool::worker_thread(void *arg) {
+
+	((burst_pool *)arg)->worker();
+	return 0;
+}
+
+
+void burst_pool::worker() {
+
+	unsigned int b_len;
+	float toa, snr, *b;
+	burst_job_s *j;
+	demod_scratch_s scratch;
+
+	// this worker's correlation buffer, reused for every job it takes
+	scratch.c = new complex[m_max_len];
+	scratch.c_len = m_max_len;
+
+	pthread_mutex_lock(&m_mutex);
+	for(;;) {
+		while((m_taken == m_submitted) && (!m_stop))
+			pthread_cond_wait(&m_work, &m_mutex);
+		if(m_taken == m_submitted)
+			break;
+		j = &m_jobs[m_taken % QUEUE_LEN];
+		m_taken += 1;
+		pthread_mutex_unlock(&m_mutex);
+
+		toa = (j->toa >= 0.0)? j->toa + j->dev : -1.0;
+		if((b = demod_burst_tracked(m_sps, &b_len, j->s, j->s_len, j->mtsc, 0, &toa, j->window, &snr, &scratch))) {
+			if(b_len > DATA_LEN)
+				b_len = DATA_LEN;
+			llr_from_soft(j->bits, b, b_len);
+			j->bits_len = b_len;
+			j->dt = (j->toa >= 0.0)? (toa - j->toa - j->dev) / m_sps : 0.0;
+			j->found = toa - j->toa;
+			j->snr = snr;
+			delete[] b;
+		}
+
+		pthread_mutex_lock(&m_mutex);
+		if(j->bits_len && (j->toa >= 0.0)) {
+			m_dev_sum[j->ts & 7] += j->found;
+			m_dev_n[j->ts & 7] += 1;
+		}
+		j->done = 1;
+		deliver_nolock();
+	}
+	pthread_mutex_unlock(&m_mutex);
+
+	delete[] scratch.c;
+}
+
+
+/*
+ * Hand finished jobs to the callback in sequence order.  Only one thread
+ * delivers at a time; the others just mark their job done and go back to
+ * work.  The mutex is released while the callback runs.
+ */
+void burst_pool::deliver_nolock() {
+
+	burst_job_s *j;
+
+	if(m_delivering)
+		return;
+	m_delivering = 1;
+	while((m_delivered < m_taken) && m_jobs[m_delivered % QUEUE_LEN].done) {
+		j = &m_jobs[m_delivered % QUEUE_LEN];
+		pthread_mutex_unlock(&m_mutex);
+		if(m_cb && j->bits_len)
+			m_cb(m_ctx, j->fn, j->ts, j->dt, j->snr, j->bits, j->bits_len);
+		pthread_mutex_lock(&m_mutex);
+		j->done = 0;
+		m_delivered += 1;
+		pthread_cond_broadcast(&m_space);
+	}
+	m_delivering = 0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "usrp_complex.h"
+#include "bitvec.h"
+#include "gsm.h"
+#include "gsm_demod.h"
+
+/*
+ * Called for every demodulated burst.  bits holds bits_len soft bits (starting
+ * with the tail bits) as LLRs.  toa is how far the burst was from where it
+ * was expected in symbols and snr the peak to mean ratio of its training
+ * sequence correlation.
+ */
+typedef void (*burst_cb_t)(void *ctx, const int fn, const int ts,
+   const float toa, const float snr, const llr_t *bits,
+   const unsigned int bits_len);
+
+
+/*
+ * burst_pool
+ *
+ * Demodulates bursts on a number of worker threads.
+ *
+ * Jobs are kept in a fixed ring of slots indexed by sequence number.  Each
+ * slot owns a copy of the burst window and the buffer for its soft bits so
+ * the caller may reuse its window (e.g., the one returned by get_burst) as
+ * soon as submit returns.  Each worker keeps its own buffer for the training
+ * sequence correlation; the equalizer still allocates its filters and output
+ * for every burst.  Workers take the oldest pending job; results are handed to
+ * the callback strictly in the order they were submitted.  A slow burst delays
+ * delivery, not the other workers.
+ *
+ * Where each burst was found is also kept per time slot so that whoever
+ * predicts the bursts can follow their timing (see timing).
+ */
+class burst_pool {
+public:
+	burst_pool(const unsigned int n_threads, const float sps,
+	   const unsigned int max_len, burst_cb_t cb, void *ctx);
+	~burst_pool();
+
+	int submit(const int fn, const int ts, const complex *s,
+	   const unsigned int s_len, const mtsc_s *mtsc,
+	   const float toa = -1.0, const float window = 0.0,
+	   const float dev = 0.0);
+	void drain();
+	unsigned int timing(const int ts, float *dev_o);
+
+	unsigned int threads();
+	unsigned int max_len();
+
+private:
+	typedef struct {
+		int		fn;
+		int		ts;
+		const mtsc_s *	mtsc;
+		complex *	s;		// copy of the burst window
+		unsigned int	s_len;
+		float		toa;		// start of the burst by the clock, < 0 if unknown
+		float		dev;		// expected offset from toa
+		float		window;
+		float		dt;		// found - expected start (symbols)
+		float		found;		// found - toa (samples)
+		float		snr;
+		llr_t		bits[DATA_LEN];
+		unsigned int	bits_len;	// 0 if the burst didn't demodulate
+		int		done;
+	} burst_job_s;
+
+	static void *worker_thread(void *arg);
+	void worker();
+	void deliver_nolock();
+
+	static const unsigned int	QUEUE_LEN	= 64;
+
+	float			m_sps;
+	unsigned int		m_max_len;
+	burst_cb_t		m_cb;
+	void *			m_ctx;
+
+	burst_job_s		m_jobs[QUEUE_LEN];
+	unsigned long long	m_submitted;	// next sequence number to hand out
+	unsigned long long	m_taken;	// next job for a worker
+	unsigned long long	m_delivered;	// next job for the callback
+	int			m_delivering;
+	int			m_stop;
+
+	unsigned int		m_n_threads;
+	pthread_t *		m_threads;
+
+	// found - toa summed per time slot since the last call to timing
+	float			m_dev_sum[8];
+	unsigned int		m_dev_n[8];
+
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_work;		// a job was submitted
+	pthread_cond_t		m_space;	// a job was delivered
+};
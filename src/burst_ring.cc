@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdexcept>
+
+#include "burst_ring.h"
+
+
+/*
+ * Create a ring of slots records.  A ring of the same name left behind by an
+ * earlier run is replaced.
+ */
+burst_ring::burst_ring(const char *name, const unsigned int slots) {
+
+	if(!slots)
+		throw std::runtime_error("burst_ring: no slots");
+
+	map(name, 1, slots);
+}
+
+
+/*
+ * Attach to an existing ring.  Only records written from now on are seen.
+ */
+burst_ring::burst_ring(const char *name) {
+
+	map(name, 0, 0);
+}
+
+
+burst_ring::~burst_ring() {
+
+	munmap(m_base, m_size);
+	if(m_owner)
+		shm_unlink(m_name);
+	free(m_name);
+}
+
+
+/*
+ * Like circular_buffer, the ring lives in a Posix shared memory object.  It
+ * needs no mirrored mapping since records never straddle its end.
+ */
+void burst_ring::map(const char *name, const int create, const unsigned int slots) {
+
+	int fd;
+	struct stat st;
+
+	// shm_open wants a single leading slash
+	if(!(m_name = (char *)malloc(strlen(name) + 2)))
+		throw std::runtime_error("burst_ring: malloc");
+	sprintf(m_name, "%s%s", (name[0] == '/')? "" : "/", name);
+	m_owner = create;
+
+	if(create) {
+		shm_unlink(m_name);
+		if((fd = shm_open(m_name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) == -1) {
+			perror("shm_open");
+			free(m_name);
+			throw std::runtime_error("burst_ring: shm_open");
+		}
+		m_size = sizeof(ring_hdr_s) + slots * sizeof(burst_record_s);
+		if(ftruncate(fd, m_size) == -1) {
+			perror("ftruncate");
+			close(fd);
+			shm_unlink(m_name);
+			free(m_name);
+			throw std::runtime_error("burst_ring: ftruncate");
+		}
+	} else {
+		if((fd = shm_open(m_name, O_RDONLY, 0)) == -1) {
+			perror("shm_open");
+			free(m_name);
+			throw std::runtime_error("burst_ring: shm_open");
+		}
+		if((fstat(fd, &st) == -1) || (st.st_size < (off_t)sizeof(ring_hdr_s))) {
+			close(fd);
+			free(m_name);
+			throw std::runtime_error("burst_ring: not a ring");
+		}
+		m_size = st.st_size;
+	}
+
+	m_base = mmap(0, m_size, create? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(m_base == MAP_FAILED) {
+		perror("mmap");
+		if(create)
+			shm_unlink(m_name);
+		free(m_name);
+		throw std::runtime_error("burst_ring: mmap");
+	}
+	m_hdr = (ring_hdr_s *)m_base;
+	m_rec = (burst_record_s *)((char *)m_base + sizeof(ring_hdr_s));
+
+	if(create) {
+		// the memory starts zeroed: every slot is older than record 0
+		m_hdr->version = RING_VERSION;
+		m_hdr->record_size = sizeof(burst_record_s);
+		m_hdr->slots = slots;
+		m_hdr->head = 0;
+		__sync_synchronize();
+		m_hdr->magic = RING_MAGIC;
+	} else if((m_hdr->magic != RING_MAGIC) || (m_hdr->version != RING_VERSION) ||
+	   (m_hdr->record_size != sizeof(burst_record_s)) ||
+	   (sizeof(ring_hdr_s) + (unsigned long long)m_hdr->slots * sizeof(burst_record_s) > m_size)) {
+		munmap(m_base, m_size);
+		free(m_name);
+		throw std::runtime_error("burst_ring: bad ring");
+	}
+
+	m_slots = m_hdr->slots;
+	m_next = m_hdr->head;
+	m_lost = 0;
+}
+
+
+unsigned int burst_ring::slots() {
+
+	return m_slots;
+}
+
+
+unsigned long long burst_ring::lost() {
+
+	return m_lost;
+}
+
+
+/*
+ * Publish a burst.  Never blocks.
+ */
+int burst_ring::write(const int fn, const int ts, const unsigned int arfcn,
+   const float toa, const float snr, const llr_t *bits,
+   const unsigned int bits_len) {
+
+	uint64_t n;
+	burst_record_s *r;
+
+	if(!m_owner) {
+		fprintf(stderr, "error: burst_ring::write: ring is read only\n");
+		return -1;
+	}
+
+	n = __sync_fetch_and_add(&m_hdr->head, 1);
+	r = &m_rec[n % m_slots];
+
+	r->seq = 2 * n + 1;
+	__sync_synchronize();
+
+	r->fn = fn;
+	r->ts = ts;
+	r->arfcn = arfcn;
+	r->toa = toa;
+	r->snr = snr;
+	r->bits_len = (bits_len < DATA_LEN)? bits_len : DATA_LEN;
+	memcpy(r->bits, bits, r->bits_len * sizeof(llr_t));
+
+	__sync_synchronize();
+	r->seq = 2 * n + 2;
+
+	return 0;
+}
+
+
+/*
+ * The next record, or 0 if it hasn't been written yet.  If the writer has
+ * lapped us we skip ahead to half a ring behind it.
+ */
+const burst_record_s *burst_ring::peek() {
+
+	uint64_t s, head;
+	const burst_record_s *r;
+
+	for(;;) {
+		r = &m_rec[m_next % m_slots];
+		s = r->seq;
+		__sync_synchronize();
+		if(s == 2 * m_next + 2)
+			return r;
+		if(s <= 2 * m_next + 1)
+			return 0;
+
+		head = m_hdr->head;
+		m_lost += (head - m_slots / 2) - m_next;
+		m_next = head - m_slots / 2;
+	}
+}
+
+
+/*
+ * Done with the record returned by peek.
+ *
+ * 	returns	0 if the record was intact the whole time, -1 if the writer
+ * 		overwrote it meanwhile
+ */
+int burst_ring::release() {
+
+	uint64_t s;
+
+	__sync_synchronize();
+	s = m_rec[m_next % m_slots].seq;
+	if(s != 2 * m_next + 2) {
+		m_lost += 1;
+		m_next += 1;
+		return -1;
+	}
+	m_next += 1;
+	return 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "bitvec.h"
+#include "gsm.h"
+
+/*
+ * One demodulated burst as published in a burst_ring.  Records are a whole
+ * number of cache lines so neighbours never share one.
+ */
+typedef struct {
+	volatile uint64_t	seq;		// 2n + 2 once record n is complete, odd while written
+	int32_t			fn;
+	uint8_t			ts;
+	uint8_t			pad;
+	uint16_t		arfcn;
+	float			toa;		// symbols from where the burst was expected
+	float			snr;		// peak to mean of the training sequence correlation
+	uint16_t		bits_len;
+	llr_t			bits[DATA_LEN];
+} __attribute__((aligned(64))) burst_record_s;
+
+
+/*
+ * burst_ring
+ *
+ * Publishes bursts to other processes on the same host through a named
+ * shared memory ring of fixed size records.
+ *
+ * The process that demodulates creates the ring and writes to it; any number
+ * of consumers attach to it by name, read at their own pace and detach
+ * whenever they like.  Nothing in the ring depends on who is reading, so the
+ * writer never waits and never makes a system call.  Record n goes in slot n
+ * mod slots; its sequence word is odd while it is being written and 2n + 2
+ * once it is complete, so a consumer can tell a record that is not there yet
+ * from one that has already been overwritten.  A consumer that falls a whole
+ * ring behind loses records rather than slowing down the writer.
+ *
+ * Writers claim record numbers atomically so bursts of several carriers may
+ * be written from several threads.
+ *
+ * Consumers read records in place:
+ *
+ * 	while((r = ring->peek())) {
+ * 		... use r ...
+ * 		if(ring->release())
+ * 			... r was overwritten while in use, discard what we got ...
+ * 	}
+ */
+class burst_ring {
+public:
+	burst_ring(const char *name, const unsigned int slots);	// create
+	burst_ring(const char *name);					// attach
+	~burst_ring();
+
+	int write(const int fn, const int ts, const unsigned int arfcn,
+	   const float toa, const float snr, const llr_t *bits,
+	   const unsigned int bits_len);
+
+	const burst_record_s *peek();
+	int release();
+	unsigned long long lost();
+	unsigned int slots();
+
+private:
+	typedef struct {
+		uint32_t		magic;
+		uint32_t		version;
+		uint32_t		record_size;
+		uint32_t		slots;
+		volatile uint64_t	head __attribute__((aligned(64)));	// records claimed
+	} __attribute__((aligned(64))) ring_hdr_s;
+
+	void map(const char *name, const int create, const unsigned int slots);
+
+	static const uint32_t	RING_MAGIC	= 0x42525247;	// "GRRB"
+	static const uint32_t	RING_VERSION	= 1;
+
+	char *			m_name;
+	int			m_owner;	// created the ring, unlinks it
+	void *			m_base;
+	unsigned int		m_size;
+	ring_hdr_s *		m_hdr;
+	burst_record_s *	m_rec;
+	unsigned int		m_slots;
+
+	unsigned long long	m_next;		// next record to read
+	unsigned long long	m_lost;
+};
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <math.h>
+#include "usrp_complex.h"
+#include "gsm.h"
+#include "gsm_bursts.h"
+#include "gsm_demod.h"
+#include "burst_classifier.h"
+#include "camp.h"
+
+
+static const unsigned int MARGIN		= GUARD_LEN;	// symbols either side of a burst
+static const unsigned int MAX_SCH_FAILURES	= 5;		// consecutive SCH failures before we give up
+static const double TRACK_GAIN			= 0.5;		// fraction of the SCH timing error to correct
+static const double AFC_GAIN			= 0.25;		// fraction of the SCH frequency error to correct
+static const float SEARCH_WINDOW		= 3.0;		// symbols either side of the predicted burst
+static const float TOA_GAIN			= 0.25;		// smoothing of the per time slot timing
+static const unsigned int MAX_SCH_TRIES		= 10;		// frequency bursts to try before giving up
+static const unsigned int SCH_COMBINE		= 5;		// synchronization bursts to soft-combine
+
+
+/*
+ * Find the frequency burst, decode the following synchronization burst and
+ * anchor the clock on it.
+ *
+ * sch_acquire tries every plausible burst position in the buffer.  If none of
+ * them decode, the buffer is still aligned on the SCH so we soft-combine it
+ * with the following SCH bursts before going back to the FCCH.
+ */
+int camp_acquire(sample_source *u, const mtsc_s *m, int *fn, int *bsic) {
+
+	unsigned int buf_len, tries;
+	float sps, toa;
+	complex *buf;
+
+	sps = u->sample_rate() / GSM_RATE;
+
+	for(tries = 0; tries < MAX_SCH_TRIES; tries++) {
+		if(!(buf = get_burst_sch(u, &buf_len))) {
+			printf("get_burst_sch: fail\n");
+			return -1;
+		}
+		if(!sch_acquire(sps, buf, buf_len, m, fn, bsic, &toa))
+			break;
+		if(!sch_acquire_combined(u, m, SCH_COMBINE, fn, bsic, &toa))
+			break;
+	}
+	if(tries >= MAX_SCH_TRIES)
+		return -1;
+
+	u->get_clock()->sync(*fn, 0, (double)u->get_buffer()->consumed() + toa);
+	return 0;
+}
+
+
+/*
+ * camp
+ *
+ * Stay on a carrier whose clock has already been synchronized (see
+ * tdma_clock) and demodulate every burst of every time slot as it arrives.
+ *
+ * Normal bursts are demodulated with the training sequence given by the base
+ * station color code (the low bits of the BSIC) and handed to cb.  Each time
+ * slot keeps its own timing relative to the clock so the training sequence is
+ * only searched for near where it was last time (see demod_burst_tracked).
+ * Dummy and empty bursts are recognized by burst_classifier and dropped before
+ * they reach the equalizer.  The frequency bursts are skipped.  Each
+ * synchronization burst is decoded to check that we are still locked: its
+ * frame number must match the clock, its position is used to follow timing
+ * drift and the phase slope of its training sequence steers the NCO (see
+ * tsc_freq_offset).  If several synchronization bursts in a row fail we return
+ * so the caller can go back to searching for the frequency burst.
+ *
+ * Since bursts are fetched in order with get_burst, samples are consumed as
+ * fast as they are demodulated and the latency is bounded by a frame.
+ *
+ * If a pool is given, normal bursts are demodulated on its workers and cb is
+ * ignored in favor of the pool's callback.  The workers report where they
+ * found each burst (see burst_pool::timing) and the time slot timing follows
+ * that as it would inline, only some bursts later.  Synchronization bursts are
+ * still handled here since the clock depends on them.
+ *
+ * 	max_frames	number of frames to process, 0 to run forever
+ * 	stop		if given, checked before each frame; once it is
+ * 			non-zero we return as if max_frames had run out
+ *
+ * 	returns	0 after max_frames, 1 if synchronization was lost, -1 on error
+ */
+int camp(sample_source *u, const int bsic, burst_cb_t cb, void *ctx,
+   const unsigned int max_frames, burst_pool *pool, volatile int *stop) {
+
+	unsigned int frames, failures = 0, buf_len, b_len, margin, n;
+	int fn, ts, t3, sch_fn, sch_bsic, r = 0;
+	float sps, toa, sch_toa, t_toa, dev[8], window, ref_power = 0.0, dt, snr, found, *b;
+	complex *buf;
+	llr_t l[DATA_LEN];
+	const mtsc_s *sch_m, *nb_m;
+	tdma_clock *clock;
+	burst_classifier *bc;
+	demod_scratch_s scratch;
+
+	clock = u->get_clock();
+	if(u->get_fn_ts(&fn, &ts)) {
+		fprintf(stderr, "error: camp: clock not synchronized\n");
+		return -1;
+	}
+	sps = clock->sps();
+	margin = (unsigned int)ceil(MARGIN * sps);
+	window = SEARCH_WINDOW * sps;
+	for(ts = 0; ts < 8; ts++)
+		dev[ts] = 0.0;
+	if(pool && (camp_window_len(sps) > pool->max_len())) {
+		fprintf(stderr, "error: camp: pool windows too short\n");
+		return -1;
+	}
+
+	if(!(sch_m = get_mtsc(MTSC_SB, 0, sps)) || !(nb_m = get_mtsc(MTSC_NB, bsic & 7, sps)))
+		return -1;
+	bc = new burst_classifier(sps, camp_window_len(sps));
+	scratch.c_len = camp_window_len(sps);
+	scratch.c = new complex[scratch.c_len];
+
+	// the burst at the head of the buffer may be partly consumed
+	fn = (fn + 1) % MAX_FN;
+	ts = 0;
+
+	for(frames = 0; (!max_frames) || (frames < max_frames); ) {
+		if((ts == 0) && stop && *stop)
+			break;
+		if(!(buf = get_burst(u, &buf_len, fn, ts, margin, &toa))) {
+			r = -1;
+			break;
+		}
+
+		// fold in the bursts the workers have finished since
+		if(pool)
+			for(n = pool->timing(ts, &found); n; n--)
+				dev[ts] += TOA_GAIN * (found - dev[ts]);
+
+		t3 = fn % 51;
+		if((ts == 0) && (t3 % 10 == 0) && (t3 != 50)) {
+			// frequency burst
+		} else if((ts == 0) && (t3 % 10 == 1)) {
+			if((!sch_acquire(sps, buf, buf_len, sch_m, &sch_fn, &sch_bsic, &sch_toa)) && (sch_fn == fn) && (sch_bsic == bsic)) {
+				failures = 0;
+				clock->adjust(TRACK_GAIN * (sch_toa - toa));
+				u->get_nco()->adjust(AFC_GAIN * tsc_freq_offset(sps, buf, buf_len, sch_m, sch_toa));
+				ref_power = bc->power(buf, buf_len, sch_toa);
+			} else if(++failures >= MAX_SCH_FAILURES) {
+				r = 1;
+				break;
+			}
+		} else if(bc->classify(buf, buf_len, toa + dev[ts], window, ref_power) != BURST_NB) {
+			// dummy or empty burst, nothing to equalize
+		} else if(pool) {
+			if(pool->submit(fn, ts, buf, buf_len, nb_m, toa, window, dev[ts])) {
+				r = -1;
+				break;
+			}
+		} else {
+			t_toa = toa + dev[ts];
+			if((b = demod_burst_tracked(sps, &b_len, buf, buf_len, nb_m, 0, &t_toa, window, &snr, &scratch))) {
+				dt = (t_toa - toa - dev[ts]) / sps;
+				dev[ts] += TOA_GAIN * (t_toa - toa - dev[ts]);
+				if(b_len > DATA_LEN)
+					b_len = DATA_LEN;
+				llr_from_soft(l, b, b_len);
+				delete[] b;
+				if(cb)
+					cb(ctx, fn, ts, dt, snr, l, b_len);
+			}
+		}
+
+		if(++ts == 8) {
+			ts = 0;
+			fn = (fn + 1) % MAX_FN;
+			frames += 1;
+		}
+	}
+
+	// everything we saw is delivered before we return
+	if(pool)
+		pool->drain();
+	delete[] scratch.c;
+	delete bc;
+
+	return r;
+}
+
+
+/*
+ * Length of the burst windows camp demodulates (see get_burst).
+ */
+unsigned int camp_window_len(const float sps) {
+
+	return (unsigned int)ceil(BURST_LEN * sps) + 2 * (unsigned int)ceil(MARGIN * sps) + 1;
+}
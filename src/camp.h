@@ -0,0 +1,9 @@
+#pragma once
+#include "sample_source.h"
+#include "burst_pool.h"
+
+int camp_acquire(sample_source *u, const mtsc_s *m, int *fn, int *bsic);
+int camp(sample_source *u, const int bsic, burst_cb_t cb, void *ctx,
+   const unsigned int max_frames = 0, burst_pool *pool = 0,
+   volatile int *stop = 0);
+unsigned int camp_window_len(const float sps);
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdexcept>
+
+#include "arfcn_freq.h"
+#include "cell_db.h"
+
+
+static const char * const cell_db_name = ".layer1_usrp_cells";
+
+
+/*
+ * Open the database at path, or ~/.layer1_usrp_cells by default.  A missing
+ * file is an empty database.
+ */
+cell_db::cell_db(const char *path) {
+
+	const char *home;
+
+	if(path) {
+		m_path = strdup(path);
+	} else {
+		if(!(home = getenv("HOME")))
+			throw std::runtime_error("cell_db: no path and no HOME");
+		if((m_path = (char *)malloc(strlen(home) + strlen(cell_db_name) + 2)))
+			sprintf(m_path, "%s/%s", home, cell_db_name);
+	}
+	if(!m_path)
+		throw std::runtime_error("cell_db: malloc");
+
+	m_cells = new cell_s[MAX_CELLS];
+	m_n_cells = 0;
+	memset(m_index, 0xff, sizeof(m_index));
+	m_clock_ppm = 0.0;
+	m_clock_when = 0;
+
+	load();
+}
+
+
+cell_db::~cell_db() {
+
+	delete[] m_cells;
+	free(m_path);
+}
+
+
+cell_s *cell_db::find(const int bi, const int arfcn) {
+
+	if((bi < 0) || (bi >= (int)N_BANDS) || (arfcn < 0) || (arfcn >= (int)MAX_ARFCN))
+		return 0;
+	if(m_index[bi][arfcn] < 0)
+		return 0;
+	return &m_cells[m_index[bi][arfcn]];
+}
+
+
+/*
+ * The cell to update for a band and ARFCN, added if it isn't known yet.
+ */
+cell_s *cell_db::update(const int bi, const int arfcn) {
+
+	cell_s *c;
+
+	if((c = find(bi, arfcn)))
+		return c;
+	if((bi <= BI_NOT_DEFINED) || (bi >= (int)N_BANDS) || (arfcn < 0) || (arfcn >= (int)MAX_ARFCN))
+		return 0;
+	if(m_n_cells >= MAX_CELLS) {
+		fprintf(stderr, "error: cell_db: full\n");
+		return 0;
+	}
+
+	c = &m_cells[m_n_cells];
+	memset(c, 0, sizeof(*c));
+	c->bi = bi;
+	c->arfcn = arfcn;
+	c->bsic = -1;
+	m_index[bi][arfcn] = m_n_cells++;
+	return c;
+}
+
+
+/*
+ * Number of cells in a band.
+ */
+unsigned int cell_db::count(const int bi) {
+
+	unsigned int i, n = 0;
+
+	for(i = 0; i < m_n_cells; i++)
+		if(m_cells[i].bi == bi)
+			n += 1;
+	return n;
+}
+
+
+cell_s *cell_db::get(const unsigned int i) {
+
+	if(i >= m_n_cells)
+		return 0;
+	return &m_cells[i];
+}
+
+
+unsigned int cell_db::size() {
+
+	return m_n_cells;
+}
+
+
+/*
+ * The device's clock error as last measured, in parts per million.
+ *
+ * 	returns	-1 if it was never measured
+ */
+int cell_db::clock_error(float *ppm, time_t *when) {
+
+	if(!m_clock_when)
+		return -1;
+	if(ppm)
+		*ppm = m_clock_ppm;
+	if(when)
+		*when = m_clock_when;
+	return 0;
+}
+
+
+void cell_db::set_clock_error(const float ppm) {
+
+	m_clock_ppm = ppm;
+	m_clock_when = time(0);
+}
+
+
+/*
+ * Lines are "clock <ppm> <time>" or
+ * "cell <band> <arfcn> <power> <offset> <bsic> <time>".  Lines that don't
+ * parse are skipped.
+ */
+int cell_db::load() {
+
+	int bi, arfcn, bsic;
+	unsigned int line = 0;
+	long when;
+	float offset, ppm;
+	double power;
+	char buf[BUFSIZ], band[32];
+	FILE *fp;
+	cell_s *c;
+
+	if(!(fp = fopen(m_path, "r"))) {
+		if(errno == ENOENT)
+			return 0;
+		perror(m_path);
+		return -1;
+	}
+
+	while(fgets(buf, sizeof(buf), fp)) {
+		line += 1;
+		if((buf[0] == '#') || (buf[0] == '\n'))
+			continue;
+
+		if(sscanf(buf, "clock %f %ld", &ppm, &when) == 2) {
+			m_clock_ppm = ppm;
+			m_clock_when = when;
+			continue;
+		}
+		if((sscanf(buf, "cell %31s %d %lf %f %d %ld", band, &arfcn, &power, &offset, &bsic, &when) == 6) &&
+		   ((bi = str_to_bi(band)) > BI_NOT_DEFINED) && (c = update(bi, arfcn))) {
+			c->power = power;
+			c->offset = offset;
+			c->bsic = bsic;
+			c->last_seen = when;
+			continue;
+		}
+		fprintf(stderr, "warning: %s:%u: bad line\n", m_path, line);
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+
+int cell_db::save() {
+
+	int r;
+	unsigned int i;
+	char *tmp;
+	FILE *fp;
+	cell_s *c;
+
+	if(!(tmp = (char *)malloc(strlen(m_path) + 32))) {
+		fprintf(stderr, "error: cell_db::save: malloc\n");
+		return -1;
+	}
+	sprintf(tmp, "%s.%d", m_path, (int)getpid());
+
+	if(!(fp = fopen(tmp, "w"))) {
+		perror(tmp);
+		free(tmp);
+		return -1;
+	}
+	fprintf(fp, "# layer1_usrp cell database\n");
+	if(m_clock_when)
+		fprintf(fp, "clock %f %ld\n", m_clock_ppm, (long)m_clock_when);
+	for(i = 0; i < m_n_cells; i++) {
+		c = &m_cells[i];
+		fprintf(fp, "cell %s %d %f %f %d %ld\n", bi_to_str(c->bi), c->arfcn, c->power, c->offset, c->bsic, (long)c->last_seen);
+	}
+
+	// the new file must be on disk before it replaces the old one
+	r = (fflush(fp) == EOF) || (fsync(fileno(fp)) == -1);
+	if((fclose(fp) == EOF) || r) {
+		perror(tmp);
+		unlink(tmp);
+		free(tmp);
+		return -1;
+	}
+	if(rename(tmp, m_path) == -1) {
+		perror("rename");
+		unlink(tmp);
+		free(tmp);
+		return -1;
+	}
+	free(tmp);
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <time.h>
+
+typedef struct {
+	int		bi;
+	int		arfcn;
+	double		power;
+	float		offset;		// frequency offset seen by the device (Hz)
+	int		bsic;		// -1 if not known
+	time_t		last_seen;
+} cell_s;
+
+
+/*
+ * cell_db
+ *
+ * The C0 carriers found on earlier runs, kept in a text file so a restart
+ * can check the known cells instead of sweeping whole bands.  Besides the
+ * cells it keeps the device's clock error as last measured.
+ *
+ * Cells are looked up by band and ARFCN through an in-memory index.  save
+ * writes a new file next to the old one and renames it into place, so a
+ * crash never leaves a half written database.
+ */
+class cell_db {
+public:
+	cell_db(const char *path = 0);
+	~cell_db();
+
+	cell_s *find(const int bi, const int arfcn);
+	cell_s *update(const int bi, const int arfcn);
+	unsigned int count(const int bi);
+	cell_s *get(const unsigned int i);
+	unsigned int size();
+
+	int clock_error(float *ppm, time_t *when);
+	void set_clock_error(const float ppm);
+
+	int load();
+	int save();
+
+private:
+	static const unsigned int	N_BANDS		= 6;
+	static const unsigned int	MAX_ARFCN	= 1024;
+	static const unsigned int	MAX_CELLS	= 1024;
+
+	char *		m_path;
+	cell_s *	m_cells;
+	unsigned int	m_n_cells;
+	short		m_index[N_BANDS][MAX_ARFCN];	// into m_cells, -1 if none
+
+	float		m_clock_ppm;
+	time_t		m_clock_when;	// 0 if never measured
+};
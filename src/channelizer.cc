@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "dsp.h"
+#include "fcch_detector.h"
+#include "channelizer.h"
+
+
+static unsigned long long gcd(unsigned long long a, unsigned long long b) {
+
+	unsigned long long t;
+
+	while(b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+/*
+ * The sample rate must be a whole number of Hz so the resampling ratio is
+ * exact.
+ */
+channelizer::channelizer(const double sample_rate, const unsigned int n_chans,
+   const unsigned int sps) {
+
+	static const unsigned int MAX_L = 1024;
+
+	unsigned int i;
+	unsigned long long num, den, g;
+	double in_rate, out_rate;
+
+	if((n_chans < 2) || (!sps))
+		throw std::runtime_error("channelizer: bad number of channels");
+	if(fabs(sample_rate - round(sample_rate)) > 1e-3)
+		throw std::runtime_error("channelizer: sample rate isn't a whole number");
+
+	m_sample_rate = sample_rate;
+	m_n_chans = n_chans;
+	m_sps = sps;
+	m_D = n_chans / 2;
+
+	// GSM_RATE is 1625000 / 6
+	num = (unsigned long long)sps * 1625000ull * m_D;
+	den = 6ull * (unsigned long long)round(sample_rate);
+	g = gcd(num, den);
+	m_L = num / g;
+	m_M = den / g;
+	if(m_L > MAX_L)
+		throw std::runtime_error("channelizer: resampling ratio too large");
+
+	// the bank lets the middle of each channel through and stops well
+	// before the image at twice the spacing
+	m_h_len = n_chans * BANK_TAPS;
+	m_h = new float[m_h_len];
+	design(m_h, m_h_len, 0.55 / n_chans, 1.0);
+
+	in_rate = sample_rate / m_D;
+	out_rate = sps * GSM_RATE;
+	m_rs_h = new float[m_L * RS_TAPS];
+	design(m_rs_h, m_L * RS_TAPS, 0.5 * ((in_rate < out_rate)? in_rate : out_rate) / (m_L * in_rate), m_L);
+
+	m_x = new complex[m_h_len + BLOCK_LEN];
+	m_rs_len = RS_TAPS + BLOCK_LEN / m_D + 1;
+	m_out = new complex[(unsigned int)ceil((double)m_rs_len * m_L / m_M) + 1];
+
+	m_enabled = new int[n_chans];
+	m_y = new complex *[n_chans];
+	m_y_len = new unsigned int[n_chans];
+	m_t = new unsigned int[n_chans];
+	m_cb = new circular_buffer *[n_chans];
+	for(i = 0; i < n_chans; i++) {
+		m_enabled[i] = 0;
+		m_y[i] = 0;
+		m_cb[i] = 0;
+	}
+
+	m_fft_in = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n_chans);
+	m_fft_out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * n_chans);
+	if((!m_fft_in) || (!m_fft_out))
+		throw std::runtime_error("channelizer: fftw_malloc failed!");
+
+	pthread_mutex_lock(&g_fftw_mutex);
+	m_plan = fftw_plan_dft_1d(n_chans, m_fft_in, m_fft_out, FFTW_BACKWARD, FFTW_MEASURE);
+	if(!m_plan) {
+		pthread_mutex_unlock(&g_fftw_mutex);
+		throw std::runtime_error("channelizer: fftw plan failed!");
+	}
+	g_fftw_users += 1;
+	pthread_mutex_unlock(&g_fftw_mutex);
+
+	reset();
+}
+
+
+channelizer::~channelizer() {
+
+	unsigned int i;
+
+	pthread_mutex_lock(&g_fftw_mutex);
+	fftw_destroy_plan(m_plan);
+	if(--g_fftw_users == 0)
+		fftw_cleanup();
+	pthread_mutex_unlock(&g_fftw_mutex);
+
+	fftw_free(m_fft_in);
+	fftw_free(m_fft_out);
+
+	for(i = 0; i < m_n_chans; i++) {
+		delete[] m_y[i];
+		delete m_cb[i];
+	}
+	delete[] m_cb;
+	delete[] m_t;
+	delete[] m_y_len;
+	delete[] m_y;
+	delete[] m_enabled;
+	delete[] m_out;
+	delete[] m_x;
+	delete[] m_rs_h;
+	delete[] m_h;
+}
+
+
+/*
+ * Blackman windowed sinc with cutoff fc (cycles / sample) and DC gain gain.
+ */
+void channelizer::design(float *h, const unsigned int h_len, const float fc,
+   const float gain) {
+
+	unsigned int i;
+	float c, sum = 0.0;
+
+	c = (h_len - 1) / 2.0;
+	for(i = 0; i < h_len; i++) {
+		h[i] = sinc(2.0 * M_PI * fc * (i - c)) *
+		   (0.42 - 0.5 * cos(2.0 * M_PI * i / (h_len - 1)) +
+		   0.08 * cos(4.0 * M_PI * i / (h_len - 1)));
+		sum += h[i];
+	}
+	for(i = 0; i < h_len; i++)
+		h[i] *= gain / sum;
+}
+
+
+double channelizer::sample_rate() {
+
+	return m_sample_rate;
+}
+
+
+double channelizer::output_rate() {
+
+	return m_sps * GSM_RATE;
+}
+
+
+double channelizer::spacing() {
+
+	return m_sample_rate / m_n_chans;
+}
+
+
+unsigned int channelizer::n_chans() {
+
+	return m_n_chans;
+}
+
+
+/*
+ * The channel centred offset Hz from the tuned frequency, or -1 if there is
+ * none.  The channel at the Nyquist frequency is never usable.
+ */
+int channelizer::chan(const double offset) {
+
+	double k;
+
+	k = offset / spacing();
+	if((fabs(k - round(k)) > 0.01) || (fabs(k) >= m_n_chans / 2.0))
+		return -1;
+	return ((int)round(k) + (int)m_n_chans) % (int)m_n_chans;
+}
+
+
+/*
+ * Start or stop resampling channel k.  An enabled channel starts empty.
+ */
+void channelizer::enable(const unsigned int k, const int on) {
+
+	if(k >= m_n_chans)
+		return;
+
+	if(on && (!m_cb[k])) {
+		m_y[k] = new complex[m_rs_len];
+		m_cb[k] = new circular_buffer(CHAN_CB_LEN, sizeof(complex), 0);
+	}
+	m_enabled[k] = on;
+	if(m_cb[k]) {
+		memset(m_y[k], 0, (RS_TAPS - 1) * sizeof(complex));
+		m_y_len[k] = RS_TAPS - 1;
+		m_t[k] = (RS_TAPS - 1) * m_L;
+		m_cb[k]->flush();
+	}
+}
+
+
+circular_buffer *channelizer::get_buffer(const unsigned int k) {
+
+	if(k >= m_n_chans)
+		return 0;
+	return m_cb[k];
+}
+
+
+/*
+ * Samples dropped because a channel's buffer was full.
+ */
+unsigned int channelizer::overruns() {
+
+	return m_overruns;
+}
+
+
+/*
+ * Forget the input so far, as after retuning, and empty every channel.
+ */
+void channelizer::reset() {
+
+	unsigned int i;
+
+	memset(m_x, 0, (m_h_len - 1) * sizeof(complex));
+	m_x_len = m_h_len - 1;
+	m_x_next = m_h_len - 1;
+	m_rot = 0;
+	m_overruns = 0;
+	for(i = 0; i < m_n_chans; i++)
+		if(m_enabled[i])
+			enable(i);
+}
+
+
+/*
+ * One output of every channel, x being the newest input.
+ *
+ * Branch m sums the taps h[m + pM].  Channel k is the inverse DFT of the
+ * branches, mixed down by k * (samples so far) / M cycles, which rotates the
+ * branches by the number of samples so far mod M.
+ */
+void channelizer::filter_bank(const complex *x) {
+
+	unsigned int i, m, k;
+
+	memset(m_fft_in, 0, m_n_chans * sizeof(fftw_complex));
+	for(i = 0, m = (m_n_chans - m_rot) % m_n_chans; i < m_h_len; i++) {
+		m_fft_in[m][0] += m_h[i] * x[-(int)i].real();
+		m_fft_in[m][1] += m_h[i] * x[-(int)i].imag();
+		if(++m == m_n_chans)
+			m = 0;
+	}
+
+	fftw_execute(m_plan);
+
+	for(k = 0; k < m_n_chans; k++) {
+		if(!m_enabled[k])
+			continue;
+		m_y[k][m_y_len[k]++] = complex(m_fft_out[k][0], m_fft_out[k][1]);
+	}
+}
+
+
+/*
+ * Output whatever channel k's bank outputs so far allow and keep the last
+ * RS_TAPS - 1 of them.
+ */
+void channelizer::resample(const unsigned int k) {
+
+	unsigned int i, j, n, w, ph, keep;
+	const float *h;
+	complex *y = m_y[k], acc;
+
+	n = 0;
+	while((i = m_t[k] / m_L) < m_y_len[k]) {
+		ph = m_t[k] % m_L;
+		h = m_rs_h + ph;
+		acc = 0.0;
+		for(j = 0; j < RS_TAPS; j++)
+			acc += h[j * m_L] * y[i - j];
+		m_out[n++] = acc;
+		m_t[k] += m_M;
+	}
+	if(n && ((w = m_cb[k]->write(m_out, n)) < n))
+		m_overruns += n - w;
+
+	keep = m_y_len[k] - (RS_TAPS - 1);
+	memmove(y, y + keep, (RS_TAPS - 1) * sizeof(complex));
+	m_y_len[k] = RS_TAPS - 1;
+	m_t[k] -= keep * m_L;
+}
+
+
+/*
+ * Channelize s_len more samples of a capture.
+ */
+int channelizer::process(const complex *s, const unsigned int s_len) {
+
+	unsigned int n, k, left = s_len, keep;
+
+	while(left) {
+		n = (left < BLOCK_LEN)? left : BLOCK_LEN;
+		memcpy(m_x + m_x_len, s, n * sizeof(complex));
+		m_x_len += n;
+		s += n;
+		left -= n;
+
+		while(m_x_next < m_x_len) {
+			filter_bank(m_x + m_x_next);
+			m_x_next += m_D;
+			m_rot = (m_rot + m_D) % m_n_chans;
+		}
+
+		for(k = 0; k < m_n_chans; k++)
+			if(m_enabled[k])
+				resample(k);
+
+		// the next output needs the m_h_len - 1 samples before it
+		keep = m_x_next - (m_h_len - 1);
+		if(keep > m_x_len)
+			keep = m_x_len;
+		memmove(m_x, m_x + keep, (m_x_len - keep) * sizeof(complex));
+		m_x_len -= keep;
+		m_x_next -= keep;
+	}
+
+	return 0;
+}
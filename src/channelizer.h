@@ -0,0 +1,80 @@
+#pragma once
+
+#include <fftw3.h>
+
+#include "circular_buffer.h"
+#include "usrp_complex.h"
+
+/*
+ * channelizer
+ *
+ * Splits one wideband capture into n_chans channels spaced sample_rate /
+ * n_chans apart with a polyphase FFT filter bank.  Channel k is centred k
+ * spacings above the tuned frequency, and channel n_chans - k is k spacings
+ * below it.
+ *
+ * The bank decimates by n_chans / 2, so each channel comes out at twice the
+ * channel spacing.  A polyphase resampler then brings each enabled channel to
+ * sps samples per GSM symbol.  For a 200kHz spacing that is 400kHz to
+ * 270.833kHz, a ratio of 65/96.  Every channel is filtered, but only enabled
+ * channels are resampled and written to their own circular_buffer.
+ *
+ * Channels near the edges of the capture are attenuated by the radio's
+ * anti-alias filter, so callers should only use the inner ones.
+ */
+class channelizer {
+public:
+	channelizer(const double sample_rate, const unsigned int n_chans,
+	   const unsigned int sps = 1);
+	~channelizer();
+
+	double sample_rate();
+	double output_rate();
+	double spacing();
+	unsigned int n_chans();
+	int chan(const double offset);
+
+	void enable(const unsigned int k, const int on = 1);
+	int process(const complex *s, const unsigned int s_len);
+	circular_buffer *get_buffer(const unsigned int k);
+	unsigned int overruns();
+	void reset();
+
+private:
+	void design(float *h, const unsigned int h_len, const float fc,
+	   const float gain);
+	void filter_bank(const complex *x);
+	void resample(const unsigned int k);
+
+	static const unsigned int	BANK_TAPS	= 16;	// per branch
+	static const unsigned int	RS_TAPS		= 24;	// per phase
+	static const unsigned int	BLOCK_LEN	= 8192;	// input samples
+	static const unsigned int	CHAN_CB_LEN	= (1 << 18);
+
+	double			m_sample_rate;
+	unsigned int		m_n_chans;
+	unsigned int		m_sps;
+	unsigned int		m_D;		// filter bank decimation
+
+	float *			m_h;		// prototype, n_chans * BANK_TAPS
+	unsigned int		m_h_len;
+	complex *		m_x;		// input history
+	unsigned int		m_x_len;
+	unsigned int		m_x_next;	// where the next bank output is due
+	unsigned int		m_rot;		// input samples mod n_chans
+
+	unsigned int		m_L, m_M;	// resampler ratio
+	float *			m_rs_h;		// m_L * RS_TAPS
+	unsigned int		m_rs_len;	// room for bank outputs per channel
+
+	int *			m_enabled;
+	complex **		m_y;		// bank outputs per channel
+	unsigned int *		m_y_len;
+	unsigned int *		m_t;		// resampler time in 1/m_L inputs
+	complex *		m_out;
+	circular_buffer **	m_cb;
+	unsigned int		m_overruns;
+
+	fftw_complex		*m_fft_in, *m_fft_out;
+	fftw_plan		m_plan;
+};
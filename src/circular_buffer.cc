@@ -163,6 +163,7 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 
 	m_r = m_w = 0;
 	m_read = m_written = 0;
+	m_consumed = 0;
 
 	m_item_size = item_size;
 
@@ -284,6 +285,7 @@ circular_buffer::circular_buffer(const unsigned int buf_len,
 
 	m_r = m_w = 0;
 	m_read = m_written = 0;
+	m_consumed = 0;
 
 	m_item_size = item_size;
 
@@ -347,6 +349,7 @@ unsigned int circular_buffer::read(void *buf, const unsigned int buf_len) {
 	len = MIN(buf_len, m_written - m_read);
 	memcpy(buf, (char *)m_buf + m_r, len * m_item_size);
 	m_read += len;
+	m_consumed += len;
 	if(m_read == m_written) {
 		m_r = m_w = 0;
 		m_read = m_written = 0;
@@ -405,6 +408,7 @@ unsigned int circular_buffer::purge(const unsigned int buf_len) {
 	pthread_mutex_lock(&m_mutex);
 	len = MIN(buf_len, m_written - m_read);
 	m_read += len;
+	m_consumed += len;
 	if(m_read == m_written) {
 		m_r = m_w = 0;
 		m_read = m_written = 0;
@@ -435,6 +439,7 @@ unsigned int circular_buffer::write(const void *buf,
 	m_written += len;
 	m_w = (m_w + len * m_item_size) % m_buf_size;
 	if(m_written > m_buf_len + m_read) {
+		m_consumed += m_written - m_buf_len - m_read;
 		m_read = m_written - m_buf_len;
 		m_r = m_w;
 	}
@@ -457,6 +462,7 @@ void circular_buffer::flush() {
 
 	pthread_mutex_lock(&m_mutex);
 	m_read = m_written = 0;
+	m_consumed = 0;
 	m_r = m_w = 0;
 	pthread_mutex_unlock(&m_mutex);
 }
@@ -465,10 +471,28 @@ void circular_buffer::flush() {
 void circular_buffer::flush_nolock() {
 
 	m_read = m_written = 0;
+	m_consumed = 0;
 	m_r = m_w = 0;
 }
 
 
+/*
+ * Absolute index of the item returned first by peek(), i.e., the number of
+ * items read or purged since the last flush.  Unlike m_read, this is not reset
+ * when the buffer empties.
+ */
+unsigned long long circular_buffer::consumed() {
+
+	unsigned long long c;
+
+	pthread_mutex_lock(&m_mutex);
+	c = m_consumed;
+	pthread_mutex_unlock(&m_mutex);
+
+	return c;
+}
+
+
 void circular_buffer::lock() {
 
 	pthread_mutex_lock(&m_mutex);
@@ -64,11 +64,13 @@ public:
 	void lock();
 	void unlock();
 	unsigned int buf_len();
+	unsigned long long consumed();
 
 private:
 	void *m_buf;
 	unsigned int m_buf_len, m_buf_size, m_r, m_w, m_item_size;
 	unsigned long long m_read, m_written;
+	unsigned long long m_consumed;
 
 	unsigned int m_overwrite;
 
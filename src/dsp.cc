@@ -21,8 +21,9 @@ static const unsigned int ROTATOR_LEN		= 1024;
 
 static complex *	m_gmsk_rotator = 0;
 static complex *	m_gmsk_rrotator = 0;
-static complex *	m_gaussian_pulse = 0;
-static unsigned int	m_gaussian_pulse_len = 0;
+
+// j^k, the GMSK rotation of symbol k
+static const complex	m_j_pow[4] = {complex(1, 0), complex(0, 1), complex(-1, 0), complex(0, -1)};
 
 
 int build_rotators() {
@@ -132,6 +133,39 @@ float peak_detect(const complex *s, const unsigned int s_len, complex *peak, flo
 }
 
 
+/*
+ * Same as peak_detect for an oversampled s: the strongest sample is refined
+ * by fitting a parabola to its power and its neighbors' rather than with
+ * sinc interpolation.  peak is the strongest sample itself.
+ */
+float peak_detect_parabolic(const complex *s, const unsigned int s_len, complex *peak) {
+
+	unsigned int i, max_i = 0;
+	float p, max = -1.0, l, r, d, toa;
+
+	for(i = 0; i < s_len; i++) {
+		if((p = norm(s[i])) > max) {
+			max = p;
+			max_i = i;
+		}
+	}
+
+	toa = max_i;
+	if((max_i > 0) && (max_i + 1 < s_len)) {
+		l = norm(s[max_i - 1]);
+		r = norm(s[max_i + 1]);
+		d = l - 2.0 * max + r;
+		if(d < 0.0)
+			toa += 0.5 * (l - r) / d;
+	}
+
+	if(peak)
+		*peak = s[max_i];
+
+	return toa;
+}
+
+
 /*
  * The theory is that there should be almost no match in the correlation of an
  * offset training sequence code.  Hence any signal strength near the peak of
@@ -141,17 +175,28 @@ float peak_detect(const complex *s, const unsigned int s_len, complex *peak, flo
  */
 int peak2mean(complex *c, unsigned int c_len, complex peak, unsigned int peak_i, unsigned int width, float *SNR) {
 
+	return peak2mean(c, c_len, peak, peak_i, width, 1, SNR);
+}
+
+
+/*
+ * Same, but the valley is sampled every stride samples (e.g., once per symbol
+ * of an oversampled correlation, whose peak is stride times as wide).
+ */
+int peak2mean(complex *c, unsigned int c_len, complex peak, unsigned int peak_i, unsigned int width, unsigned int stride, float *SNR) {
+
 	float valley = 0.0;
-	unsigned int i, valley_count = 0;
+	unsigned int i, o, valley_count = 0;
 
 	// these constants aren't the best for all burst types
 	for(i = 2; i < 2 + width; i++) {
-		if(i <= peak_i) {
-			valley += norm(c[peak_i - i]);
+		o = i * stride;
+		if(o <= peak_i) {
+			valley += norm(c[peak_i - o]);
 			valley_count += 1;
 		}
-		if(peak_i + i < c_len) {
-			valley += norm(c[peak_i + i]);
+		if(peak_i + o < c_len) {
+			valley += norm(c[peak_i + o]);
 			valley_count += 1;
 		}
 	}
@@ -207,7 +252,7 @@ int gmsk_rrotate(complex *v, const unsigned int len) {
 	if(len > ROTATOR_LEN)
 		return -1;
 	if(!m_gmsk_rrotator)
-		if(!build_rotators())
+		if(build_rotators())
 			return -1;
 
 	for(i = 0, c = v, r = m_gmsk_rrotator; i < len; i++, c++, r++)
@@ -379,24 +424,21 @@ complex *convolve(const complex *s, const unsigned int s_len, const complex *h,
 
 void convolve_nodelay(complex *y, const complex *s, const unsigned int s_len, const complex *h, const unsigned int h_len) {
 
-	unsigned int d, n, i;
+	unsigned int d, n, i, hi;
 
+	// only s[n + d - h_len + 1] through s[n + d] meet the filter
 	d = (h_len - 1) / 2;
 	for(n = 0; n < s_len; n++) {
 		y[n] = 0.0;
-		for(i = 0; i < s_len; i++) {
-			if(i > n + d)
-				break;
-			if(n + d < h_len + i)
-				y[n] += s[i] * h[n + d - i];
-		}
+		hi = (n + d < s_len)? n + d : s_len - 1;
+		for(i = (n + d + 1 > h_len)? n + d + 1 - h_len : 0; i <= hi; i++)
+			y[n] += s[i] * h[n + d - i];
 	}
 }
 
 
 complex *convolve_nodelay(const complex *s, const unsigned int s_len, const complex *h, const unsigned int h_len, unsigned int *len_o) {
 
-	unsigned int n, d, i;
 	complex *y = new complex[s_len];
 
 	if(!y) {
@@ -406,16 +448,7 @@ complex *convolve_nodelay(const complex *s, const unsigned int s_len, const comp
 		return 0;
 	}
 
-	d = (h_len - 1) / 2;
-	for(n = 0; n < s_len; n++) {
-		y[n] = 0.0;
-		for(i = 0; i < s_len; i++) {
-			if(i > n + d)
-				break;
-			if(n + d < h_len + i)
-				y[n] += s[i] * h[n + d - i];
-		}
-	}
+	convolve_nodelay(y, s, s_len, h, h_len);
 
 	if(len_o)
 		*len_o = s_len;
@@ -456,9 +489,25 @@ complex *correlate(const complex *s1, const unsigned int s1_len, const complex *
 }
 
 
-complex *correlate_nodelay(const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, unsigned int *len_o) {
+void correlate_nodelay(complex *y, const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len) {
 
 	unsigned int n, d, i;
+
+	d = (s2_len - 1) / 2;
+	for(n = 0; n < s1_len; n++) {
+		y[n] = 0.0;
+		for(i = 0; i < s1_len; i++) {
+			if(i > n + d)
+				break;
+			if(n + d < s2_len + i)
+				y[n] += s1[i] * std::conj(s2[s2_len - 1 + i - n - d]);
+		}
+	}
+}
+
+
+complex *correlate_nodelay(const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, unsigned int *len_o) {
+
 	complex *y = new complex[s1_len];
 
 	if(!y) {
@@ -468,16 +517,55 @@ complex *correlate_nodelay(const complex *s1, const unsigned int s1_len, const c
 		return 0;
 	}
 
-	d = (s2_len - 1) / 2;
-	for(n = 0; n < s1_len; n++) {
+	correlate_nodelay(y, s1, s1_len, s2, s2_len);
+
+	if(len_o)
+		*len_o = s1_len;
+
+	return y;
+}
+
+
+/*
+ * Same as correlate_nodelay but only y[os] through y[os + len - 1] are
+ * computed and the rest of y is zero.  This costs len * s2_len rather than
+ * s1_len * s2_len when we know roughly where the peak will be.
+ */
+void correlate_nodelay_window(complex *y, const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, const unsigned int os, const unsigned int len) {
+
+	int k;
+	unsigned int n, m, d, end;
+
+	for(n = 0; n < s1_len; n++)
 		y[n] = 0.0;
-		for(i = 0; i < s1_len; i++) {
-			if(i > n + d)
+
+	d = (s2_len - 1) / 2;
+	end = (os + len < s1_len)? os + len : s1_len;
+	for(n = os; n < end; n++) {
+		for(m = 0; m < s2_len; m++) {
+			k = (int)(n + d + m) - (int)s2_len + 1;
+			if(k < 0)
+				continue;
+			if(k >= (int)s1_len)
 				break;
-			if(n + d < s2_len + i)
-				y[n] += s1[i] * std::conj(s2[s2_len - 1 + i - n - d]);
+			y[n] += s1[k] * std::conj(s2[m]);
 		}
 	}
+}
+
+
+complex *correlate_nodelay_window(const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, const unsigned int os, const unsigned int len, unsigned int *len_o) {
+
+	complex *y = new complex[s1_len];
+
+	if(!y) {
+		fprintf(stderr, "error: correlate_nodelay_window: new failed\n");
+		if(len_o)
+			*len_o = 0;
+		return 0;
+	}
+
+	correlate_nodelay_window(y, s1, s1_len, s2, s2_len, os, len);
 
 	if(len_o)
 		*len_o = s1_len;
@@ -603,40 +691,35 @@ complex *generate_gaussian_pulse(float sps, unsigned int *len_o) {
 }
 
 
+/*
+ * Symbol k is placed at sample k * floor(sps), rotated by j^k and shaped with
+ * a gaussian pulse for sps.
+ */
 complex *modulate(const unsigned char *bv, const unsigned int bv_len, const unsigned int guard_len, float sps, unsigned int *len_o) {
 
-	unsigned int i, len, m_len;
-	complex *c, *m;
+	unsigned int i, len, m_len, pulse_len;
+	complex *c, *m, *pulse;
 
 	len = (unsigned int)ceil(sps * (bv_len + guard_len));
 	complex bv_p[len];
 	memset(bv_p, 0, sizeof(complex) * len);
 
-	// polarize bv
+	// polarize and rotate bv
 	c = bv_p;
 	for(i = 0; i < bv_len; i++) {
-		*c = 1.0 - 2.0 * bv[i];
+		*c = (float)(1.0 - 2.0 * bv[i]) * m_j_pow[i % 4];
 		c += (unsigned int)floor(sps);
 	}
 
-	// rotate
-	if(gmsk_rotate(bv_p, len)) {
+	if(!(pulse = generate_gaussian_pulse(sps, &pulse_len))) {
 		if(len_o)
 			*len_o = 0;
 		return 0;
 	}
 
-	if(!m_gaussian_pulse) {
-		m_gaussian_pulse = generate_gaussian_pulse(1.0, &m_gaussian_pulse_len);
-		if(!m_gaussian_pulse) {
-			if(len_o)
-				*len_o = 0;
-			return 0;
-		}
-	}
-
 	// convolve with gaussian pulse
-	m = convolve_nodelay(bv_p, len, m_gaussian_pulse, m_gaussian_pulse_len, &m_len);
+	m = convolve_nodelay(bv_p, len, pulse, pulse_len, &m_len);
+	delete[] pulse;
 
 	if(len_o)
 		*len_o = m_len;
@@ -645,6 +728,134 @@ complex *modulate(const unsigned char *bv, const unsigned int bv_len, const unsi
 }
 
 
+/*
+ * Correlation of s1 with taps t_lo through t_hi - 1 of pulse, the pulse
+ * starting at s1[k].
+ */
+static void correlate_pulse(const complex *s1, const unsigned int s1_len,
+   const complex *pulse, const int k, unsigned int t_lo, unsigned int t_hi,
+   float *r_o, float *i_o) {
+
+	float h, r = 0.0, i = 0.0;
+
+	if(k + (int)t_lo < 0)
+		t_lo = -k;
+	if(k + (int)t_hi > (int)s1_len)
+		t_hi = (k < (int)s1_len)? (int)s1_len - k : 0;
+	for(; t_lo < t_hi; t_lo++) {
+		h = pulse[t_lo].real();
+		r += s1[k + t_lo].real() * h;
+		i += s1[k + t_lo].imag() * h;
+	}
+	*r_o = r;
+	*i_o = i;
+}
+
+
+/*
+ * Correlate s1 with n modulated bit sequences of the same length at once.
+ * Row i of y (y + i * s1_len) gets what correlate_nodelay_window would give
+ * for s1 and generate_modulated_tsc(sps, bv[i], bv_len, bv_offset, ...).  The
+ * rest of each row is zero.  y must have room for n * s1_len samples.
+ *
+ * modulate is linear in the polarized bits, so each correlation is a sum of
+ * the correlations of s1 with the rotated pulse of each bit, added or
+ * subtracted.  s1 is correlated with the pulse only once and, as
+ * sum(+/-u) = sum(u) - 2 * sum(u where the bit is 1), each sequence then
+ * costs about bv_len / 2 additions per output.
+ */
+int correlate_bits_nodelay_window(complex *y, const complex *s1, const unsigned int s1_len, const unsigned char * const *bv, const unsigned int n, const unsigned int bv_len, const unsigned int bv_offset, const float sps, const unsigned int os, const unsigned int len) {
+
+	int base, m;
+	unsigned int p, i, j, fs, s2_len, end, q_len, t_lo, t_hi, *o, o_len[n], pulse_len;
+	float ur, ui, tr, ti, u_r[bv_len], u_i[bv_len];
+	complex *pulse;
+
+	memset(y, 0, sizeof(complex) * n * s1_len);
+
+	fs = (unsigned int)floor(sps);
+	s2_len = (unsigned int)ceil(sps * bv_len);
+	end = (os + len < s1_len)? os + len : s1_len;
+	if(end <= os)
+		return 0;
+
+	if(!(pulse = generate_gaussian_pulse(sps, &pulse_len)))
+		return -1;
+
+	// which bits of each sequence are set
+	unsigned int ones[n * bv_len];
+	for(i = 0; i < n; i++) {
+		o = ones + i * bv_len;
+		o_len[i] = 0;
+		for(j = 0; j < bv_len; j++)
+			if(bv[i][j])
+				o[o_len[i]++] = j;
+	}
+
+	/*
+	 * The pulse of bit j for output p starts at s1[base + p + j * fs].  q
+	 * holds the whole pulse correlation for every start we need.
+	 */
+	base = (int)((s2_len - 1) / 2) - (int)s2_len + 1 - (int)((pulse_len - 1) / 2);
+	q_len = end - os + (bv_len - 1) * fs;
+	float q_r[q_len], q_i[q_len];
+	for(i = 0; i < q_len; i++)
+		correlate_pulse(s1, s1_len, pulse, base + (int)(os + i), 0, pulse_len, &q_r[i], &q_i[i]);
+
+	for(p = os; p < end; p++) {
+		tr = ti = 0.0;
+		for(j = 0; j < bv_len; j++) {
+
+			// the modulated sequence is cut off at its ends
+			m = (int)(j * fs) - (int)((pulse_len - 1) / 2);
+			t_lo = (m < 0)? -m : 0;
+			t_hi = (m + (int)pulse_len > (int)s2_len)? s2_len - m : pulse_len;
+			if((t_lo > 0) || (t_hi < pulse_len))
+				correlate_pulse(s1, s1_len, pulse, base + (int)(p + j * fs), t_lo, t_hi, &ur, &ui);
+			else {
+				ur = q_r[p - os + j * fs];
+				ui = q_i[p - os + j * fs];
+			}
+
+			// multiply by the conjugate of the bit's rotation
+			switch((j + bv_offset) % 4) {
+				case 0:
+					u_r[j] = ur;
+					u_i[j] = ui;
+					break;
+				case 1:
+					u_r[j] = ui;
+					u_i[j] = -ur;
+					break;
+				case 2:
+					u_r[j] = -ur;
+					u_i[j] = -ui;
+					break;
+				case 3:
+					u_r[j] = -ui;
+					u_i[j] = ur;
+					break;
+			}
+			tr += u_r[j];
+			ti += u_i[j];
+		}
+
+		for(i = 0; i < n; i++) {
+			o = ones + i * bv_len;
+			ur = ui = 0.0;
+			for(j = 0; j < o_len[i]; j++) {
+				ur += u_r[o[j]];
+				ui += u_i[o[j]];
+			}
+			y[i * s1_len + p] = complex(tr - 2.0 * ur, ti - 2.0 * ui);
+		}
+	}
+	delete[] pulse;
+
+	return 0;
+}
+
+
 /*
  * a		signal correlated with tsc
  * a_len	length of the correlation
@@ -693,6 +904,281 @@ complex *generate_channel_response(complex *a, unsigned int a_len, unsigned int
 }
 
 
+/*
+ * Estimate the channel at sample spacing from known symbols.
+ *
+ * 	h	h[j] is the response t0 + j samples after the center of a symbol
+ * 	os	sample at the center of the first known symbol
+ * 	bv	the known bits, bit k rotated by j^(rot + k) as in modulate
+ *
+ * Each tap is the correlation of the samples sps apart, one per known symbol,
+ * with the symbols.  For sequences whose autocorrelation is an impulse over the
+ * lags that matter (e.g., the 16 bit core of the normal burst training
+ * sequences) this is the least squares estimate.
+ */
+void estimate_channel_fs(complex *h, const int t0, const unsigned int h_len, const complex *s, const unsigned int s_len, const int os, const unsigned int sps, const unsigned char *bv, const unsigned int bv_len, const unsigned int rot) {
+
+	int n;
+	unsigned int j, k, lo, hi;
+	float h_r[h_len], h_i[h_len], sign;
+	const complex *x;
+
+	for(j = 0; j < h_len; j++)
+		h_r[j] = h_i[j] = 0.0;
+
+	for(k = 0; k < bv_len; k++) {
+
+		// samples of s that fall in h for this symbol
+		n = os + (int)(k * sps) + t0;
+		lo = (n < 0)? -n : 0;
+		hi = (n + (int)h_len > (int)s_len)? ((n < (int)s_len)? s_len - n : 0) : h_len;
+		if(lo >= hi)
+			continue;
+		x = s + n;
+
+		// multiply by the conjugate of the symbol, +/-1 or +/-j
+		sign = bv[k]? -1.0 : 1.0;
+		switch((rot + k) % 4) {
+			case 0:
+				for(j = lo; j < hi; j++) {
+					h_r[j] += sign * x[j].real();
+					h_i[j] += sign * x[j].imag();
+				}
+				break;
+			case 1:
+				for(j = lo; j < hi; j++) {
+					h_r[j] += sign * x[j].imag();
+					h_i[j] -= sign * x[j].real();
+				}
+				break;
+			case 2:
+				for(j = lo; j < hi; j++) {
+					h_r[j] -= sign * x[j].real();
+					h_i[j] -= sign * x[j].imag();
+				}
+				break;
+			case 3:
+				for(j = lo; j < hi; j++) {
+					h_r[j] -= sign * x[j].imag();
+					h_i[j] += sign * x[j].real();
+				}
+				break;
+		}
+	}
+
+	for(j = 0; j < h_len; j++)
+		h[j] = complex(h_r[j], h_i[j]) / (float)bv_len;
+}
+
+
+/*
+ * Least squares estimator of an L tap channel from known symbols.
+ *
+ * Row n of A holds the symbols L - 1 + n, L - 2 + n, ..., n of bv, bit k
+ * rotated by j^(rot + k) as in modulate.  P = (A^H A)^-1 A^H is L x rows,
+ * rows = bv_len - L + 1, stored by row.  It depends only on the sequence and
+ * L so it is computed once and kept (see get_ls_pinv).
+ *
+ * 	returns	the new P or 0 if A^H A is singular
+ */
+complex *ls_pseudo_inverse(const unsigned char *bv, const unsigned int bv_len, const unsigned int rot, const unsigned int L, unsigned int *rows_o) {
+
+	unsigned int rows, w, n, q, r, c, pivot;
+	float best;
+	complex f, *a, *m, *P;
+
+	if((L < 1) || (bv_len < 2 * L - 1)) {
+		fprintf(stderr, "error: ls_pseudo_inverse: sequence too short for %u taps\n", L);
+		return 0;
+	}
+	rows = bv_len - L + 1;
+
+	a = new complex[bv_len];
+	for(n = 0; n < bv_len; n++)
+		a[n] = (float)(1.0 - 2.0 * bv[n]) * m_j_pow[(rot + n) % 4];
+
+	// [A^H A | A^H], reduced to [I | P]
+	w = L + rows;
+	m = new complex[L * w];
+	for(q = 0; q < L; q++) {
+		for(c = 0; c < L; c++) {
+			f = 0.0;
+			for(n = 0; n < rows; n++)
+				f += conj(a[L - 1 + n - q]) * a[L - 1 + n - c];
+			m[q * w + c] = f;
+		}
+		for(n = 0; n < rows; n++)
+			m[q * w + L + n] = conj(a[L - 1 + n - q]);
+	}
+	delete[] a;
+
+	for(c = 0; c < L; c++) {
+		pivot = c;
+		best = norm(m[c * w + c]);
+		for(r = c + 1; r < L; r++) {
+			if(norm(m[r * w + c]) > best) {
+				best = norm(m[r * w + c]);
+				pivot = r;
+			}
+		}
+		if(best <= 0.0) {
+			delete[] m;
+			return 0;
+		}
+		if(pivot != c) {
+			for(n = 0; n < w; n++) {
+				f = m[c * w + n];
+				m[c * w + n] = m[pivot * w + n];
+				m[pivot * w + n] = f;
+			}
+		}
+		f = complex(1.0, 0.0) / m[c * w + c];
+		for(n = 0; n < w; n++)
+			m[c * w + n] *= f;
+		for(r = 0; r < L; r++) {
+			if((r == c) || (norm(m[r * w + c]) == 0.0))
+				continue;
+			f = m[r * w + c];
+			for(n = 0; n < w; n++)
+				m[r * w + n] -= f * m[c * w + n];
+		}
+	}
+
+	P = new complex[L * rows];
+	for(q = 0; q < L; q++)
+		for(n = 0; n < rows; n++)
+			P[q * rows + n] = m[q * w + L + n];
+	delete[] m;
+
+	if(rows_o)
+		*rows_o = rows;
+
+	return P;
+}
+
+
+/*
+ * Least squares estimate of the channel at sample spacing from known symbols.
+ *
+ * 	h	L * sps taps, h[j] is the response t0 + j samples after the
+ * 		center of a symbol
+ * 	os	sample at the center of the first known symbol
+ * 	P	from ls_pseudo_inverse for bv, rot and L
+ * 	noise	residual power per sample
+ *
+ * Each of the sps phases of the taps sees the same symbols so the estimate is
+ * one L x rows product with P per phase.
+ */
+void estimate_channel_ls(complex *h, const int t0, const unsigned int L, const complex *s, const unsigned int s_len, const int os, const unsigned int sps, const complex *P, const unsigned char *bv, const unsigned int bv_len, const unsigned int rot, float *noise_o) {
+
+	int m;
+	unsigned int rows, phase, q, n, k;
+	float xr[bv_len], xi[bv_len], ar[bv_len], ai[bv_len], hr, hi, pr, pi, er, ei, noise = 0.0;
+
+	rows = bv_len - L + 1;
+	for(n = 0; n < bv_len; n++) {
+		ar[n] = (1.0 - 2.0 * bv[n]) * m_j_pow[(rot + n) % 4].real();
+		ai[n] = (1.0 - 2.0 * bv[n]) * m_j_pow[(rot + n) % 4].imag();
+	}
+
+	for(phase = 0; phase < sps; phase++) {
+
+		// samples t0 + phase after symbols L - 1 .. bv_len - 1
+		for(n = 0; n < rows; n++) {
+			m = os + (int)((L - 1 + n) * sps + phase) + t0;
+			if((m < 0) || (m >= (int)s_len)) {
+				xr[n] = xi[n] = 0.0;
+			} else {
+				xr[n] = s[m].real();
+				xi[n] = s[m].imag();
+			}
+		}
+
+		for(q = 0; q < L; q++) {
+			hr = hi = 0.0;
+			for(n = 0; n < rows; n++) {
+				pr = P[q * rows + n].real();
+				pi = P[q * rows + n].imag();
+				hr += pr * xr[n] - pi * xi[n];
+				hi += pr * xi[n] + pi * xr[n];
+			}
+			h[q * sps + phase] = complex(hr, hi);
+		}
+
+		// what the estimate doesn't explain
+		for(n = 0; n < rows; n++) {
+			er = xr[n];
+			ei = xi[n];
+			for(q = 0; q < L; q++) {
+				k = L - 1 + n - q;
+				hr = h[q * sps + phase].real();
+				hi = h[q * sps + phase].imag();
+				er -= hr * ar[k] - hi * ai[k];
+				ei -= hr * ai[k] + hi * ar[k];
+			}
+			noise += er * er + ei * ei;
+		}
+	}
+
+	if(noise_o)
+		*noise_o = (rows > L)? noise / (sps * (rows - L)) : 0.0;
+}
+
+
+/*
+ * Filter s with the matched filter of h (as from estimate_channel_fs) and
+ * keep one sample per symbol:
+ *
+ * 	y[k] = sum_j conj(h[j]) s[os + k * sps + t0 + j]
+ *
+ * s is split into its sps phases first so that every tap is applied to a
+ * contiguous run of samples.
+ */
+void matched_filter_decimate(complex *y, const unsigned int y_len, const complex *s, const unsigned int s_len, const int os, const unsigned int sps, const complex *h, const int t0, const unsigned int h_len) {
+
+	int n, base;
+	unsigned int k, m, p, j, m_len, p_len;
+	float cr, ci;
+
+	m_len = (h_len + sps - 1) / sps;
+	p_len = y_len + m_len;
+	base = os + t0;
+
+	float yr[y_len], yi[y_len], pr[p_len], pi[p_len];
+	for(k = 0; k < y_len; k++)
+		yr[k] = yi[k] = 0.0;
+
+	for(p = 0; p < sps; p++) {
+
+		// phase p of s
+		for(k = 0; k < p_len; k++) {
+			n = base + (int)(k * sps + p);
+			if((n < 0) || (n >= (int)s_len)) {
+				pr[k] = pi[k] = 0.0;
+			} else {
+				pr[k] = s[n].real();
+				pi[k] = s[n].imag();
+			}
+		}
+
+		// taps m * sps + p
+		for(m = 0; m < m_len; m++) {
+			if((j = m * sps + p) >= h_len)
+				break;
+			cr = h[j].real();
+			ci = -h[j].imag();
+			for(k = 0; k < y_len; k++) {
+				yr[k] += cr * pr[k + m] - ci * pi[k + m];
+				yi[k] += cr * pi[k + m] + ci * pr[k + m];
+			}
+		}
+	}
+
+	for(k = 0; k < y_len; k++)
+		y[k] = complex(yr[k], yi[k]);
+}
+
+
 /*
  *	Fast Computation of Channel-Estimate Based Equalizers in
  *	Packet Data Transmission.
@@ -866,7 +1352,7 @@ float *equalize(complex *v, const unsigned int v_len,
 		}
 
 		// reverse rotate data for output
-		post_forward[i] *= m_gmsk_rrotator[i];
+		post_forward[i] *= conj(m_j_pow[i % 4]);
 
 		// save output
 		DFE_output[i] = post_forward[i];
@@ -875,7 +1361,7 @@ float *equalize(complex *v, const unsigned int v_len,
 		post_forward[i] = (post_forward[i].real() > 0.0)? 1.0 : -1.0;
 
 		// rotate back to be aligned with previous data
-		post_forward[i] *= m_gmsk_rotator[i];
+		post_forward[i] *= m_j_pow[i % 4];
 	}
 
 	// return a soft-slice of values
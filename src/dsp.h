@@ -6,7 +6,9 @@ float vectornorm2(const complex *v, const unsigned int len);
 float sinc(const float x);
 complex interpolate_point(const complex *s, const unsigned int s_len, const float s_i);
 float peak_detect(const complex *s, const unsigned int s_len, complex *peak, float *avg_power);
+float peak_detect_parabolic(const complex *s, const unsigned int s_len, complex *peak);
 int peak2mean(complex *c, unsigned int c_len, complex peak, unsigned int peak_i, unsigned int width, float *p2m);
+int peak2mean(complex *c, unsigned int c_len, complex peak, unsigned int peak_i, unsigned int width, unsigned int stride, float *p2m);
 int gmsk_rotate(complex *v, const unsigned int len, const unsigned int offset);
 int gmsk_rotate(complex *v, const unsigned int len);
 int gmsk_rrotate(complex *v, const unsigned int len);
@@ -23,10 +25,18 @@ complex *convolve(const complex *s, const unsigned int s_len, const complex *h,
 void convolve_nodelay(complex *y, const complex *s, const unsigned int s_len, const complex *h, const unsigned int h_len);
 complex *convolve_nodelay(const complex *s, const unsigned int s_len, const complex *h, const unsigned int h_len, unsigned int *len_o);
 complex *correlate(const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, unsigned int *len_o);
+void correlate_nodelay(complex *y, const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len);
 complex *correlate_nodelay(const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, unsigned int *len_o);
+void correlate_nodelay_window(complex *y, const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, const unsigned int os, const unsigned int len);
+complex *correlate_nodelay_window(const complex *s1, const unsigned int s1_len, const complex *s2, const unsigned int s2_len, const unsigned int os, const unsigned int len, unsigned int *len_o);
+int correlate_bits_nodelay_window(complex *y, const complex *s1, const unsigned int s1_len, const unsigned char * const *bv, const unsigned int n, const unsigned int bv_len, const unsigned int bv_offset, const float sps, const unsigned int os, const unsigned int len);
 int delay(complex *v, const unsigned int v_len, const float toa);
 complex *modulate(const unsigned char *bv, const unsigned int bv_len, const unsigned int guard_len, float sps, unsigned int *len_o);
 complex *polyphase_resample(const complex *s, const unsigned int s_len, const unsigned int L, const unsigned int M, const complex *h, const unsigned int h_len, unsigned int *len_o);
 complex *generate_channel_response(complex *a, unsigned int a_len, unsigned int c_len, float toa, complex peak);
+void estimate_channel_fs(complex *h, const int t0, const unsigned int h_len, const complex *s, const unsigned int s_len, const int os, const unsigned int sps, const unsigned char *bv, const unsigned int bv_len, const unsigned int rot);
+complex *ls_pseudo_inverse(const unsigned char *bv, const unsigned int bv_len, const unsigned int rot, const unsigned int L, unsigned int *rows_o);
+void estimate_channel_ls(complex *h, const int t0, const unsigned int L, const complex *s, const unsigned int s_len, const int os, const unsigned int sps, const complex *P, const unsigned char *bv, const unsigned int bv_len, const unsigned int rot, float *noise_o);
+void matched_filter_decimate(complex *y, const unsigned int y_len, const complex *s, const unsigned int s_len, const int os, const unsigned int sps, const complex *h, const int t0, const unsigned int h_len);
 int design_DFE(const complex *h, const unsigned int h_len, const float SNR, const unsigned int Nf, complex **ff_o, unsigned int *ff_len, complex **fb_o, unsigned int *fb_len);
 float *equalize(complex *v, const unsigned int v_len, const complex *ff, const unsigned int ff_len, const complex *fb, const unsigned int fb_len, unsigned int *len_o);
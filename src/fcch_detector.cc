@@ -46,6 +46,7 @@
 
 #include <stdexcept>
 #include <string.h>
+#include <pthread.h>
 #include "gsm.h"
 #include "fcch_detector.h"
 #include "dsp.h"
@@ -53,6 +54,14 @@
 
 static const char * const fftw_plan_name = ".layer1_usrp_fftw_plan";
 
+/*
+ * The FFTW planner isn't thread safe and fftw_cleanup throws away every plan,
+ * so everything that uses FFTW plans, destroys and cleans up under this mutex
+ * and only the last user cleans up.
+ */
+pthread_mutex_t g_fftw_mutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned int g_fftw_users = 0;
+
 
 fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
    const float p, const float G) {
@@ -83,8 +92,11 @@ fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
 	if((!m_in) || (!m_out))
 		throw std::runtime_error("fcch_detector: fftw_malloc failed!");
 
+	low_to_high_init(0.0);
+
+	pthread_mutex_lock(&g_fftw_mutex);
 	home = getenv("HOME");
-	if(strlen(home) + strlen(fftw_plan_name) + 2 < sizeof(plan_name)) {
+	if(home && (strlen(home) + strlen(fftw_plan_name) + 2 < sizeof(plan_name))) {
 		strcpy(plan_name, home);
 		strcat(plan_name, "/");
 		strcat(plan_name, fftw_plan_name);
@@ -100,8 +112,12 @@ fcch_detector::fcch_detector(const float sample_rate, const unsigned int D,
 	} else
 		m_plan = fftw_plan_dft_1d(FFT_SIZE, m_in, m_out, FFTW_FORWARD,
 		   FFTW_ESTIMATE);
-	if(!m_plan)
+	if(!m_plan) {
+		pthread_mutex_unlock(&g_fftw_mutex);
 		throw std::runtime_error("fcch_detector: fftw plan failed!");
+	}
+	g_fftw_users += 1;
+	pthread_mutex_unlock(&g_fftw_mutex);
 }
 
 
@@ -130,9 +146,12 @@ fcch_detector::~fcch_detector() {
 	 * and then delete the first plan, fftw crashes.  At least when it is
 	 * the same plan.
 	 */
+	pthread_mutex_lock(&g_fftw_mutex);
 	if(m_plan)
 		fftw_destroy_plan(m_plan);
-	fftw_cleanup();
+	if(--g_fftw_users == 0)
+		fftw_cleanup();
+	pthread_mutex_unlock(&g_fftw_mutex);
 }
 
 
@@ -182,36 +201,34 @@ float fcch_detector::freq_detect(const complex *s, const unsigned int s_len, flo
 }
 
 
-static unsigned int g_count = 0;
-static int g_sign = 1;
-static float g_threshold = 0.0;
+void fcch_detector::low_to_high_init(const float threshold) {
 
-
-static inline void low_to_high_init(float threshold) {
-
-	g_count = 0;
-	g_sign = 1;
-	g_threshold = threshold;
+	m_lth_count = 0;
+	m_lth_sign = 1;
+	m_lth_threshold = threshold;
 }
 
 
-static inline unsigned int low_to_high(float s) {
+/*
+ * Returns the length of a run below the threshold when it ends.
+ */
+unsigned int fcch_detector::low_to_high(const float s) {
 
 	unsigned int r = 0;
 
-	if(s >= g_threshold) {
-		if(g_sign == -1) {
-			r = g_count;
-			g_sign = 1;
-			g_count = 0;
+	if(s >= m_lth_threshold) {
+		if(m_lth_sign == -1) {
+			r = m_lth_count;
+			m_lth_sign = 1;
+			m_lth_count = 0;
 		}
-		g_count += 1;
+		m_lth_count += 1;
 	} else {
-		if(g_sign == 1) {
-			g_sign = -1;
-			g_count = 0;
+		if(m_lth_sign == 1) {
+			m_lth_sign = -1;
+			m_lth_count = 0;
 		}
-		g_count += 1;
+		m_lth_count += 1;
 	}
 
 	return r;
@@ -229,10 +246,11 @@ static inline unsigned int low_to_high(float s) {
  */
 unsigned int fcch_detector::scan(const complex *s, const unsigned int s_len, float *offset, unsigned int *consumed) {
 
-	static const float sps = m_sample_rate / GSM_RATE;
-	static const unsigned int MIN_FB_LEN = 100 * sps;
 	static const unsigned int MIN_PM = 50; // XXX arbitrary, depends on decimation
 
+	const float sps = m_sample_rate / GSM_RATE;
+	const unsigned int MIN_FB_LEN = (unsigned int)(100 * sps);
+
 	unsigned int len, t, e_count, i, l_count, y_offset = 0, y_len = 0;
 	float e, *a, loff = 0, pm;
 	double sum = 0.0, avg, limit;
@@ -24,6 +24,7 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+#pragma once
 
 /*
  * This is based on the algorithm found in the paper,
@@ -42,10 +43,15 @@
  */
 
 #include <fftw3.h>
+#include <pthread.h>
 
 #include "circular_buffer.h"
 #include "usrp_complex.h"
 
+// held while planning or destroying FFTW plans, see fcch_detector.cc
+extern pthread_mutex_t	g_fftw_mutex;
+extern unsigned int	g_fftw_users;
+
 class fcch_detector {
 
 public:
@@ -59,6 +65,9 @@ public:
 	unsigned int filter_len();
 
 private:
+	void low_to_high_init(const float threshold);
+	unsigned int low_to_high(const float s);
+
 	static const unsigned int FFT_SIZE = 1024;
 
 	unsigned int	m_w_len,
@@ -72,6 +81,12 @@ private:
 			m_G,
 			m_e;
 	complex 	*m_w;
+
+	// low_to_high state
+	unsigned int	m_lth_count;
+	int		m_lth_sign;
+	float		m_lth_threshold;
+
 	circular_buffer *m_x_cb,
 			*m_e_cb;
 
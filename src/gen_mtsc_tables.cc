@@ -0,0 +1,64 @@
+/*
+ * Writes mtsc_tables.cc: the modulated reference sequences for the sample
+ * rates we expect, so they don't have to be modulated at run time.
+ */
+#include <stdio.h>
+
+#include "usrp_complex.h"
+#include "mtsc.h"
+
+static const float		sps_list[]	= {1.0, 2.0, 4.0};
+static const unsigned int	SPS_LIST_LEN	= sizeof(sps_list) / sizeof(sps_list[0]);
+static const char *		type_names[]	= {"nb", "sb", "dummy", "fb"};
+static const char *		type_enums[]	= {"MTSC_NB", "MTSC_SB", "MTSC_DUMMY", "MTSC_FB"};
+static const char *		type_bits[]	= {"n_tsc[%u]", "sb_etsc", "d_mb", "fc_fb"};
+static const int		TYPE_COUNT	= sizeof(type_names) / sizeof(type_names[0]);
+
+
+int main() {
+
+	int type;
+	unsigned int s, index, i, len, os;
+	const unsigned char *bits;
+	mtsc_s *m;
+
+	printf("/* generated by gen_mtsc_tables, do not edit */\n\n");
+	printf("#include \"gsm_bursts.h\"\n");
+	printf("#include \"mtsc_registry.h\"\n\n");
+
+	for(s = 0; s < SPS_LIST_LEN; s++) {
+		for(type = 0; type < TYPE_COUNT; type++) {
+			for(index = 0; !mtsc_sequence(type, index, &bits, &len, &os); index++) {
+				m = 0;
+				if(generate_modulated_tsc(sps_list[s], bits, len, os, &m))
+					return -1;
+				printf("static const complex %s_%u_%u[%u] = {\n", type_names[type], index, (unsigned int)sps_list[s], m->len);
+				for(i = 0; i < m->len; i++)
+					printf("\tcomplex(%.9g, %.9g)%s\n", m->tsc[i].real(), m->tsc[i].imag(), (i + 1 < m->len)? "," : "");
+				printf("};\n\n");
+				delete_mtsc(m);
+			}
+		}
+	}
+
+	printf("const mtsc_table_s mtsc_tables[] = {\n");
+	for(s = 0; s < SPS_LIST_LEN; s++) {
+		for(type = 0; type < TYPE_COUNT; type++) {
+			for(index = 0; !mtsc_sequence(type, index, &bits, &len, &os); index++) {
+				m = 0;
+				if(generate_modulated_tsc(sps_list[s], bits, len, os, &m))
+					return -1;
+				printf("\t{%s, %u, %.9g, {%s_%u_%u, %u, %.9g, complex(%.9g, %.9g), ",
+				   type_enums[type], index, sps_list[s], type_names[type], index, (unsigned int)sps_list[s],
+				   m->len, m->toa, m->gain.real(), m->gain.imag());
+				printf(type_bits[type], index);
+				printf(", %u, %u}},\n", m->bits_len, m->os);
+				delete_mtsc(m);
+			}
+		}
+	}
+	printf("};\n\n");
+	printf("const unsigned int mtsc_tables_len = sizeof(mtsc_tables) / sizeof(mtsc_tables[0]);\n");
+
+	return 0;
+}
@@ -1,131 +1,302 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "usrp_complex.h"
 #include "dsp.h"
 #include "gsm.h"
 #include "gsm_bursts.h"
 #include "gsm_demod.h"
+#include "mlse.h"
 #include "fcch_detector.h"
+#include "sch.h"
+
+
+static int g_equalizer = EQ_DFE;
 
 
 /*
- * Given a training sequence code, this function generates a modulated version
- * suitable for correlating against incoming signals.
- *
- * 	sps		samples per symbol
- * 	tsc		training sequence in bits
- *	tsc_len		number of bits in training sequence
- *	tsc_offset	offset from start of burst to tsc
- *	toa		time of arrival -- index of peak in correlation
- *	gain		value of peak in correlation -- used in channel response
- *	mtsc_len	length of modulated traning sequence
- *
- *	returns		modulated training sequence
+ * Choose the equalizer every burst is demodulated with.  Set it before any
+ * demodulation starts; it is not protected against concurrent use.
+ */
+int set_equalizer(const int eq) {
+
+	if((eq != EQ_DFE) && (eq != EQ_MLSE)) {
+		fprintf(stderr, "error: set_equalizer: unknown equalizer (%d)\n", eq);
+		return -1;
+	}
+	g_equalizer = eq;
+	return 0;
+}
+
+
+void delete_dfe_filter(dfe_filter_s *d) {
+
+	if(!d)
+		return;
+	delete[] d->ff;
+	delete[] d->fb;
+	delete d;
+}
+
+
+static const unsigned int P2M_WIDTH = 4;	// symbols of valley peak2mean looks at
+
+
+/*
+ * Samples per symbol if sps is an integer (to within what a burst can
+ * tolerate), otherwise 0.
  */
-complex *generate_modulated_tsc(const float sps, const unsigned char *tsc,
-   const unsigned int tsc_len, const unsigned int tsc_offset,
-   float *toa_o, complex *gain_o, unsigned int *mtsc_len_o) {
+static unsigned int integer_sps(const float sps) {
+
+	unsigned int n = (unsigned int)nearbyintf(sps);
+
+	return ((n >= 1) && (fabsf(sps - n) < 0.001))? n : 0;
+}
+
 
-	unsigned int mtsc_len;
+/*
+ * Peak of the correlation c between lo and hi and its SNR.  An oversampled
+ * correlation is fine enough that only the strongest sample is refined (with
+ * a parabola); at one sample per symbol peak_detect interpolates.
+ */
+static int find_peak(const float sps, complex *c, const unsigned int c_len,
+   const unsigned int lo, const unsigned int hi, float *toa_o,
+   complex *peak_o, float *SNR_o) {
+
+	unsigned int stride;
 	float toa;
-	complex *mtsc, gain;
+	complex peak;
 
-	// modulate tsc
-	if(!(mtsc = modulate(tsc, tsc_len, 0, sps, &mtsc_len)))
-		return 0;
+	if(lo >= hi)
+		return -1;
 
-	// rotate to match transmit in actual burst
-	scale(mtsc, mtsc_len, exp(complex(0, (M_PI / 2.0) * (tsc_offset % 4))));
+	if(integer_sps(sps) >= 2)
+		toa = lo + peak_detect_parabolic(c + lo, hi - lo, &peak);
+	else
+		toa = lo + peak_detect(c + lo, hi - lo, &peak, 0);
 
-	toa = ((float)tsc_len / 2.0) + tsc_offset;
-	gain = complex(tsc_len, 0);
+	stride = (sps > 1.5)? (unsigned int)nearbyintf(sps) : 1;
+	if(peak2mean(c, c_len, peak, (unsigned int)nearbyintf(toa), P2M_WIDTH, stride, SNR_o))
+		return -1;
 
 	if(toa_o)
 		*toa_o = toa;
-	if(gain_o)
-		*gain_o = gain;
-	if(mtsc_len_o)
-		*mtsc_len_o = mtsc_len;
-	return mtsc;
+	if(peak_o)
+		*peak_o = peak;
+	return 0;
 }
 
 
-int generate_modulated_tsc(const float sps, const unsigned char *tsc,
-   const unsigned int tsc_len, const unsigned int tsc_offset, mtsc_s **mtsc) {
+/*
+ * Estimate the channel of a burst from its training sequence.
+ *
+ * The channel, pulse shape included, is estimated at sample spacing.  A
+ * correlation over +/- cr_len symbols around the burst position finds the
+ * cr_len symbols with the most energy.  The taps in that window are then the
+ * least squares fit to the whole training sequence and the noise is what the
+ * fit leaves.  Without a pseudo-inverse for the sequence the correlation is
+ * kept and the noise is what lies outside the window.
+ *
+ * 	b0	start of the burst in s (samples)
+ * 	h	cr_len * sps taps, h[j] is the response t0 + j samples after
+ * 		the center of a symbol
+ * 	g	autocorrelation of h at symbol spacing, cr_len lags
+ * 	noise	noise power per sample
+ */
+static int estimate_burst_channel(const unsigned int sps,
+   const complex * const s, const unsigned int s_len, const mtsc_s *mtsc,
+   const int b0, const unsigned int cr_len, complex *h, int *t0_o,
+   complex *g, float *noise_o) {
 
-	mtsc_s *m;
+	// the normal burst sequences are a 16 bit core extended by 5 bits at each end
+	static const unsigned int CORE_GUARD = 5;
 
-	if(!mtsc) {
-		fprintf(stderr, "error: generate_modulated_tsc: no space for mtsc given\n");
-		return -1;
-	}
-	if(!*mtsc) {
-		*mtsc = new mtsc_s;
-		if(!*mtsc) {
-			fprintf(stderr, "error: generate_modulated_tsc: new failed\n");
-			return -1;
+	int t_lo, core_os;
+	unsigned int est_len, h_len, w, j, m, core_len, core_guard;
+	float e, best_e, noise;
+	complex acc;
+	const complex *P;
+
+	// training sequence core and where its first symbol is
+	core_guard = (mtsc->bits_len > 2 * CORE_GUARD + cr_len)? CORE_GUARD : 0;
+	core_len = mtsc->bits_len - 2 * core_guard;
+	core_os = b0 + (int)((mtsc->os + core_guard) * sps);
+
+	h_len = cr_len * sps;
+	est_len = 2 * h_len;
+	t_lo = -(int)h_len;
+	complex est[est_len];
+	estimate_channel_fs(est, t_lo, est_len, s, s_len, core_os, sps, mtsc->bits + core_guard, core_len, mtsc->os + core_guard);
+	for(e = 0.0, j = 0; j < h_len; j++)
+		e += norm(est[j]);
+	best_e = e;
+	w = 0;
+	for(j = h_len; j < est_len; j++) {
+		e += norm(est[j]) - norm(est[j - h_len]);
+		if(e > best_e) {
+			best_e = e;
+			w = j - h_len + 1;
 		}
 	}
-	m = *mtsc;
-	m->tsc = generate_modulated_tsc(sps, tsc, tsc_len, tsc_offset, &m->toa, &m->gain, &m->len);
-	if(!m->tsc) {
-		delete m;
-		return -1;
+
+	*t0_o = t_lo + (int)w;
+
+	if((P = get_ls_pinv(mtsc, cr_len, 0))) {
+		estimate_channel_ls(h, *t0_o, cr_len, s, s_len, b0 + (int)(mtsc->os * sps), sps, P, mtsc->bits, mtsc->bits_len, mtsc->os, &noise);
+	} else {
+		// each tap is averaged over core_len symbols
+		for(noise = 0.0, j = 0; j < est_len; j++)
+			if((j < w) || (j >= w + h_len))
+				noise += norm(est[j]);
+		noise = noise * core_len / (est_len - h_len);
+		for(j = 0; j < h_len; j++)
+			h[j] = est[w + j];
 	}
 
+	for(m = 0; m < cr_len; m++) {
+		acc = 0.0;
+		for(j = 0; j + m * sps < h_len; j++)
+			acc += conj(h[j]) * h[j + m * sps];
+		g[m] = acc;
+	}
+	if(g[0].real() <= 0.0)
+		return -1;
+	*noise_o = noise;
+
 	return 0;
 }
 
 
 /*
- * demod_burst
+ * DFE equalization for demod_burst_at, at any integer sample rate.
  *
- * Given a traning sequence for a burst, demodulate the burst into soft samples.
+ * The burst is matched filtered with its channel and decimated to one sample
+ * per symbol, which leaves the autocorrelation of the channel sampled once
+ * per symbol as the channel the DFE is designed for.  There is no fractional
+ * delay: the channel estimate takes care of the sample phase.
  *
- * If a DFE filter is given, use that.  Otherwise, create one.
+ * 	toa	start of the burst in s (samples)
  */
-float *demod_burst(const float sps, unsigned int *burst_len,
+static float *demod_burst_mf(const unsigned int sps, unsigned int *burst_len,
    const complex * const s, const unsigned int s_len,
    const mtsc_s *mtsc,
    dfe_filter_s **d,
+   const float toa,
    unsigned int cr_len, unsigned int dfe_len) {
 
-	static const float SNR_THRESHOLD = 3.0;
+	static const float MAX_SNR = 10000.0;
 
-	unsigned int c_len, v_len, b_len;
-	float toa, adjusted_toa, SNR, *b;
-	complex *c, peak, *cr, *v;
-	dfe_filter_s *dfe_new, *dfe; 
+	int b0, t0;
+	unsigned int h_len, m, nu, v_len, b_len;
+	float noise, g0, snr, *b;
+	complex *hd;
+	dfe_filter_s *dfe_new = 0, *dfe;
 
-	if(s_len < sps * DATA_LEN) {
-		fprintf(stderr, "error: demod_burst: not enough samples\n");
-		return 0;
-	}
-	if(!mtsc) {
-		fprintf(stderr, "error: demod_burst: no training sequence given\n");
+	b0 = (int)nearbyintf(toa);
+	h_len = cr_len * sps;
+	complex h[h_len], gm[cr_len];
+	if(estimate_burst_channel(sps, s, s_len, mtsc, b0, cr_len, h, &t0, gm, &noise))
 		return 0;
-	}
+	g0 = gm[0].real();
+	snr = (noise > g0 / MAX_SNR)? g0 / noise : MAX_SNR;
 
-	// correlate burst with TSC
-	c = correlate_nodelay(s, s_len, mtsc->tsc, mtsc->len, &c_len);
-	if(!c)
-		return 0;
+	// symbol spaced channel after the matched filter: g[-nu/2] .. g[nu/2]
+	nu = 2 * (cr_len - 1);
+	if((!d) || (!*d)) {
+		dfe_new = new dfe_filter_s;
+		hd = new complex[nu + 1];
+		for(m = 0; m <= nu; m++)
+			hd[m] = ((m < cr_len - 1)? conj(gm[cr_len - 1 - m]) : gm[m - cr_len + 1]) / g0;
 
-	// find point of maximum correlation
-	toa = peak_detect(c, c_len, &peak, 0);
+		// the decision delay has to reach the main tap
+		if(design_DFE(hd, nu + 1, snr, (dfe_len > nu)? dfe_len : nu + 1, &dfe_new->ff, &dfe_new->ff_len, &dfe_new->fb, &dfe_new->fb_len)) {
+			delete[] hd;
+			delete dfe_new;
+			return 0;
+		}
+		delete[] hd;
+		if(d)
+			*d = dfe_new;
+		dfe = dfe_new;
+	} else
+		dfe = *d;
 
-	// calculate approximate SNR
-	if(peak2mean(c, c_len, peak, (unsigned int)nearbyintf(toa), 4, &SNR)) {
-		delete[] c;
-		return 0;
-	}
+	// v[n] is the matched filter output for symbol n - nu / 2, scaled so the main tap is 1
+	v_len = DATA_LEN + nu;
+	complex v[v_len];
+	matched_filter_decimate(v, v_len, s, s_len, b0 - (int)((cr_len - 1) * sps), sps, h, t0, h_len);
+	scale(v, v_len, 1.0f / g0);
 
-	// does this look like a peak?
-	if(SNR < SNR_THRESHOLD) {
-		delete[] c;
+	b = equalize(v, v_len, dfe->ff, dfe->ff_len, dfe->fb, dfe->fb_len, &b_len);
+
+	if(!d)
+		delete_dfe_filter(dfe_new);
+
+	if(burst_len)
+		*burst_len = b_len;
+
+	return b;
+}
+
+
+/*
+ * MLSE equalization for demod_burst_at, at any integer sample rate.
+ *
+ * The channel is estimated and matched filtered as for demod_burst_mf.  The
+ * trellis runs over cr_len - 1 symbols either side of the burst so that the
+ * guard symbols are estimated rather than ignored.
+ *
+ * 	toa	start of the burst in s (samples)
+ */
+static float *demod_burst_mlse(const unsigned int sps, unsigned int *burst_len,
+   const complex * const s, const unsigned int s_len,
+   const mtsc_s *mtsc,
+   const float toa,
+   unsigned int cr_len) {
+
+	int b0, t0;
+	unsigned int h_len, lead, z_len;
+	float noise;
+
+	b0 = (int)nearbyintf(toa);
+	h_len = cr_len * sps;
+	complex h[h_len], gm[cr_len];
+	if(estimate_burst_channel(sps, s, s_len, mtsc, b0, cr_len, h, &t0, gm, &noise))
 		return 0;
-	}
+
+	// don't let the noise estimate claim more than 40 dB
+	if(noise < gm[0].real() / 10000.0)
+		noise = gm[0].real() / 10000.0;
+
+	lead = cr_len - 1;
+	z_len = DATA_LEN + 2 * lead;
+	complex z[z_len];
+	matched_filter_decimate(z, z_len, s, s_len, b0 - (int)(lead * sps), sps, h, t0, h_len);
+
+	return mlse_equalize(z, z_len, gm, cr_len, noise, DATA_LEN, burst_len);
+}
+
+
+/*
+ * Demodulate a burst given its correlation with the training sequence and
+ * the peak of that correlation we believe in.
+ *
+ * 	c	correlation of s with mtsc->tsc (as from correlate_nodelay)
+ * 	toa	index of the chosen peak in c
+ * 	SNR	estimated SNR at that peak
+ */
+static float *demod_burst_at(const float sps, unsigned int *burst_len,
+   const complex * const s, const unsigned int s_len,
+   const mtsc_s *mtsc,
+   dfe_filter_s **d,
+   complex *c, const unsigned int c_len, const float toa, const float SNR,
+   unsigned int cr_len, unsigned int dfe_len) {
+
+	unsigned int v_len, b_len;
+	float adjusted_toa, *b;
+	complex *cr, *v;
+	dfe_filter_s *dfe_new, *dfe; 
 
 	// adjust for offsets
 	adjusted_toa = toa - mtsc->toa;
@@ -134,19 +305,20 @@ float *demod_burst(const float sps, unsigned int *burst_len,
 	 * If toa is negative, we're missing the first part of the burst data.
 	 * The standard guard period of 3 bits should help a bit.
 	 */
-	if(adjusted_toa < -2) {
-		delete[] c;
+	if(adjusted_toa < -2 * sps)
 		return 0;
-	}
 
 	/*
 	 * Make sure there are enough samples to get all the data even when we
 	 * adjust for toa.
 	 */
-	if(s_len < DATA_LEN * sps + adjusted_toa + 2) {
-		delete[] c;
+	if(s_len < DATA_LEN * sps + adjusted_toa + 2)
 		return 0;
-	}
+
+	if((g_equalizer == EQ_MLSE) && integer_sps(sps) && mtsc->bits)
+		return demod_burst_mlse(integer_sps(sps), burst_len, s, s_len, mtsc, adjusted_toa, cr_len);
+	if(integer_sps(sps) && mtsc->bits)
+		return demod_burst_mf(integer_sps(sps), burst_len, s, s_len, mtsc, d, adjusted_toa, cr_len, dfe_len);
 
 	/*
 	 * Do we need to build the DFE?
@@ -156,7 +328,6 @@ float *demod_burst(const float sps, unsigned int *burst_len,
 		dfe_new = new dfe_filter_s;
 		if(!dfe_new) {
 			fprintf(stderr, "error: demod_burst: new failed\n");
-			delete[] c;
 			return 0;
 		}
 
@@ -164,15 +335,13 @@ float *demod_burst(const float sps, unsigned int *burst_len,
 		cr = generate_channel_response(c, c_len, cr_len, toa, mtsc->gain);
 		if(!cr) {
 			delete dfe_new;
-			delete[] c;
 			return 0;
 		}
 
 		// design DFE
 		if(design_DFE(cr, cr_len, SNR, dfe_len, &dfe_new->ff, &dfe_new->ff_len, &dfe_new->fb, &dfe_new->fb_len)) {
 			delete[] cr;
-			delete[] dfe_new;
-			delete[] c;
+			delete dfe_new;
 			return 0;
 		}
 		delete[] cr;
@@ -180,15 +349,18 @@ float *demod_burst(const float sps, unsigned int *burst_len,
 		if(d)
 			*d = dfe_new;
 		dfe = dfe_new;
-	} else
+	} else {
+		dfe_new = 0;
 		dfe = *d;
-	delete[] c;
+	}
 
 	// center burst for equalization
 	v_len = (unsigned int)(ceil(DATA_LEN * sps + adjusted_toa + 2));
 	v = new complex[v_len];
 	if(!v) {
 		fprintf(stderr, "error: demod_burst: new failed\n");
+		if(!d)
+			delete_dfe_filter(dfe_new);
 		return 0;
 	}
 	memcpy(v, s, v_len * sizeof(complex));
@@ -199,6 +371,10 @@ float *demod_burst(const float sps, unsigned int *burst_len,
 
 	delete[] v;
 
+	// the caller didn't want the DFE
+	if(!d)
+		delete_dfe_filter(dfe_new);
+
 	if(burst_len)
 		*burst_len = b_len;
 
@@ -206,6 +382,518 @@ float *demod_burst(const float sps, unsigned int *burst_len,
 }
 
 
+/*
+ * demod_burst
+ *
+ * Given a traning sequence for a burst, demodulate the burst into soft samples.
+ *
+ * If a DFE filter is given, use that.  Otherwise, create one.
+ */
+float *demod_burst(const float sps, unsigned int *burst_len,
+   const complex * const s, const unsigned int s_len,
+   const mtsc_s *mtsc,
+   dfe_filter_s **d,
+   unsigned int cr_len, unsigned int dfe_len) {
+
+	return demod_burst_tracked(sps, burst_len, s, s_len, mtsc, d, 0, 0, 0, 0, cr_len, dfe_len);
+}
+
+
+/*
+ * demod_burst_tracked
+ *
+ * Same as demod_burst, but when we already know about where the burst is
+ * (e.g., from the TDMA clock and the last burst in this time slot) only
+ * correlate within window samples of that.  If nothing that looks like a
+ * peak is there, fall back to searching all of s.
+ *
+ * 	toa	in: predicted offset from s to the start of the burst, negative
+ * 		if unknown; out: the offset found
+ * 	SNR	if given, the peak to mean ratio of the training sequence
+ * 		correlation
+ * 	scratch	if given and long enough, holds the correlation
+ */
+float *demod_burst_tracked(const float sps, unsigned int *burst_len,
+   const complex * const s, const unsigned int s_len,
+   const mtsc_s *mtsc,
+   dfe_filter_s **d,
+   float *toa_io, const float window, float *SNR_o,
+   demod_scratch_s *scratch,
+   unsigned int cr_len, unsigned int dfe_len) {
+
+	static const float SNR_THRESHOLD = 3.0;
+
+	int lo, hi, margin, start, found = 0;
+	float pred, toa, SNR, *b;
+	complex *c, *c_new = 0, peak;
+
+	if(s_len < sps * DATA_LEN) {
+		fprintf(stderr, "error: demod_burst: not enough samples\n");
+		return 0;
+	}
+	if(!mtsc) {
+		fprintf(stderr, "error: demod_burst: no training sequence given\n");
+		return 0;
+	}
+
+	if(scratch && (scratch->c_len >= s_len))
+		c = scratch->c;
+	else
+		c = c_new = new complex[s_len];
+
+	if(toa_io && (*toa_io >= 0)) {
+		pred = *toa_io + mtsc->toa;
+		lo = (int)floor(pred - window);
+		hi = (int)ceil(pred + window) + 1;
+		if(lo < 0)
+			lo = 0;
+		if(hi > (int)s_len)
+			hi = s_len;
+
+		/*
+		 * peak2mean and the channel response look at the correlation
+		 * on either side of the peak.
+		 */
+		margin = (int)ceil(((cr_len > P2M_WIDTH + 2)? cr_len : P2M_WIDTH + 2) * sps);
+
+		if(lo < hi) {
+			start = (lo > margin)? lo - margin : 0;
+			correlate_nodelay_window(c, s, s_len, mtsc->tsc, mtsc->len, start, hi + margin - start);
+			found = !find_peak(sps, c, s_len, lo, hi, &toa, &peak, &SNR) && (SNR >= SNR_THRESHOLD);
+		}
+	}
+
+	if(!found) {
+		// correlate burst with TSC
+		correlate_nodelay(c, s, s_len, mtsc->tsc, mtsc->len);
+
+		// find point of maximum correlation and calculate approximate SNR,
+		// does this look like a peak?
+		if(find_peak(sps, c, s_len, 0, s_len, &toa, &peak, &SNR) || (SNR < SNR_THRESHOLD)) {
+			delete[] c_new;
+			return 0;
+		}
+	}
+
+	b = demod_burst_at(sps, burst_len, s, s_len, mtsc, d, c, s_len, toa, SNR, cr_len, dfe_len);
+	delete[] c_new;
+
+	if(b && toa_io)
+		*toa_io = toa - mtsc->toa;
+	if(b && SNR_o)
+		*SNR_o = SNR;
+
+	return b;
+}
+
+
+/*
+ * Strongest peak of any row of c (N_TSC_NUM rows of c_len) between lo and hi.
+ */
+static int best_tsc_peak(const float sps, complex *c, const unsigned int c_len,
+   const unsigned int lo, const unsigned int hi, int *tsc_o, float *toa_o,
+   float *SNR_o) {
+
+	int i, tsc = 0;
+	unsigned int n;
+	float p, best = -1.0, toa;
+	complex *r;
+
+	if(lo >= hi)
+		return -1;
+	for(i = 0; i < N_TSC_NUM; i++) {
+		r = c + i * c_len;
+		for(n = lo; n < hi; n++) {
+			if((p = norm(r[n])) > best) {
+				best = p;
+				tsc = i;
+			}
+		}
+	}
+
+	if(find_peak(sps, c + tsc * c_len, c_len, lo, hi, &toa, 0, SNR_o))
+		return -1;
+
+	*tsc_o = tsc;
+	*toa_o = toa;
+	return 0;
+}
+
+
+/*
+ * detect_tsc
+ *
+ * Find which normal burst training sequence is in s when we don't know it
+ * (e.g., on a dedicated channel).  Rather than correlating with each of
+ * n_tsc in turn, all of them are correlated in one pass with
+ * correlate_bits_nodelay_window.  The sequence with the strongest peak wins.
+ *
+ * 	toa	in: predicted offset from s to the start of the burst, negative
+ * 		if unknown; out: the offset found
+ * 	tsc	index into n_tsc of the training sequence found
+ * 	SNR	estimated SNR at its peak
+ *
+ * 	returns	0 if a training sequence was found
+ */
+int detect_tsc(const float sps, const complex * const s,
+   const unsigned int s_len, float *toa_io, const float window, int *tsc_o,
+   float *SNR_o) {
+
+	static const float SNR_THRESHOLD = 3.0;
+
+	int i, lo, hi, start, end, tsc, margin;
+	float toa, SNR = 0, tsc_toa;
+	const unsigned char *bv[N_TSC_NUM];
+	complex *c;
+
+	if(s_len < sps * DATA_LEN) {
+		fprintf(stderr, "error: detect_tsc: not enough samples\n");
+		return -1;
+	}
+
+	for(i = 0; i < N_TSC_NUM; i++)
+		bv[i] = n_tsc[i];
+
+	// peak2mean looks this far from the peak
+	margin = (int)ceil((P2M_WIDTH + 2) * sps);
+	tsc_toa = ((float)N_TSC_CODE_LEN / 2.0 + N_TSC_OS) * sps;
+
+	lo = 0;
+	hi = s_len;
+	if(toa_io && (*toa_io >= 0)) {
+		lo = (int)floor(*toa_io + tsc_toa - window);
+		hi = (int)ceil(*toa_io + tsc_toa + window) + 1;
+		if(lo < 0)
+			lo = 0;
+		if(hi > (int)s_len)
+			hi = s_len;
+	}
+	start = (lo > margin)? lo - margin : 0;
+	end = (hi + margin < (int)s_len)? hi + margin : s_len;
+
+	c = new complex[N_TSC_NUM * s_len];
+	if(!c) {
+		fprintf(stderr, "error: detect_tsc: new failed\n");
+		return -1;
+	}
+	if(correlate_bits_nodelay_window(c, s, s_len, bv, N_TSC_NUM, N_TSC_CODE_LEN, N_TSC_OS, sps, start, end - start)) {
+		delete[] c;
+		return -1;
+	}
+
+	if(best_tsc_peak(sps, c, s_len, lo, hi, &tsc, &toa, &SNR) || (SNR < SNR_THRESHOLD)) {
+
+		// nothing near the prediction, search everything
+		if((lo == 0) && (hi == (int)s_len)) {
+			delete[] c;
+			return -1;
+		}
+		if(correlate_bits_nodelay_window(c, s, s_len, bv, N_TSC_NUM, N_TSC_CODE_LEN, N_TSC_OS, sps, 0, s_len) ||
+		   best_tsc_peak(sps, c, s_len, 0, s_len, &tsc, &toa, &SNR) || (SNR < SNR_THRESHOLD)) {
+			delete[] c;
+			return -1;
+		}
+	}
+	delete[] c;
+
+	if(toa_io)
+		*toa_io = toa - tsc_toa;
+	if(tsc_o)
+		*tsc_o = tsc;
+	if(SNR_o)
+		*SNR_o = SNR;
+
+	return 0;
+}
+
+
+/*
+ * sch_acquire
+ *
+ * Given a buffer that should contain a synchronization burst (e.g., from
+ * get_burst_sch), decode the burst without trusting the strongest
+ * correlation peak.
+ *
+ * Every local maximum of the correlation with the SCH training sequence that
+ * looks like a peak is a hypothesis for the burst position.  All hypotheses
+ * share the one correlation.  Each is equalized and decoded and the one that
+ * passes parity with the smallest Viterbi metric is returned.
+ *
+ * 	toa	offset from s to the start of the burst (in samples)
+ *
+ * 	returns	0 if the synchronization burst was decoded
+ */
+int sch_acquire(const float sps, const complex * const s,
+   const unsigned int s_len, const mtsc_s *mtsc, int *fn_o, int *bsic_o,
+   float *toa_o, unsigned int cr_len, unsigned int dfe_len) {
+
+	static const unsigned int MAX_HYPOTHESES = 8;
+	static const unsigned int PEAK_WIDTH = 10;	// symbols
+	static const float SNR_THRESHOLD = 3.0;
+
+	unsigned int c_len, h_count = 0, h_i[MAX_HYPOTHESES], i, j, lo, hi, b_len, peak_width;
+	int fn, bsic, metric, best_metric = -1, best_fn = 0, best_bsic = 0;
+	float toa, best_toa = 0, SNR, p, h_p[MAX_HYPOTHESES], *b;
+	complex *c, peak;
+	llr_t l[DATA_LEN];
+
+	if(s_len < sps * DATA_LEN) {
+		fprintf(stderr, "error: sch_acquire: not enough samples\n");
+		return -1;
+	}
+	if(!mtsc) {
+		fprintf(stderr, "error: sch_acquire: no training sequence given\n");
+		return -1;
+	}
+
+	c = correlate_nodelay(s, s_len, mtsc->tsc, mtsc->len, &c_len);
+	if(!c)
+		return -1;
+	peak_width = (unsigned int)ceil(PEAK_WIDTH * sps);
+
+	// keep the strongest local maxima, strongest first
+	for(i = 1; i + 1 < c_len; i++) {
+		p = norm(c[i]);
+		if((p < norm(c[i - 1])) || (p <= norm(c[i + 1])))
+			continue;
+		if((h_count == MAX_HYPOTHESES) && (p <= h_p[h_count - 1]))
+			continue;
+		if(h_count < MAX_HYPOTHESES)
+			h_count += 1;
+		for(j = h_count - 1; (j > 0) && (h_p[j - 1] < p); j--) {
+			h_p[j] = h_p[j - 1];
+			h_i[j] = h_i[j - 1];
+		}
+		h_p[j] = p;
+		h_i[j] = i;
+	}
+
+	for(i = 0; i < h_count; i++) {
+
+		// refine the peak using only its own neighborhood
+		lo = (h_i[i] > peak_width)? h_i[i] - peak_width : 0;
+		hi = (h_i[i] + peak_width + 1 < c_len)? h_i[i] + peak_width + 1 : c_len;
+		if(find_peak(sps, c, c_len, lo, hi, &toa, &peak, &SNR))
+			continue;
+		if(SNR < SNR_THRESHOLD)
+			continue;
+
+		b = demod_burst_at(sps, &b_len, s, s_len, mtsc, 0, c, c_len, toa, SNR, cr_len, dfe_len);
+		if(!b)
+			continue;
+		llr_from_soft(l, b, (b_len < DATA_LEN)? b_len : DATA_LEN);
+		delete[] b;
+		if(b_len < DATA_LEN)
+			continue;
+
+		if(decode_sch_llr(l, &fn, &bsic, &metric))
+			continue;
+		if((best_metric < 0) || (metric < best_metric)) {
+			best_metric = metric;
+			best_fn = fn;
+			best_bsic = bsic;
+			best_toa = toa - mtsc->toa;
+		}
+	}
+	delete[] c;
+
+	if(best_metric < 0)
+		return -1;
+
+	if(fn_o)
+		*fn_o = best_fn;
+	if(bsic_o)
+		*bsic_o = best_bsic;
+	if(toa_o)
+		*toa_o = best_toa;
+
+	return 0;
+}
+
+
+/*
+ * Find the strongest training sequence peak in s.
+ *
+ * 	toa	offset from s to the start of the burst (in samples)
+ */
+static int find_tsc_peak(const float sps, const complex * const s,
+   const unsigned int s_len, const mtsc_s *mtsc, float *toa_o, float *SNR_o) {
+
+	unsigned int c_len;
+	float toa;
+	complex *c;
+
+	c = correlate_nodelay(s, s_len, mtsc->tsc, mtsc->len, &c_len);
+	if(!c)
+		return -1;
+	if(find_peak(sps, c, c_len, 0, c_len, &toa, 0, SNR_o)) {
+		delete[] c;
+		return -1;
+	}
+	delete[] c;
+
+	if(toa_o)
+		*toa_o = toa - mtsc->toa;
+	return 0;
+}
+
+
+/*
+ * sch_acquire_combined
+ *
+ * Follow the synchronization bursts in the stream and decode them together.
+ *
+ * This expects the buffer returned by get_burst_sch to be at the head of the
+ * sample_source buffer.  The strongest SCH peak in that buffer is taken as the
+ * first burst.  Each later burst is 10 frames after the previous one, or 11
+ * at the end of a 51-multiframe (where the 10 frame position holds a
+ * frequency burst) and we take whichever of those two positions has the
+ * stronger peak.  After each burst the soft bits of all bursts so far are
+ * decoded together with decode_sch_combined.
+ *
+ * 	fn	frame number of the last burst used
+ * 	toa	offset from peek() to the start of the last burst used
+ *
+ * 	returns	0 on success
+ */
+int sch_acquire_combined(sample_source *u, const mtsc_s *mtsc,
+   const unsigned int max_bursts, int *fn_o, int *bsic_o, float *toa_o) {
+
+	static const unsigned int MAX_BURSTS = 8;
+	static const float MARGIN = 8;		// symbols either side of a burst
+	static const float SNR_THRESHOLD = 3.0;
+
+	unsigned int i, n, s_len, win_len, start, overruns, b_len, best_delta, next_delta[2] = {10, 11};
+	int fn, bsic, delta = 0, fn_delta[MAX_BURSTS];
+	float sps, frame_len, margin, toa, SNR, best_toa, best_SNR, *b;
+	double pos;
+	complex *s;
+	circular_buffer *cb;
+	llr_t l[MAX_BURSTS][DATA_LEN];
+	const llr_t *lp[MAX_BURSTS];
+
+	if(!mtsc) {
+		fprintf(stderr, "error: sch_acquire_combined: no training sequence given\n");
+		return -1;
+	}
+
+	sps = u->sample_rate() / GSM_RATE;
+	frame_len = FRAME_LEN * sps;
+	margin = MARGIN * sps;
+	win_len = (unsigned int)ceil(BURST_LEN * sps + 2 * margin);
+	cb = u->get_buffer();
+
+	// the first burst is the strongest peak in the current buffer
+	s = (complex *)cb->peek(&s_len);
+	if(find_tsc_peak(sps, s, s_len, mtsc, &toa, &SNR) || (SNR < SNR_THRESHOLD))
+		return -1;
+	pos = toa;
+
+	for(n = 0; (n < max_bursts) && (n < MAX_BURSTS); ) {
+
+		// demodulate the burst at pos
+		start = (pos > margin)? (unsigned int)floor(pos - margin) : 0;
+		if(u->fill(start + win_len, &overruns) || overruns)
+			return -1;
+		s = (complex *)cb->peek(&s_len);
+		if((b = demod_burst(sps, &b_len, s + start, win_len, mtsc, 0))) {
+			if(b_len >= DATA_LEN) {
+				llr_from_soft(l[n], b, DATA_LEN);
+				lp[n] = l[n];
+				fn_delta[n] = delta;
+				n += 1;
+			}
+			delete[] b;
+		}
+
+		if(n && !decode_sch_combined(lp, fn_delta, n, &fn, &bsic)) {
+			if(fn_o)
+				*fn_o = (fn + delta) % MAX_FN;
+			if(bsic_o)
+				*bsic_o = bsic;
+			if(toa_o)
+				*toa_o = pos;
+			return 0;
+		}
+
+		// we are done with everything before this burst
+		cb->purge(start);
+		pos -= start;
+
+		// find the next burst
+		if(u->fill((unsigned int)ceil(pos + 11 * frame_len + win_len), &overruns) || overruns)
+			return -1;
+		s = (complex *)cb->peek(&s_len);
+		best_SNR = 0;
+		best_toa = 0;
+		best_delta = 0;
+		for(i = 0; i < 2; i++) {
+			start = (unsigned int)floor(pos + next_delta[i] * frame_len - margin);
+			if(find_tsc_peak(sps, s + start, win_len, mtsc, &toa, &SNR))
+				continue;
+			if(SNR > best_SNR) {
+				best_SNR = SNR;
+				best_toa = start + toa;
+				best_delta = next_delta[i];
+			}
+		}
+		if(best_SNR < SNR_THRESHOLD)
+			return -1;
+		delta += best_delta;
+		pos = best_toa;
+	}
+
+	return -1;
+}
+
+
+/*
+ * tsc_freq_offset
+ *
+ * Estimate the carrier offset left on a burst from the phase slope of its
+ * training sequence.  Taking the known training sequence out of the received
+ * samples leaves the channel gain times the residual carrier; the phase it
+ * advances over half the training sequence gives the frequency.
+ *
+ * 	toa	offset from s to the start of the burst (as from sch_acquire)
+ *
+ * 	returns	the offset in Hz, 0 if the training sequence isn't in s
+ */
+float tsc_freq_offset(const float sps, const complex * const s,
+   const unsigned int s_len, const mtsc_s *mtsc, const float toa) {
+
+	static const unsigned int MARGIN = 8;	// samples kept past the tsc for the delay filter
+
+	int start;
+	unsigned int i, os, lag, v_len;
+	complex *v, z0, z1, acc = 0.0;
+
+	/*
+	 * The estimate is only as good as the alignment with the training
+	 * sequence (a sample off rotates every product by about pi / 2) so
+	 * shift the burst by the fractional part of toa first.
+	 */
+	start = (int)floor(toa);
+	os = (unsigned int)nearbyintf(mtsc->toa - mtsc->len / 2.0);
+	v_len = os + mtsc->len + MARGIN;
+	if((start < 0) || (start + v_len > s_len))
+		return 0.0;
+	v = new complex[v_len];
+	memcpy(v, s + start, v_len * sizeof(complex));
+	delay(v, v_len, -(toa - start));
+
+	lag = mtsc->len / 2;
+	for(i = 0; i + lag < mtsc->len; i++) {
+		z0 = v[os + i] * conj(mtsc->tsc[i]);
+		z1 = v[os + i + lag] * conj(mtsc->tsc[i + lag]);
+		acc += z1 * conj(z0);
+	}
+	delete[] v;
+
+	return arg(acc) / lag * sps * GSM_RATE / (2.0 * M_PI);
+}
+
+
 /*
  * get_burst_sch
  *
@@ -215,9 +903,10 @@ float *demod_burst(const float sps, unsigned int *burst_len,
  * time slot.  Moreover, the returned buffer may be larger (or smaller) than a
  * burst and may not actually contain the synchronization burst.
  */
-complex *get_burst_sch(usrp_source *u, unsigned int *buf_len) {
+complex *get_burst_sch(sample_source *u, unsigned int *buf_len) {
 
 	static const unsigned int MAX_SEARCH = 20;
+	static const float MAX_OFFSET = 40e3;
 
 	unsigned int fb_mframe_len, frame_len, burst_len, c_len, consumed, overruns = 0, offset_found = 0, offset_search_count = 0;
 	float offset, sps;
@@ -272,8 +961,13 @@ complex *get_burst_sch(usrp_source *u, unsigned int *buf_len) {
 	}
 
 	/*
-	 * should we actually do something with the offset?
+	 * The FCCH is a tone at FCCH_FREQ so anything else is carrier offset.
+	 * Take it out of the stream, including the samples we have buffered,
+	 * so the sync burst is demodulated without it.
 	 */
+	offset -= FCCH_FREQ;
+	if(fabs(offset) < MAX_OFFSET)
+		u->correct(offset);
 
 	/*
 	 * The sync burst should be one frame after the frequency burst in TN =
@@ -309,8 +1003,64 @@ complex *get_burst_sch(usrp_source *u, unsigned int *buf_len) {
 
 
 /*
-complex *get_burst(usrp_source *u, unsigned int *burst_len, const unsigned int fn, const unsigned int ts) {
+ * get_burst
+ *
+ * Return the samples of burst (fn, ts) straight out of the circular buffer.
+ * The clock must have been synchronized (e.g., from sch_acquire) and bursts
+ * must be requested in order: everything before the returned window is
+ * purged so that the window starts at peek().  The window is valid until the
+ * next call.
+ *
+ * 	margin	extra samples on either side of the burst
+ * 	toa	offset from the returned pointer to the start of the burst
+ */
+complex *get_burst(sample_source *u, unsigned int *burst_len, const unsigned int fn, const unsigned int ts, const unsigned int margin, float *toa_o) {
 
-	return 0;
+	unsigned int len, step, overruns = 0;
+	unsigned long long start;
+	double pos, consumed;
+	complex *c;
+	tdma_clock *clock;
+	circular_buffer *cb;
+
+	clock = u->get_clock();
+	if(!clock->synced()) {
+		fprintf(stderr, "error: get_burst: clock not synchronized\n");
+		return 0;
+	}
+	cb = u->get_buffer();
+
+	pos = clock->burst_pos(fn, ts) - margin;
+	consumed = (double)cb->consumed();
+	if(pos < consumed) {
+		fprintf(stderr, "error: get_burst: burst already consumed\n");
+		return 0;
+	}
+	start = (unsigned long long)floor(pos - consumed);
+	len = (unsigned int)ceil(BURST_LEN * clock->sps()) + 2 * margin + 1;
+
+	// skip ahead to the window without filling more than half the buffer
+	step = cb->buf_len() / 2;
+	while(start) {
+		if(u->fill((start < step)? (unsigned int)start : step, &overruns) || overruns)
+			break;
+		start -= cb->purge((start < step)? (unsigned int)start : step);
+	}
+	if(!overruns && (u->fill(len, &overruns) || overruns)) {
+		fprintf(stderr, "error: get_burst: fill failed\n");
+		return 0;
+	}
+	if(overruns) {
+		// samples were dropped so the clock can no longer be trusted
+		fprintf(stderr, "error: get_burst: overrun\n");
+		clock->reset();
+		return 0;
+	}
+
+	c = (complex *)cb->peek(0);
+	if(burst_len)
+		*burst_len = len;
+	if(toa_o)
+		*toa_o = (float)(pos + margin - (double)cb->consumed());
+	return c;
 }
- */
@@ -1,14 +1,12 @@
 #pragma once
 #include "usrp_complex.h"
-#include "usrp_source.h"
-
-typedef struct {
-	complex *	tsc;		// modulated training sequence code
-	unsigned int	len;		// length of modulated tsc
-	float		toa;		// time of arrival for midamble into tsc
-	complex		gain;		// peak of correlation between midamble and tsc
-} mtsc_s;
+#include "sample_source.h"
+#include "mtsc.h"
 
+enum {
+	EQ_DFE,		// decision feedback equalizer
+	EQ_MLSE		// maximum likelihood sequence estimation
+};
 
 typedef struct {
 	complex *	ff;		// feedforward filter
@@ -17,21 +15,49 @@ typedef struct {
 	unsigned int	fb_len;		// feedback filter len
 } dfe_filter_s;
 
+/*
+ * Room demod_burst_tracked can use for the training sequence correlation
+ * instead of allocating it for every burst, e.g., one per worker thread.
+ */
+typedef struct {
+	complex *	c;
+	unsigned int	c_len;
+} demod_scratch_s;
+
+
+int set_equalizer(const int eq);
+void delete_dfe_filter(dfe_filter_s *d);
+
+complex *get_burst_sch(sample_source *u, unsigned int *buf_len);
 
-complex *generate_modulated_tsc(const float sps, const unsigned char *tsc,
-   const unsigned int tsc_len, const unsigned int tsc_offset,
-   float *toa_o, complex *gain_o, unsigned int *mtsc_len_o);
+int sch_acquire(const float sps, const complex * const s,
+   const unsigned int s_len, const mtsc_s *mtsc, int *fn_o, int *bsic_o,
+   float *toa_o = 0, unsigned int cr_len = 6, unsigned int dfe_len = 5);
 
-int generate_modulated_tsc(const float sps, const unsigned char *tsc,
-   const unsigned int tsc_len, const unsigned int tsc_offset, mtsc_s **mtsc);
+int sch_acquire_combined(sample_source *u, const mtsc_s *mtsc,
+   const unsigned int max_bursts, int *fn_o, int *bsic_o, float *toa_o = 0);
 
-complex *get_burst_sch(usrp_source *u, unsigned int *buf_len);
+float tsc_freq_offset(const float sps, const complex * const s,
+   const unsigned int s_len, const mtsc_s *mtsc, const float toa);
 
-complex *get_burst(usrp_source *u, unsigned int *burst_len,
-   const unsigned int fn, const unsigned int ts);
+complex *get_burst(sample_source *u, unsigned int *burst_len,
+   const unsigned int fn, const unsigned int ts,
+   const unsigned int margin = 0, float *toa_o = 0);
 
 float *demod_burst(const float sps, unsigned int *burst_len,
    const complex * const s, const unsigned int s_len,
    const mtsc_s *mtsc,
    dfe_filter_s **d,
    unsigned int cr_len = 6, unsigned int dfe_len = 5);
+
+float *demod_burst_tracked(const float sps, unsigned int *burst_len,
+   const complex * const s, const unsigned int s_len,
+   const mtsc_s *mtsc,
+   dfe_filter_s **d,
+   float *toa_io, const float window, float *SNR_o,
+   demod_scratch_s *scratch = 0,
+   unsigned int cr_len = 6, unsigned int dfe_len = 5);
+
+int detect_tsc(const float sps, const complex * const s,
+   const unsigned int s_len, float *toa_io, const float window, int *tsc_o,
+   float *SNR_o = 0);
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * The subset of the OsmocomBB layer 1 control protocol (L1CTL) that a receive
+ * only layer 1 can serve.
+ *
+ * Every message starts with an l1ctl_hdr_s and is sent on the socket behind a
+ * 2 octet length in network byte order.  Multi-octet fields are in network
+ * byte order too.
+ */
+enum {
+	L1CTL_FBSB_REQ		= 1,
+	L1CTL_FBSB_CONF		= 2,
+	L1CTL_DATA_IND		= 3,
+	L1CTL_RACH_REQ		= 4,
+	L1CTL_DM_EST_REQ	= 5,
+	L1CTL_DATA_REQ		= 6,
+	L1CTL_RESET_IND		= 7,
+	L1CTL_PM_REQ		= 8,
+	L1CTL_PM_CONF		= 9,
+	L1CTL_ECHO_REQ		= 10,
+	L1CTL_ECHO_CONF		= 11,
+	L1CTL_RACH_CONF		= 12,
+	L1CTL_RESET_REQ		= 13,
+	L1CTL_RESET_CONF	= 14,
+	L1CTL_DATA_CONF		= 15,
+	L1CTL_CCCH_MODE_REQ	= 16,
+	L1CTL_CCCH_MODE_CONF	= 17
+};
+
+// l1ctl_hdr_s flags
+static const uint8_t L1CTL_F_DONE		= 0x01;
+
+// band_arfcn flags
+static const uint16_t ARFCN_PCS			= 0x8000;
+static const uint16_t ARFCN_UPLINK		= 0x4000;
+static const uint16_t ARFCN_MASK		= 0x03ff;
+
+// l1ctl_reset_s types
+enum {
+	L1CTL_RES_T_BOOT	= 0,
+	L1CTL_RES_T_FULL	= 1,
+	L1CTL_RES_T_SCHED	= 2
+};
+
+// l1ctl_ccch_mode_s modes
+enum {
+	CCCH_MODE_NONE		= 0,
+	CCCH_MODE_NON_COMBINED	= 1,
+	CCCH_MODE_COMBINED	= 2
+};
+
+// l1ctl_pm_req_s types
+static const uint8_t L1CTL_PM_T_RANGE		= 1;
+
+// channel numbers (44.018 10.5.2.5) and link identifiers
+static const uint8_t CHAN_NR_BCCH		= 0x80;
+static const uint8_t CHAN_NR_CCCH		= 0x90;
+static const uint8_t CHAN_NR_SDCCH4		= 0x20;
+static const uint8_t LINK_ID_SACCH		= 0x40;
+
+static const unsigned int L1CTL_LEN_LEN		= 2;	// length prefix on the socket
+
+typedef struct {
+	uint8_t		type;
+	uint8_t		flags;
+	uint8_t		padding[2];
+} __attribute__((packed)) l1ctl_hdr_s;
+
+typedef struct {
+	uint8_t		chan_nr;
+	uint8_t		link_id;
+	uint16_t	band_arfcn;
+	uint32_t	frame_nr;
+	uint8_t		rx_level;	// 0 .. 63
+	uint8_t		snr;
+	uint8_t		num_biterr;
+	uint8_t		fire_crc;	// 0 if the block checks
+} __attribute__((packed)) l1ctl_info_dl_s;
+
+typedef struct {
+	uint16_t	band_arfcn;
+	uint16_t	timeout;	// frames
+	uint16_t	freq_err_thresh1;
+	uint16_t	freq_err_thresh2;
+	uint8_t		num_freqerr_avg;
+	uint8_t		flags;
+	uint8_t		sync_info_idx;
+	uint8_t		ccch_mode;
+	uint8_t		rxlev_exp;
+} __attribute__((packed)) l1ctl_fbsb_req_s;
+
+typedef struct {
+	int16_t		initial_freq_err;
+	uint8_t		result;		// 0 on success
+	uint8_t		bsic;
+} __attribute__((packed)) l1ctl_fbsb_conf_s;
+
+typedef struct {
+	uint8_t		data[23];
+} __attribute__((packed)) l1ctl_data_ind_s;
+
+typedef struct {
+	uint8_t		ra;
+	uint8_t		combined;
+	uint16_t	offset;
+} __attribute__((packed)) l1ctl_rach_req_s;
+
+typedef struct {
+	uint8_t		type;
+	uint8_t		padding[3];
+	uint16_t	band_arfcn_from;
+	uint16_t	band_arfcn_to;
+} __attribute__((packed)) l1ctl_pm_req_s;
+
+typedef struct {
+	uint16_t	band_arfcn;
+	uint8_t		pm[2];
+} __attribute__((packed)) l1ctl_pm_conf_s;
+
+typedef struct {
+	uint8_t		type;
+	uint8_t		padding[3];
+} __attribute__((packed)) l1ctl_reset_s;
+
+typedef struct {
+	uint8_t		ccch_mode;
+	uint8_t		padding[3];
+} __attribute__((packed)) l1ctl_ccch_mode_s;
@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <stdexcept>
+
+#include "usrp_source.h"
+#include "arfcn_freq.h"
+#include "gsm.h"
+#include "gsm_demod.h"
+#include "dsp.h"
+#include "camp.h"
+#include "xcch.h"
+#include "l1ctl.h"
+#include "l1ctl_server.h"
+#include "l1ctl_phy.h"
+
+
+/*
+ * Layer 1 for OsmocomBB.
+ *
+ * The server thread parses requests and queues them for the radio thread,
+ * which owns the USRP.  While camped the radio thread runs camp and comes out
+ * of it as soon as a request is queued.  Bursts of the control channels on
+ * time slot 0 are collected into blocks as they are demodulated and each
+ * complete block is decoded and sent to layer 2 from the burst callback, so a
+ * block is on the socket a few bursts after its last burst was received.
+ *
+ * This is a receiver only: random access and uplink data are refused.
+ */
+static const unsigned int REQ_SLOTS	= 16;
+static const unsigned int MAX_REQ_LEN	= 64;
+static const unsigned int PM_BATCH	= 64;		// measurements per PM_CONF
+static const unsigned int PM_FRAMES	= 2;		// frames of samples per measurement
+static const int RXLEV_FULL_SCALE	= 63;		// level of a full scale signal
+static const double SAMPLE_FULL_SCALE	= 32767.0;
+
+// queued by the server thread when the client goes away
+static const uint8_t REQ_CLIENT_GONE	= 0;
+
+
+typedef struct {
+	uint8_t		type;
+	unsigned int	len;
+	uint8_t		data[MAX_REQ_LEN];
+} phy_req_s;
+
+
+typedef struct {
+	usrp_source *	u;
+	l1ctl_server *	server;
+	burst_ring *	ring;		// if given, every burst is published here
+
+	// requests for the radio thread
+	phy_req_s	req[REQ_SLOTS];
+	unsigned int	req_head;
+	unsigned int	req_tail;
+	volatile int	req_pending;	// stops camp
+	pthread_mutex_t	req_mutex;
+	pthread_cond_t	req_cond;
+
+	// the carrier we are camped on
+	int		synced;
+	int		bsic;
+	uint16_t	band_arfcn;
+	uint8_t		ccch_mode;
+	uint8_t		rx_level;
+
+	// the block being collected
+	int		blk_fn;		// frame of its first burst, -1 if none
+	unsigned int	blk_have;	// bit i set once burst i is in
+	llr_t		blk[XCCH_BURSTS][DATA_LEN];
+} phy_s;
+
+
+/*
+ * Received level in the units of 45.008 (0 .. 63) but against the full scale
+ * of the ADC rather than a calibrated power.
+ */
+static uint8_t measure_rxlev(usrp_source *u, const unsigned int len) {
+
+	unsigned int buf_len, overruns;
+	int lev;
+	float p;
+	complex *buf;
+
+	do {
+		u->flush();
+		if(u->fill(len, &overruns)) {
+			fprintf(stderr, "error: usrp_source::fill\n");
+			return 0;
+		}
+	} while(overruns);
+
+	buf = (complex *)u->get_buffer()->peek(&buf_len);
+	p = vectornorm2(buf, len) / len / (SAMPLE_FULL_SCALE * SAMPLE_FULL_SCALE);
+	u->get_buffer()->purge(len);
+	if(p <= 0.0)
+		return 0;
+	lev = RXLEV_FULL_SCALE + (int)floor(10.0 * log10(p) + 0.5);
+	if(lev < 0)
+		lev = 0;
+	if(lev > RXLEV_FULL_SCALE)
+		lev = RXLEV_FULL_SCALE;
+	return lev;
+}
+
+
+static int tune_arfcn(usrp_source *u, const uint16_t band_arfcn) {
+
+	int bi;
+	double freq;
+
+	if(band_arfcn & ARFCN_UPLINK)
+		return -1;
+	bi = (band_arfcn & ARFCN_PCS)? PCS_1900 : DCS_1800;
+	if((freq = arfcn_to_freq(band_arfcn & ARFCN_MASK, &bi)) < 0.0)
+		return -1;
+	if(u->tune(freq)) {
+		fprintf(stderr, "error: usrp_source::tune\n");
+		return -1;
+	}
+	u->flush();
+	return 0;
+}
+
+
+/*
+ * Channel of the block starting at t3 (mod 51) on time slot 0.
+ */
+static int block_chan(const phy_s *phy, const int fn, const int t3,
+   uint8_t *chan_nr, uint8_t *link_id) {
+
+	int sub;
+
+	*link_id = 0;
+	if(t3 == 2) {
+		*chan_nr = CHAN_NR_BCCH;
+		return 0;
+	}
+	if(phy->ccch_mode == CCCH_MODE_NONE)
+		return -1;
+	if((phy->ccch_mode != CCCH_MODE_COMBINED) || (t3 < 22)) {
+		*chan_nr = CHAN_NR_CCCH;
+		return 0;
+	}
+
+	// combined: SDCCH/4 in blocks 22 .. 36, their SACCH in 42 and 46
+	if(t3 < 42) {
+		sub = (t3 - 22) / 10 * 2 + ((t3 % 10 == 6)? 1 : 0);
+		*chan_nr = CHAN_NR_SDCCH4 | (sub << 3);
+	} else {
+		sub = ((fn / 51) % 2) * 2 + ((t3 == 46)? 1 : 0);
+		*chan_nr = CHAN_NR_SDCCH4 | (sub << 3);
+		*link_id = LINK_ID_SACCH;
+	}
+	return 0;
+}
+
+
+/*
+ * The blocks on time slot 0 start in frames 2, 6, 12, 16, ..., 42 and 46 of
+ * the 51-multiframe; frames 0, 1, 10, 11, ... carry the FCCH and SCH.
+ */
+static void burst_cb(void *ctx, const int fn, const int ts, const float toa,
+   const float snr, const llr_t *bits, const unsigned int bits_len) {
+
+	phy_s *phy = (phy_s *)ctx;
+	int t3, r, start, biterr;
+	unsigned int i;
+	uint8_t l2[XCCH_L2_LEN];
+	const llr_t *b[XCCH_BURSTS];
+	l1ctl_info_dl_s dl;
+
+	if(phy->ring)
+		phy->ring->write(fn, ts, phy->band_arfcn & ARFCN_MASK, toa, snr, bits, bits_len);
+	if(ts != 0)
+		return;
+	t3 = fn % 51;
+	if((t3 < 2) || ((t3 - 2) % 10 >= 8))
+		return;
+	i = (t3 - 2) % 10 % XCCH_BURSTS;
+	start = (fn - i + MAX_FN) % MAX_FN;
+
+	if(start != phy->blk_fn) {
+		phy->blk_fn = start;
+		phy->blk_have = 0;
+	}
+	memcpy(phy->blk[i], bits, ((bits_len < DATA_LEN)? bits_len : DATA_LEN) * sizeof(llr_t));
+	if(bits_len < DATA_LEN)
+		memset(phy->blk[i] + bits_len, 0, (DATA_LEN - bits_len) * sizeof(llr_t));
+	phy->blk_have |= 1 << i;
+	if(phy->blk_have != (1 << XCCH_BURSTS) - 1)
+		return;
+	phy->blk_fn = -1;
+
+	memset(&dl, 0, sizeof(dl));
+	if(block_chan(phy, start, start % 51, &dl.chan_nr, &dl.link_id))
+		return;
+	for(i = 0; i < XCCH_BURSTS; i++)
+		b[i] = phy->blk[i];
+	r = decode_xcch(b, l2, &biterr);
+
+	dl.band_arfcn = htons(phy->band_arfcn);
+	dl.frame_nr = htonl(start);
+	dl.rx_level = phy->rx_level;
+	dl.num_biterr = (biterr > 255)? 255 : biterr;
+	dl.fire_crc = r? 2 : 0;
+	phy->server->send(L1CTL_DATA_IND, 0, &dl, sizeof(dl), l2, sizeof(l2));
+}
+
+
+/*
+ * Server thread.  Echo is answered here; everything that needs the radio is
+ * queued.
+ */
+static void msg_cb(void *ctx, l1ctl_server *s, const l1ctl_hdr_s *h,
+   const uint8_t *payload, const unsigned int payload_len) {
+
+	phy_s *phy = (phy_s *)ctx;
+	phy_req_s *q;
+
+	switch(h->type) {
+		case L1CTL_ECHO_REQ:
+			s->send(L1CTL_ECHO_CONF, 0, payload, payload_len);
+			return;
+
+		case L1CTL_RACH_REQ:
+		case L1CTL_DM_EST_REQ:
+		case L1CTL_DATA_REQ:
+			fprintf(stderr, "l1ctl: message %u not supported (receive only)\n", h->type);
+			return;
+
+		case L1CTL_FBSB_REQ:
+		case L1CTL_PM_REQ:
+		case L1CTL_RESET_REQ:
+		case L1CTL_CCCH_MODE_REQ:
+			break;
+
+		default:
+			fprintf(stderr, "l1ctl: unknown message %u\n", h->type);
+			return;
+	}
+
+	if(payload_len > MAX_REQ_LEN) {
+		fprintf(stderr, "error: l1ctl: message %u too long (%u)\n", h->type, payload_len);
+		return;
+	}
+
+	pthread_mutex_lock(&phy->req_mutex);
+	if(phy->req_head - phy->req_tail >= REQ_SLOTS) {
+		pthread_mutex_unlock(&phy->req_mutex);
+		fprintf(stderr, "error: l1ctl: request queue full\n");
+		return;
+	}
+	q = &phy->req[phy->req_head % REQ_SLOTS];
+	q->type = h->type;
+	q->len = payload_len;
+	memcpy(q->data, payload, payload_len);
+	phy->req_head += 1;
+	phy->req_pending = 1;
+	pthread_cond_signal(&phy->req_cond);
+	pthread_mutex_unlock(&phy->req_mutex);
+}
+
+
+static void conn_cb(void *ctx, l1ctl_server *s, const int connected) {
+
+	phy_s *phy = (phy_s *)ctx;
+	l1ctl_reset_s reset;
+
+	if(connected) {
+		memset(&reset, 0, sizeof(reset));
+		reset.type = L1CTL_RES_T_BOOT;
+		s->send(L1CTL_RESET_IND, 0, &reset, sizeof(reset));
+		return;
+	}
+
+	pthread_mutex_lock(&phy->req_mutex);
+	if(phy->req_head - phy->req_tail < REQ_SLOTS) {
+		phy->req[phy->req_head % REQ_SLOTS].type = REQ_CLIENT_GONE;
+		phy->req[phy->req_head % REQ_SLOTS].len = 0;
+		phy->req_head += 1;
+	}
+	phy->req_pending = 1;
+	pthread_cond_signal(&phy->req_cond);
+	pthread_mutex_unlock(&phy->req_mutex);
+}
+
+
+/*
+ * Layer 2 expects the confirmation after a downlink info header, as for
+ * DATA_IND.
+ */
+static void do_fbsb(phy_s *phy, const phy_req_s *q) {
+
+	int fn, bsic;
+	const l1ctl_fbsb_req_s *req = (const l1ctl_fbsb_req_s *)q->data;
+	l1ctl_info_dl_s dl;
+	l1ctl_fbsb_conf_s conf;
+	const mtsc_s *m;
+
+	phy->synced = 0;
+	memset(&dl, 0, sizeof(dl));
+	memset(&conf, 0, sizeof(conf));
+	conf.result = 255;
+
+	if(q->len < sizeof(*req)) {
+		fprintf(stderr, "error: l1ctl: short FBSB_REQ\n");
+	} else {
+		dl.band_arfcn = req->band_arfcn;
+		if(!tune_arfcn(phy->u, ntohs(req->band_arfcn)) &&
+		   (m = get_mtsc(MTSC_SB, 0, phy->u->sample_rate() / GSM_RATE))) {
+			phy->band_arfcn = ntohs(req->band_arfcn);
+			phy->ccch_mode = req->ccch_mode;
+			phy->rx_level = measure_rxlev(phy->u, (unsigned int)ceil(FRAME_LEN * phy->u->sample_rate() / GSM_RATE));
+			dl.rx_level = phy->rx_level;
+			if(!camp_acquire(phy->u, m, &fn, &bsic)) {
+				phy->synced = 1;
+				phy->bsic = bsic;
+				phy->blk_fn = -1;
+				dl.frame_nr = htonl(fn);
+				conf.result = 0;
+				conf.bsic = bsic;
+				conf.initial_freq_err = htons((int16_t)floor(phy->u->get_nco()->freq() + 0.5));
+			}
+		}
+	}
+	phy->server->send(L1CTL_FBSB_CONF, 0, &dl, sizeof(dl), &conf, sizeof(conf));
+}
+
+
+/*
+ * Measure every channel of the range and answer in batches, the last one
+ * flagged done.  A reversed range gets an empty answer.  The radio leaves the
+ * carrier we were camped on.
+ */
+static void do_pm(phy_s *phy, const phy_req_s *q) {
+
+	unsigned int n = 0, len;
+	uint16_t a, from, to, flags;
+	const l1ctl_pm_req_s *req = (const l1ctl_pm_req_s *)q->data;
+	l1ctl_pm_conf_s pm[PM_BATCH];
+
+	phy->synced = 0;
+	if((q->len < sizeof(*req)) || (req->type != L1CTL_PM_T_RANGE)) {
+		fprintf(stderr, "error: l1ctl: bad PM_REQ\n");
+		return;
+	}
+	from = ntohs(req->band_arfcn_from);
+	to = ntohs(req->band_arfcn_to);
+	flags = from & (ARFCN_PCS | ARFCN_UPLINK);
+	from &= ARFCN_MASK;
+	to &= ARFCN_MASK;
+	if(from > to) {
+		fprintf(stderr, "error: l1ctl: bad PM_REQ range %u-%u\n", from, to);
+		phy->server->send(L1CTL_PM_CONF, L1CTL_F_DONE, 0, 0);
+		return;
+	}
+	len = (unsigned int)ceil(PM_FRAMES * FRAME_LEN * phy->u->sample_rate() / GSM_RATE);
+
+	for(a = from; ; a++) {
+		pm[n].band_arfcn = htons(a | flags);
+		pm[n].pm[0] = pm[n].pm[1] = tune_arfcn(phy->u, a | flags)? 0 : measure_rxlev(phy->u, len);
+		n += 1;
+		if((a == to) || (n == PM_BATCH)) {
+			phy->server->send(L1CTL_PM_CONF, (a == to)? L1CTL_F_DONE : 0, pm, n * sizeof(*pm));
+			n = 0;
+		}
+		if(a == to)
+			break;
+	}
+}
+
+
+static void do_req(phy_s *phy, const phy_req_s *q) {
+
+	l1ctl_reset_s reset;
+	l1ctl_ccch_mode_s mode;
+
+	switch(q->type) {
+		case L1CTL_FBSB_REQ:
+			do_fbsb(phy, q);
+			break;
+
+		case L1CTL_PM_REQ:
+			do_pm(phy, q);
+			break;
+
+		case L1CTL_RESET_REQ:
+			phy->synced = 0;
+			memset(&reset, 0, sizeof(reset));
+			if(q->len >= sizeof(reset))
+				reset.type = ((const l1ctl_reset_s *)q->data)->type;
+			phy->server->send(L1CTL_RESET_CONF, 0, &reset, sizeof(reset));
+			break;
+
+		case L1CTL_CCCH_MODE_REQ:
+			memset(&mode, 0, sizeof(mode));
+			if(q->len >= sizeof(mode))
+				phy->ccch_mode = ((const l1ctl_ccch_mode_s *)q->data)->ccch_mode;
+			mode.ccch_mode = phy->ccch_mode;
+			phy->server->send(L1CTL_CCCH_MODE_CONF, 0, &mode, sizeof(mode));
+			break;
+
+		case REQ_CLIENT_GONE:
+			phy->synced = 0;
+			break;
+	}
+}
+
+
+/*
+ * l1ctl_serve
+ *
+ * Serve layer 2 on the Unix socket at path until the radio fails.  The USRP
+ * must be started.
+ *
+ * 	n_threads	demodulate with this many threads while camped
+ * 	ring		if given, every demodulated burst is also published here
+ */
+int l1ctl_serve(usrp_source *u, const char *path, const unsigned int n_threads,
+   burst_ring *ring) {
+
+	int r = 0;
+	float sps;
+	phy_req_s q;
+	phy_s *phy;
+	burst_pool *pool = 0;
+
+	phy = new phy_s;
+	memset(phy, 0, sizeof(*phy));
+	phy->u = u;
+	phy->ring = ring;
+	phy->blk_fn = -1;
+	pthread_mutex_init(&phy->req_mutex, 0);
+	pthread_cond_init(&phy->req_cond, 0);
+
+	sps = u->sample_rate() / GSM_RATE;
+	try {
+		if(n_threads > 1)
+			pool = new burst_pool(n_threads, sps, camp_window_len(sps), burst_cb, phy);
+		phy->server = new l1ctl_server(path, msg_cb, conn_cb, phy);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		delete pool;
+		pthread_cond_destroy(&phy->req_cond);
+		pthread_mutex_destroy(&phy->req_mutex);
+		delete phy;
+		return -1;
+	}
+	fprintf(stderr, "l1ctl: listening on %s\n", path);
+
+	for(;;) {
+		pthread_mutex_lock(&phy->req_mutex);
+		while((!phy->synced) && (phy->req_head == phy->req_tail))
+			pthread_cond_wait(&phy->req_cond, &phy->req_mutex);
+		if(phy->req_head == phy->req_tail) {
+			pthread_mutex_unlock(&phy->req_mutex);
+
+			// camped and nothing to do
+			r = camp(u, phy->bsic, burst_cb, phy, 0, pool, &phy->req_pending);
+			if(r < 0)
+				break;
+			if(r == 1) {
+				fprintf(stderr, "l1ctl: lost synchronization\n");
+				phy->synced = 0;
+			}
+			continue;
+		}
+		q = phy->req[phy->req_tail % REQ_SLOTS];
+		phy->req_tail += 1;
+		if(phy->req_head == phy->req_tail)
+			phy->req_pending = 0;
+		pthread_mutex_unlock(&phy->req_mutex);
+
+		do_req(phy, &q);
+	}
+
+	delete phy->server;
+	delete pool;
+	pthread_cond_destroy(&phy->req_cond);
+	pthread_mutex_destroy(&phy->req_mutex);
+	delete phy;
+
+	return r;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include "usrp_source.h"
+#include "burst_ring.h"
+
+int l1ctl_serve(usrp_source *u, const char *path, const unsigned int n_threads = 1,
+   burst_ring *ring = 0);
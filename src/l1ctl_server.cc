@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <stdexcept>
+
+#include "l1ctl_server.h"
+
+
+// epoll user data
+enum {
+	EV_LISTEN,
+	EV_CLIENT,
+	EV_WAKE
+};
+
+
+l1ctl_server::l1ctl_server(const char *path, l1ctl_msg_cb_t msg_cb,
+   l1ctl_conn_cb_t conn_cb, void *ctx) {
+
+	struct sockaddr_un addr;
+	struct epoll_event ev;
+
+	if(strlen(path) >= sizeof(addr.sun_path))
+		throw std::runtime_error("l1ctl_server: path too long");
+
+	m_msg_cb = msg_cb;
+	m_conn_cb = conn_cb;
+	m_ctx = ctx;
+	m_client_fd = -1;
+	m_want_out = 0;
+	m_stop = 0;
+	m_rx_len = 0;
+	m_tx_head = m_tx_tail = 0;
+	m_tx_os = 0;
+	m_dropped = 0;
+	m_listen_fd = m_epoll_fd = m_event_fd = -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	// a previous instance may have left its socket behind
+	unlink(path);
+
+	if((m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1) {
+		perror("socket");
+		goto fail;
+	}
+	if(bind(m_listen_fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("bind");
+		goto fail;
+	}
+	if(listen(m_listen_fd, 1)) {
+		perror("listen");
+		goto fail;
+	}
+	if((m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		perror("eventfd");
+		goto fail;
+	}
+	if((m_epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		perror("epoll_create1");
+		goto fail;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = EV_LISTEN;
+	if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &ev)) {
+		perror("epoll_ctl");
+		goto fail;
+	}
+	ev.data.u32 = EV_WAKE;
+	if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &ev)) {
+		perror("epoll_ctl");
+		goto fail;
+	}
+
+	m_path = strdup(path);
+	pthread_mutex_init(&m_mutex, 0);
+	if(pthread_create(&m_thread, 0, loop_thread, this)) {
+		perror("pthread_create");
+		pthread_mutex_destroy(&m_mutex);
+		free(m_path);
+		unlink(path);
+		goto fail;
+	}
+	return;
+
+fail:
+	if(m_epoll_fd != -1)
+		close(m_epoll_fd);
+	if(m_event_fd != -1)
+		close(m_event_fd);
+	if(m_listen_fd != -1)
+		close(m_listen_fd);
+	throw std::runtime_error("l1ctl_server: cannot listen");
+}
+
+
+l1ctl_server::~l1ctl_server() {
+
+	pthread_mutex_lock(&m_mutex);
+	m_stop = 1;
+	pthread_mutex_unlock(&m_mutex);
+	wake();
+	pthread_join(m_thread, 0);
+
+	if(m_client_fd != -1)
+		close(m_client_fd);
+	close(m_epoll_fd);
+	close(m_event_fd);
+	close(m_listen_fd);
+	unlink(m_path);
+	free(m_path);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+/*
+ * Queue a message made of a header and up to two pieces of payload (e.g., an
+ * info_dl and the data that follows it).
+ *
+ * 	returns	0 if the message was queued, -1 if there is no client, the
+ * 		message is too long or the ring is full
+ */
+int l1ctl_server::send(const uint8_t type, const uint8_t flags,
+   const void *p1, const unsigned int p1_len,
+   const void *p2, const unsigned int p2_len) {
+
+	unsigned int len;
+	tx_slot_s *slot;
+	l1ctl_hdr_s *h;
+
+	len = sizeof(l1ctl_hdr_s) + p1_len + p2_len;
+	if(len > MAX_MSG_LEN) {
+		fprintf(stderr, "error: l1ctl_server::send: message too long (%u)\n", len);
+		return -1;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	if(m_client_fd == -1) {
+		pthread_mutex_unlock(&m_mutex);
+		return -1;
+	}
+	if(m_tx_head - m_tx_tail >= TX_SLOTS) {
+		m_dropped += 1;
+		pthread_mutex_unlock(&m_mutex);
+		return -1;
+	}
+
+	slot = &m_tx[m_tx_head % TX_SLOTS];
+	slot->buf[0] = (len >> 8) & 0xff;
+	slot->buf[1] = len & 0xff;
+	h = (l1ctl_hdr_s *)(slot->buf + L1CTL_LEN_LEN);
+	h->type = type;
+	h->flags = flags;
+	h->padding[0] = h->padding[1] = 0;
+	if(p1_len)
+		memcpy(slot->buf + L1CTL_LEN_LEN + sizeof(l1ctl_hdr_s), p1, p1_len);
+	if(p2_len)
+		memcpy(slot->buf + L1CTL_LEN_LEN + sizeof(l1ctl_hdr_s) + p1_len, p2, p2_len);
+	slot->len = L1CTL_LEN_LEN + len;
+
+	// the loop only needs waking if it has nothing queued already
+	if(m_tx_head++ == m_tx_tail) {
+		pthread_mutex_unlock(&m_mutex);
+		wake();
+		return 0;
+	}
+	pthread_mutex_unlock(&m_mutex);
+	return 0;
+}
+
+
+int l1ctl_server::connected() {
+
+	int r;
+
+	pthread_mutex_lock(&m_mutex);
+	r = (m_client_fd != -1);
+	pthread_mutex_unlock(&m_mutex);
+	return r;
+}
+
+
+unsigned long long l1ctl_server::dropped() {
+
+	unsigned long long r;
+
+	pthread_mutex_lock(&m_mutex);
+	r = m_dropped;
+	pthread_mutex_unlock(&m_mutex);
+	return r;
+}
+
+
+void l1ctl_server::wake() {
+
+	uint64_t one = 1;
+
+	if(write(m_event_fd, &one, sizeof(one)) != sizeof(one)) {
+		// the counter is already non-zero, the loop will wake anyway
+	}
+}
+
+
+void *l1ctl_server::loop_thread(void *arg) {
+
+	((l1ctl_server *)arg)->loop();
+	return 0;
+}
+
+
+void l1ctl_server::loop() {
+
+	int i, n;
+	uint64_t count;
+	struct epoll_event ev[4];
+
+	for(;;) {
+		if((n = epoll_wait(m_epoll_fd, ev, sizeof(ev) / sizeof(*ev), -1)) == -1) {
+			if(errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			break;
+		}
+
+		for(i = 0; i < n; i++) {
+			switch(ev[i].data.u32) {
+				case EV_LISTEN:
+					accept_client();
+					break;
+
+				case EV_CLIENT:
+					if(m_client_fd == -1)
+						break;
+					if(ev[i].events & (EPOLLERR | EPOLLHUP)) {
+						close_client();
+						break;
+					}
+					if((ev[i].events & EPOLLIN) && read_client()) {
+						close_client();
+						break;
+					}
+					if((ev[i].events & EPOLLOUT) && flush())
+						close_client();
+					break;
+
+				case EV_WAKE:
+					if(read(m_event_fd, &count, sizeof(count)) != sizeof(count)) {
+						// already drained
+					}
+					break;
+			}
+		}
+
+		pthread_mutex_lock(&m_mutex);
+		if(m_stop) {
+			pthread_mutex_unlock(&m_mutex);
+			break;
+		}
+		pthread_mutex_unlock(&m_mutex);
+
+		// send whatever was queued while we were busy
+		if((m_client_fd != -1) && (!m_want_out) && flush())
+			close_client();
+	}
+}
+
+
+/*
+ * Only one layer 2 may drive the radio; later clients are turned away until
+ * the current one goes.
+ */
+void l1ctl_server::accept_client() {
+
+	int fd;
+	struct epoll_event ev;
+
+	if((fd = accept4(m_listen_fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) == -1) {
+		if((errno != EAGAIN) && (errno != EWOULDBLOCK))
+			perror("accept4");
+		return;
+	}
+	if(m_client_fd != -1) {
+		fprintf(stderr, "l1ctl: already serving a client\n");
+		close(fd);
+		return;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = EV_CLIENT;
+	if(epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev)) {
+		perror("epoll_ctl");
+		close(fd);
+		return;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	m_client_fd = fd;
+	m_tx_head = m_tx_tail = 0;
+	m_tx_os = 0;
+	pthread_mutex_unlock(&m_mutex);
+	m_rx_len = 0;
+	m_want_out = 0;
+
+	fprintf(stderr, "l1ctl: client connected\n");
+	if(m_conn_cb)
+		m_conn_cb(m_ctx, this, 1);
+}
+
+
+void l1ctl_server::close_client() {
+
+	int fd;
+
+	pthread_mutex_lock(&m_mutex);
+	fd = m_client_fd;
+	m_client_fd = -1;
+	m_tx_head = m_tx_tail = 0;
+	m_tx_os = 0;
+	pthread_mutex_unlock(&m_mutex);
+
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, 0);
+	close(fd);
+	m_want_out = 0;
+
+	fprintf(stderr, "l1ctl: client disconnected\n");
+	if(m_conn_cb)
+		m_conn_cb(m_ctx, this, 0);
+}
+
+
+/*
+ * Read what the client sent and hand every complete frame to the callback
+ * straight out of the receive buffer.  A partial frame is moved to the front
+ * of the buffer to wait for the rest.
+ *
+ * 	returns	-1 if the client should be dropped
+ */
+int l1ctl_server::read_client() {
+
+	int r;
+	unsigned int pos, len;
+
+	r = recv(m_client_fd, m_rx + m_rx_len, RX_LEN - m_rx_len, 0);
+	if(r == 0)
+		return -1;
+	if(r < 0) {
+		if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+			return 0;
+		perror("recv");
+		return -1;
+	}
+	m_rx_len += r;
+
+	for(pos = 0; pos + L1CTL_LEN_LEN <= m_rx_len; pos += L1CTL_LEN_LEN + len) {
+		len = (m_rx[pos] << 8) | m_rx[pos + 1];
+		if((len < sizeof(l1ctl_hdr_s)) || (L1CTL_LEN_LEN + len > RX_LEN)) {
+			fprintf(stderr, "error: l1ctl: bad message length (%u)\n", len);
+			return -1;
+		}
+		if(pos + L1CTL_LEN_LEN + len > m_rx_len)
+			break;
+		m_msg_cb(m_ctx, this, (const l1ctl_hdr_s *)(m_rx + pos + L1CTL_LEN_LEN),
+		   m_rx + pos + L1CTL_LEN_LEN + sizeof(l1ctl_hdr_s),
+		   len - sizeof(l1ctl_hdr_s));
+	}
+
+	if(pos) {
+		m_rx_len -= pos;
+		memmove(m_rx, m_rx + pos, m_rx_len);
+	}
+	return 0;
+}
+
+
+/*
+ * Write as much of the ring as the socket takes with one sendmsg.  Slots
+ * between the tail and the head are not touched by send so the lock is only
+ * held while the vector is built and the tail advanced.  If the socket fills
+ * up we wait for EPOLLOUT.
+ *
+ * 	returns	-1 if the client should be dropped
+ */
+int l1ctl_server::flush() {
+
+	unsigned int n, len;
+	unsigned long long s, head, tail;
+	ssize_t r;
+	struct iovec iov[MAX_IOV];
+	struct msghdr msg;
+
+	pthread_mutex_lock(&m_mutex);
+	head = m_tx_head;
+	tail = m_tx_tail;
+	pthread_mutex_unlock(&m_mutex);
+
+	while(tail != head) {
+		for(n = 0, s = tail; (s != head) && (n < MAX_IOV); s++, n++) {
+			iov[n].iov_base = m_tx[s % TX_SLOTS].buf;
+			iov[n].iov_len = m_tx[s % TX_SLOTS].len;
+		}
+		iov[0].iov_base = (uint8_t *)iov[0].iov_base + m_tx_os;
+		iov[0].iov_len -= m_tx_os;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = n;
+		if((r = sendmsg(m_client_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT)) == -1) {
+			if(errno == EINTR)
+				continue;
+			if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				want_out(1);
+				return 0;
+			}
+			perror("sendmsg");
+			return -1;
+		}
+
+		// retire the slots that went out completely
+		pthread_mutex_lock(&m_mutex);
+		while(r > 0) {
+			len = m_tx[m_tx_tail % TX_SLOTS].len - m_tx_os;
+			if((size_t)r < len) {
+				m_tx_os += r;
+				break;
+			}
+			r -= len;
+			m_tx_os = 0;
+			m_tx_tail += 1;
+		}
+		tail = m_tx_tail;
+		head = m_tx_head;
+		pthread_mutex_unlock(&m_mutex);
+	}
+
+	want_out(0);
+	return 0;
+}
+
+
+void l1ctl_server::want_out(const int on) {
+
+	struct epoll_event ev;
+
+	if(on == m_want_out)
+		return;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | (on? EPOLLOUT : 0);
+	ev.data.u32 = EV_CLIENT;
+	if(epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, m_client_fd, &ev))
+		perror("epoll_ctl");
+	m_want_out = on;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "l1ctl.h"
+
+class l1ctl_server;
+
+/*
+ * Called on the server thread for each complete message.  The header and
+ * payload point into the receive buffer and are only valid during the call.
+ */
+typedef void (*l1ctl_msg_cb_t)(void *ctx, l1ctl_server *s,
+   const l1ctl_hdr_s *h, const uint8_t *payload,
+   const unsigned int payload_len);
+
+// called on the server thread when a client connects (1) or goes away (0)
+typedef void (*l1ctl_conn_cb_t)(void *ctx, l1ctl_server *s, const int connected);
+
+
+/*
+ * l1ctl_server
+ *
+ * Serves one layer 2 client on a Unix domain socket.
+ *
+ * A single thread runs an epoll loop over the listening socket, the client
+ * and an eventfd.  Received frames are parsed in place and handed to msg_cb
+ * without copying.  Outgoing messages may be sent from any thread: send
+ * copies them into a fixed ring of slots and pokes the eventfd, and the loop
+ * writes every queued message with one gathered write.  Nothing is allocated
+ * once the server is running.  If the client can't keep up and the ring
+ * fills, new messages are dropped rather than blocking the radio.
+ */
+class l1ctl_server {
+public:
+	l1ctl_server(const char *path, l1ctl_msg_cb_t msg_cb,
+	   l1ctl_conn_cb_t conn_cb, void *ctx);
+	~l1ctl_server();
+
+	int send(const uint8_t type, const uint8_t flags,
+	   const void *p1, const unsigned int p1_len,
+	   const void *p2 = 0, const unsigned int p2_len = 0);
+	int connected();
+	unsigned long long dropped();
+
+	static const unsigned int	MAX_MSG_LEN	= 512;	// header and payload
+
+private:
+	typedef struct {
+		unsigned int	len;		// including the length prefix
+		uint8_t		buf[L1CTL_LEN_LEN + MAX_MSG_LEN];
+	} tx_slot_s;
+
+	static void *loop_thread(void *arg);
+	void loop();
+	void accept_client();
+	void close_client();
+	int read_client();
+	int flush();
+	void want_out(const int on);
+	void wake();
+
+	static const unsigned int	RX_LEN		= 4096;
+	static const unsigned int	TX_SLOTS	= 128;
+	static const unsigned int	MAX_IOV		= 64;
+
+	char *			m_path;
+	l1ctl_msg_cb_t		m_msg_cb;
+	l1ctl_conn_cb_t		m_conn_cb;
+	void *			m_ctx;
+
+	int			m_listen_fd;
+	int			m_client_fd;	// -1 when nobody is connected
+	int			m_epoll_fd;
+	int			m_event_fd;
+	int			m_want_out;	// EPOLLOUT is armed on the client
+	int			m_stop;
+
+	uint8_t			m_rx[RX_LEN];
+	unsigned int		m_rx_len;
+
+	tx_slot_s		m_tx[TX_SLOTS];
+	unsigned long long	m_tx_head;	// next slot to fill
+	unsigned long long	m_tx_tail;	// next slot to write
+	unsigned int		m_tx_os;	// bytes of the tail slot already written
+	unsigned long long	m_dropped;
+
+	pthread_t		m_thread;
+	pthread_mutex_t		m_mutex;	// protects the ring and m_client_fd
+};
@@ -40,6 +40,7 @@
 #include <string.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <stdexcept>
 
 #include <usrp/usrp_dbid.h>
 
@@ -53,28 +54,113 @@
 #include "sch.h"
 #include "gsm_demod.h"
 #include "gsm_bursts.h"
-#include "sch.h"
+#include "camp.h"
+#include "burst_ring.h"
+#ifdef D_L1CTL
+#include "l1ctl_phy.h"
+#endif /* D_L1CTL */
+#include "cell_db.h"
 
 static const float default_gain = 0.45;
+static const unsigned int RING_SLOTS = 8192;
+static const unsigned int SCH_FOLLOW = 5;
+static const time_t CLOCK_ERROR_AGE = 24 * 60 * 60;	// trusted for a day
+
+
+typedef struct {
+	int		fn;		// first frame of the current multiframe
+	unsigned int	bursts[8];	// bursts demodulated per time slot
+	burst_ring *	ring;		// if given, every burst is published here
+	int		arfcn;
+} camp_stats_s;
+
+
+/*
+ * Print how many bursts were demodulated in each time slot once per
+ * 51-multiframe.
+ */
+static void count_burst(void *ctx, const int fn, const int ts, const float toa,
+   const float snr, const llr_t *bits, const unsigned int bits_len) {
+
+	camp_stats_s *stats = (camp_stats_s *)ctx;
+	int i;
+
+	if(stats->ring)
+		stats->ring->write(fn, ts, stats->arfcn, toa, snr, bits, bits_len);
+
+	if(fn - fn % 51 != stats->fn) {
+		if(stats->fn >= 0) {
+			printf("%d:", stats->fn);
+			for(i = 0; i < 8; i++)
+				printf(" %u", stats->bursts[i]);
+			printf("\n");
+		}
+		memset(stats->bursts, 0, sizeof(stats->bursts));
+		stats->fn = fn - fn % 51;
+	}
+	stats->bursts[ts] += 1;
+}
+
+
+/*
+ * The strongest cell of a band seen since when.
+ */
+static cell_s *strongest_cell(cell_db *db, const int bi, const time_t when) {
+
+	unsigned int i;
+	cell_s *c, *best = 0;
+
+	for(i = 0; (c = db->get(i)); i++) {
+		if((c->bi != bi) || (c->last_seen < when))
+			continue;
+		if((!best) || (c->power > best->power))
+			best = c;
+	}
+	return best;
+}
+
+
+/*
+ * Note the BSIC of the cell we camped on.
+ */
+static void record_bsic(cell_db *db, const int bi, const int chan, const int bsic) {
+
+	cell_s *c;
+
+	if((!db) || (!(c = db->update(bi, chan))))
+		return;
+	c->bsic = bsic;
+	c->last_seen = time(0);
+	db->save();
+}
 
 
 void usage(char *prog) {
 
 	printf("layer1_usrp v%s, Copyright (c) 2011, Joshua Lackey\n", layer1_usrp_version_string);
 	printf("\nUsage:\n");
-	printf("\t%s <-f frequency | -c channel> [options]\n", basename(prog));
+	printf("\t%s <-f frequency | -c channel | -b band> [options]\n", basename(prog));
 	printf("\n");
 	printf("Where options are:\n");
 	printf("\t-a <addr>\tUHD device address\n");
 	printf("\t-f <freq>\tfrequency of nearby GSM base station\n");
 	printf("\t-c <chan>\tchannel of nearby GSM base station\n");
-	printf("\t-b <band>\tband indicator (GSM850, GSM900, EGSM, DCS, PCS)\n");
+	printf("\t-b <band>\tband indicator (GSM850, GSM900, EGSM, DCS, PCS), alone\n\t\t\tuses the strongest base station in the band\n");
 	printf("\t-g <gain>\tgain as %% of range, defaults to %.0f%%\n", 100 * default_gain);
 	printf("\t-R <side>\tside A (0) or B (1), defaults to B\n");
 	printf("\t-A <ant>\tantenna TX/RX (0) or RX2 (1), defaults to RX2\n");
 	printf("\t-F <freq>\tFPGA master clock frequency\n");
 	printf("\t-2\t\tuse USRP2 series\n");
 	printf("\t-x\t\tuse external reference clock\n");
+	printf("\t-C\t\tcamp on the channel and demodulate every burst\n");
+	printf("\t-j <n>\t\tdemodulate with n threads while camping\n");
+	printf("\t-S <sps>\tsamples per symbol (1, 2 or 4), defaults to 1\n");
+	printf("\t-M\t\tequalize with MLSE instead of a DFE\n");
+#ifdef D_L1CTL
+	printf("\t-L <path>\tserve OsmocomBB layer 2 on this Unix socket\n");
+#endif /* D_L1CTL */
+	printf("\t-B <name>\tpublish demodulated bursts in this shared memory ring\n");
+	printf("\t-T <sec>\tstop scanning the band after this long\n");
 	printf("\t-h\t\thelp\n");
 	exit(-1);
 }
@@ -82,14 +168,18 @@ void usage(char *prog) {
 
 int main(int argc, char **argv) {
 
-	char *device_address = 0, *endptr;
-	int c, bi = BI_NOT_DEFINED, chan = -1, two_series = 0, subdev = -1, antenna = -1;
+	char *device_address = 0, *endptr, *l1ctl_path = 0, *ring_name = 0;
+	int c, bi = BI_NOT_DEFINED, chan = -1, two_series = 0, subdev = -1, antenna = -1, camping = 0, n_threads = 1, sps = 1;
 	long int fpga_master_clock_freq = 0;
 	float gain = default_gain;
-	double freq = -1.0;
+	double freq = -1.0, tune_freq, max_time = 0.0;
+	float ppm, offset;
+	time_t when;
+	cell_db *db;
+	cell_s *cell;
 	usrp_source *u;
 
-	while((c = getopt(argc, argv, "a:f:c:b:g:R:A:F:x2h?")) != EOF) {
+	while((c = getopt(argc, argv, "a:f:c:b:g:R:A:F:x2Cj:S:ML:B:T:h?")) != EOF) {
 		switch(c) {
 			case 'a':
 				device_address = optarg;
@@ -162,6 +252,47 @@ int main(int argc, char **argv) {
 					usage(argv[0]);
 				break;
 
+			case 'C':
+				camping = 1;
+				break;
+
+			case 'j':
+				n_threads = strtol(optarg, 0, 0);
+				if(n_threads < 1)
+					usage(argv[0]);
+				break;
+
+			case 'S':
+				sps = strtol(optarg, 0, 0);
+				if((sps != 1) && (sps != 2) && (sps != 4))
+					usage(argv[0]);
+				break;
+
+			case 'M':
+				set_equalizer(EQ_MLSE);
+				break;
+
+			case 'L':
+#ifdef D_L1CTL
+				l1ctl_path = optarg;
+				break;
+#else /* D_L1CTL */
+				fprintf(stderr, "error: built without L1CTL support\n");
+				exit(-1);
+#endif /* D_L1CTL */
+
+			case 'B':
+				ring_name = optarg;
+				break;
+
+			case 'T':
+				max_time = strtod(optarg, 0);
+				if(max_time <= 0.0) {
+					fprintf(stderr, "error: bad scan time: ``%s''\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+
 			case 'h':
 			case '?':
 			default:
@@ -171,23 +302,38 @@ int main(int argc, char **argv) {
 
 	}
 
-	if(freq < 0.0) {
-		if(chan < 0) {
-			fprintf(stderr, "error: must enter channel or frequency\n");
+	// a missing database only means scans start from scratch
+	try {
+		db = new cell_db();
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "warning: %s\n", e.what());
+		db = 0;
+	}
+
+	if((freq < 0.0) && (chan < 0)) {
+		if(bi == BI_NOT_DEFINED) {
+			fprintf(stderr, "error: must enter channel, frequency or band\n");
 			usage(argv[0]);
 		}
-		if((freq = arfcn_to_freq(chan, &bi)) < 869e6)
+		if(!db) {
+			fprintf(stderr, "error: scanning a band needs the cell database\n");
+			return -1;
+		}
+	} else {
+		if(freq < 0.0) {
+			if((freq = arfcn_to_freq(chan, &bi)) < 869e6)
+				usage(argv[0]);
+		}
+		if((freq < 869e6) || (2e9 < freq)) {
+			fprintf(stderr, "error: bad frequency: %lf\n", freq);
 			usage(argv[0]);
+		}
+		if((chan = freq_to_arfcn(freq, &bi)) < 0) {
+			fprintf(stderr, "error: not a GSM frequency: %lf\n", freq);
+			return -1;
+		}
 	}
-	if((freq < 869e6) || (2e9 < freq)) {
-		fprintf(stderr, "error: bad frequency: %lf\n", freq);
-		usage(argv[0]);
-	}
-	if((chan = freq_to_arfcn(freq, &bi)) < 0) {
-		fprintf(stderr, "error: not a GSM frequency: %lf\n", freq);
-		return -1;
-	}
-	u = new usrp_source(GSM_RATE, device_address, fpga_master_clock_freq);
+	u = new usrp_source(sps * GSM_RATE, device_address, fpga_master_clock_freq);
 	if(!u) {
 		fprintf(stderr, "error: usrp_source\n");
 		return -1;
@@ -222,41 +368,132 @@ int main(int argc, char **argv) {
 		return -1;
 	}
 	 */
-	if(u->tune(freq)) {
+	fprintf(stderr, "Daughterboard %s (antenna %s)\n", u->get_subdev_name(), u->get_antenna_name());
+
+	// known cells are checked first, so this is quick where we've been
+	if(chan < 0) {
+		when = time(0);
+		if(c0_detect(u, bi, 0, 2, db, max_time)) {
+			fprintf(stderr, "error: c0_detect\n");
+			return -1;
+		}
+		if(!(cell = strongest_cell(db, bi, when))) {
+			fprintf(stderr, "error: no base station found in %s\n", bi_to_str(bi));
+			return -1;
+		}
+		chan = cell->arfcn;
+		freq = arfcn_to_freq(chan, 0);
+	}
+
+	// start on the clock error measured last time, if it's recent
+	tune_freq = freq;
+	if(db && (!db->clock_error(&ppm, &when)) && (time(0) - when < CLOCK_ERROR_AGE)) {
+		tune_freq = freq * (1.0 + ppm * 1e-6);
+		fprintf(stderr, "Correcting clock error of %.3f ppm\n", ppm);
+	}
+	if(u->tune(tune_freq)) {
 		fprintf(stderr, "error: usrp_source::tune\n");
 		return -1;
 	}
-	fprintf(stderr, "Daughterboard %s (antenna %s)\n", u->get_subdev_name(), u->get_antenna_name());
 	fprintf(stderr, "Using %s channel %d (%.1fMHz)\n", bi_to_str(bi), chan, freq / 1e6);
 
 	u->start();
 	u->flush();
 
+	// otherwise measure it on this carrier for next time
+	if(db && (tune_freq == freq)) {
+		if(!offset_detect(u, 0, &offset, 0, 0, 0)) {
+			ppm = offset / freq * 1e6;
+			fprintf(stderr, "Measured clock error of %.3f ppm\n", ppm);
+			db->set_clock_error(ppm);
+			db->save();
+			if(u->tune(freq * (1.0 + ppm * 1e-6))) {
+				fprintf(stderr, "error: usrp_source::tune\n");
+				return -1;
+			}
+			u->flush();
+		}
+	}
+
 	complex *buf;
-	unsigned int buf_len;
+	unsigned int buf_len, i, b_len;
+	int fn, bsic, sch_fn, sch_bsic;
+	float *b, u_sps;
+	camp_stats_s stats;
+	burst_pool *pool = 0;
+	burst_ring *ring = 0;
 
-	mtsc_s *m = 0;
-	// dfe_filter_s *d = 0;
+	const mtsc_s *m;
 
-	if(generate_modulated_tsc(1.0, sb_etsc, SB_CODE_LEN, SB_ETS_OS, &m) == -1) {
+	u_sps = u->sample_rate() / GSM_RATE;
+	if(!(m = get_mtsc(MTSC_SB, 0, u_sps))) {
 		return -1;
 	}
-	if(!(buf = get_burst_sch(u, &buf_len))) {
-		printf("get_burst_sch: fail\n");
-		return -1;
+
+	if(ring_name) {
+		try {
+			ring = new burst_ring(ring_name, RING_SLOTS);
+		} catch(std::runtime_error &e) {
+			fprintf(stderr, "error: %s\n", e.what());
+			return -1;
+		}
 	}
 
-	/*
-	if((f = demod_burst(1.0, &f_len, sch_buf, sch_buf_len, m, 0))) {
-		if(!decode_sch_soft(f, &fn, &bsic)) {
-			success += 1;
+#ifdef D_L1CTL
+	if(l1ctl_path) {
+		c = l1ctl_serve(u, l1ctl_path, n_threads, ring);
+		delete ring;
+		u->stop();
+		return c;
+	}
+#endif /* D_L1CTL */
+
+	if(camping) {
+		memset(&stats, 0, sizeof(stats));
+		stats.fn = -1;
+		stats.ring = ring;
+		stats.arfcn = chan;
+		if(n_threads > 1)
+			pool = new burst_pool(n_threads, u_sps, camp_window_len(u_sps), count_burst, &stats);
+		while(!camp_acquire(u, m, &fn, &bsic)) {
 			printf("%d %d\n", fn, bsic);
-		} else
-			printf("failed\n");
-		delete[] f;
-	} else
+			record_bsic(db, bi, chan, bsic);
+			if(camp(u, bsic, count_burst, &stats, 0, pool) != 1)
+				break;
+			fprintf(stderr, "lost synchronization\n");
+		}
+		delete pool;
+		delete ring;
+		u->stop();
+		return 0;
+	}
+
+	if(camp_acquire(u, m, &fn, &bsic)) {
 		printf("failed\n");
+		u->stop();
+		return 0;
+	}
+	printf("%d %d\n", fn, bsic);
+	record_bsic(db, bi, chan, bsic);
+
+	/*
+	 * From here on bursts are fetched by frame number; check that by
+	 * following the next few synchronization bursts.
 	 */
+	for(i = 0; i < SCH_FOLLOW; i++) {
+		fn = (fn + ((fn % 51 == 41)? 11 : 10)) % MAX_FN;
+		if(!(buf = get_burst(u, &buf_len, fn, 0, GUARD_LEN)))
+			break;
+		if(!(b = demod_burst(u_sps, &b_len, buf, buf_len, m, 0))) {
+			printf("%d: no burst\n", fn);
+			continue;
+		}
+		if(!decode_sch_soft(b, &sch_fn, &sch_bsic))
+			printf("%d %d%s\n", sch_fn, sch_bsic, (sch_fn == fn)? "" : " (clock mismatch)");
+		else
+			printf("%d: decode failed\n", fn);
+		delete[] b;
+	}
 
 	u->stop();
 	return 0;
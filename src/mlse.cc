@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "mlse.h"
+
+
+// the trellis keeps this many symbols, older ones are kept with each survivor
+static const unsigned int STATE_BITS	= 4;
+static const unsigned int MAX_STATES	= (1 << STATE_BITS);
+static const unsigned int MAX_TAPS	= 16;
+static const float RELIABLE		= 1e9;
+
+
+/*
+ * Real part of g[k] after taking out the GMSK rotation, i.e., of g[k] j^-k.
+ */
+static float derotate_real(const complex g, const unsigned int k) {
+
+	switch(k % 4) {
+		case 0:
+			return g.real();
+		case 1:
+			return g.imag();
+		case 2:
+			return -g.real();
+		default:
+			return -g.imag();
+	}
+}
+
+
+/*
+ * Maximum likelihood sequence estimation with soft outputs.
+ *
+ * 	z	matched filter output, one sample per symbol, z[n] for
+ * 		symbol n - (g_len - 1)
+ * 	g	autocorrelation of the channel at symbol spacing, g[0] .. the
+ * 		last lag that matters
+ * 	noise	noise power per sample before the matched filter
+ * 	out_len	symbols to return, z_len must be out_len + 2 * (g_len - 1)
+ *
+ * 	returns	soft bits in [0, 1] as from equalize
+ *
+ * The metric is Ungerboeck's, which works directly on the matched filter
+ * output so the same trellis serves every sample rate.  Once the rotation is
+ * taken out the symbols are +/-1 and only the real parts of z and g matter.
+ *
+ * The trellis is reduced to STATE_BITS symbols of memory.  Taps beyond that
+ * are cancelled with the decisions of each survivor, which keeps its older
+ * symbols in a register that is shifted along with it as the survivors are
+ * chosen.  Reliabilities are those of the soft output Viterbi algorithm: each
+ * bit is as reliable as the smallest metric difference to a competing path
+ * that decides it the other way.
+ */
+float *mlse_equalize(const complex *z, const unsigned int z_len,
+   const complex *g, const unsigned int g_len, const float noise,
+   const unsigned int out_len, unsigned int *len_o) {
+
+	unsigned int L, B, S, H, O, n, i, k, s, p, q, u, t, ml, cl, lead, *states;
+	int x;
+	float zr, scale, best, m0, m1, acc, *b;
+	float gr[MAX_TAPS], tab[MAX_STATES], c[MAX_STATES], metric[MAX_STATES];
+	float a0[MAX_STATES / 2], a1[MAX_STATES / 2], b0[MAX_STATES / 2], b1[MAX_STATES / 2];
+	float xa[MAX_STATES][MAX_TAPS], xb[MAX_STATES][MAX_TAPS], (*xo)[MAX_TAPS], (*xn)[MAX_TAPS], (*xt)[MAX_TAPS];
+	unsigned char *surv, *path;
+	float *delta, *rel;
+
+	if((g_len < 2) || (g_len > MAX_TAPS)) {
+		fprintf(stderr, "error: mlse_equalize: bad channel length (%u)\n", g_len);
+		return 0;
+	}
+	L = g_len - 1;
+	lead = L;
+	if(z_len != out_len + 2 * L) {
+		fprintf(stderr, "error: mlse_equalize: bad length\n");
+		return 0;
+	}
+	if((noise <= 0.0) || (g[0].real() <= 0.0))
+		return 0;
+
+	B = (L < STATE_BITS)? L : STATE_BITS;
+	S = 1 << B;
+	H = S / 2;
+	O = L - B;
+
+	for(k = 1; k <= L; k++)
+		gr[k] = derotate_real(g[k], k);
+
+	// contribution of the symbols a state holds
+	for(p = 0; p < S; p++) {
+		tab[p] = 0.0;
+		for(k = 1; k <= B; k++)
+			tab[p] += gr[k] * (((p >> (k - 1)) & 1)? -1.0 : 1.0);
+	}
+
+	// survivor decisions (the bit dropped from the predecessor) and metric differences
+	surv = new unsigned char[z_len * S];
+	delta = new float[z_len * S];
+
+	/*
+	 * xo[s][m] is the symbol B + 1 + m before the next one of the survivor
+	 * in state s, gr[B + 1 + m] its tap.  Symbols before the burst are 0.
+	 */
+	xo = xa;
+	xn = xb;
+	for(s = 0; s < S; s++) {
+		metric[s] = 0.0;
+		for(k = 0; k < O; k++)
+			xo[s][k] = 0.0;
+	}
+	scale = 2.0 / noise;
+
+	for(n = 0; n < z_len; n++) {
+
+		// symbol n - lead, rotated by j^(n - lead)
+		zr = derotate_real(z[n], (n + 4 * MAX_TAPS - lead) % 4);
+
+		// what each predecessor predicts, survivors supplying the older symbols
+		for(p = 0; p < S; p++) {
+			acc = tab[p];
+			for(k = 0; k < O; k++)
+				acc += gr[B + 1 + k] * xo[p][k];
+			c[p] = acc;
+		}
+
+		/*
+		 * Butterflies: predecessors i and i + H both lead to states 2i
+		 * (new bit 0, x = +1) and 2i + 1 (new bit 1, x = -1).
+		 */
+		for(i = 0; i < H; i++) {
+			m0 = scale * (zr - c[i]);
+			m1 = scale * (zr - c[i + H]);
+			a0[i] = metric[i] + m0;
+			a1[i] = metric[i + H] + m1;
+			b0[i] = metric[i] - m0;
+			b1[i] = metric[i + H] - m1;
+		}
+		for(i = 0; i < H; i++) {
+			if(a0[i] >= a1[i]) {
+				metric[2 * i] = a0[i];
+				delta[n * S + 2 * i] = a0[i] - a1[i];
+				surv[n * S + 2 * i] = 0;
+			} else {
+				metric[2 * i] = a1[i];
+				delta[n * S + 2 * i] = a1[i] - a0[i];
+				surv[n * S + 2 * i] = 1;
+			}
+			if(b0[i] >= b1[i]) {
+				metric[2 * i + 1] = b0[i];
+				delta[n * S + 2 * i + 1] = b0[i] - b1[i];
+				surv[n * S + 2 * i + 1] = 0;
+			} else {
+				metric[2 * i + 1] = b1[i];
+				delta[n * S + 2 * i + 1] = b1[i] - b0[i];
+				surv[n * S + 2 * i + 1] = 1;
+			}
+		}
+
+		/*
+		 * Each state takes its predecessor's register shifted by one,
+		 * the bit dropped from the predecessor (the decision) first.
+		 */
+		if(O) {
+			for(s = 0; s < S; s++) {
+				q = (s >> 1) + (surv[n * S + s]? H : 0);
+				xn[s][0] = (n < B)? 0.0 : (surv[n * S + s]? -1.0 : 1.0);
+				for(k = 1; k < O; k++)
+					xn[s][k] = xo[q][k - 1];
+			}
+			xt = xo;
+			xo = xn;
+			xn = xt;
+		}
+
+		// keep the metrics small
+		best = metric[0];
+		for(s = 1; s < S; s++)
+			if(metric[s] > best)
+				best = metric[s];
+		for(s = 0; s < S; s++)
+			metric[s] -= best;
+	}
+
+	// trace back the best path
+	states = new unsigned int[z_len];
+	path = new unsigned char[z_len];
+	rel = new float[z_len];
+	ml = 0;
+	for(s = 1; s < S; s++)
+		if(metric[s] > metric[ml])
+			ml = s;
+	for(n = z_len; n > 0; n--) {
+		states[n - 1] = ml;
+		path[n - 1] = ml & 1;
+		rel[n - 1] = RELIABLE;
+		ml = (ml >> 1) | (surv[(n - 1) * S + ml] << (B - 1));
+	}
+
+	/*
+	 * The competitor at each step of the best path agrees on the newest
+	 * bit.  Follow it back until it merges with the best path, lowering
+	 * the reliability of every bit it decides differently.
+	 */
+	for(n = 1; n < z_len; n++) {
+		s = states[n];
+		cl = (s >> 1) | ((1 - surv[n * S + s]) << (B - 1));
+		for(t = n; t > 0; t--) {
+			u = t - 1;
+			if(cl == states[u])
+				break;
+			if((cl & 1) != path[u]) {
+				if(delta[n * S + s] < rel[u])
+					rel[u] = delta[n * S + s];
+			}
+			cl = (cl >> 1) | (surv[u * S + cl] << (B - 1));
+		}
+	}
+
+	b = new float[out_len];
+	for(i = 0; i < out_len; i++) {
+		x = path[lead + i]? -1 : 1;
+		b[i] = (1.0 - x * tanhf(rel[lead + i] / 2.0)) / 2.0;
+	}
+
+	delete[] states;
+	delete[] rel;
+	delete[] path;
+	delete[] delta;
+	delete[] surv;
+
+	if(len_o)
+		*len_o = out_len;
+
+	return b;
+}
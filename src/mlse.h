@@ -0,0 +1,7 @@
+#pragma once
+
+#include "usrp_complex.h"
+
+float *mlse_equalize(const complex *z, const unsigned int z_len,
+   const complex *g, const unsigned int g_len, const float noise,
+   const unsigned int out_len, unsigned int *len_o);
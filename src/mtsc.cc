@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <math.h>
+
+#include "usrp_complex.h"
+#include "dsp.h"
+#include "gsm_bursts.h"
+#include "mtsc.h"
+
+
+/*
+ * Given a training sequence code, this function generates a modulated version
+ * suitable for correlating against incoming signals.
+ *
+ * 	sps		samples per symbol
+ * 	tsc		training sequence in bits
+ *	tsc_len		number of bits in training sequence
+ *	tsc_offset	offset from start of burst to tsc
+ *	toa		time of arrival -- index of peak in correlation (samples)
+ *	gain		value of peak in correlation -- used in channel response
+ *	mtsc_len	length of modulated traning sequence
+ *
+ *	returns		modulated training sequence
+ */
+complex *generate_modulated_tsc(const float sps, const unsigned char *tsc,
+   const unsigned int tsc_len, const unsigned int tsc_offset,
+   float *toa_o, complex *gain_o, unsigned int *mtsc_len_o) {
+
+	unsigned int mtsc_len;
+	float toa;
+	complex *mtsc, gain;
+
+	// modulate tsc
+	if(!(mtsc = modulate(tsc, tsc_len, 0, sps, &mtsc_len)))
+		return 0;
+
+	// rotate to match transmit in actual burst
+	scale(mtsc, mtsc_len, exp(complex(0, (M_PI / 2.0) * (tsc_offset % 4))));
+
+	toa = (((float)tsc_len / 2.0) + tsc_offset) * sps;
+	gain = complex(tsc_len * sps, 0);
+
+	if(toa_o)
+		*toa_o = toa;
+	if(gain_o)
+		*gain_o = gain;
+	if(mtsc_len_o)
+		*mtsc_len_o = mtsc_len;
+	return mtsc;
+}
+
+
+int generate_modulated_tsc(const float sps, const unsigned char *tsc,
+   const unsigned int tsc_len, const unsigned int tsc_offset, mtsc_s **mtsc) {
+
+	mtsc_s *m;
+
+	if(!mtsc) {
+		fprintf(stderr, "error: generate_modulated_tsc: no space for mtsc given\n");
+		return -1;
+	}
+	if(!*mtsc) {
+		*mtsc = new mtsc_s;
+		if(!*mtsc) {
+			fprintf(stderr, "error: generate_modulated_tsc: new failed\n");
+			return -1;
+		}
+	}
+	m = *mtsc;
+	m->tsc = generate_modulated_tsc(sps, tsc, tsc_len, tsc_offset, &m->toa, &m->gain, &m->len);
+	if(!m->tsc) {
+		delete m;
+		*mtsc = 0;
+		return -1;
+	}
+	m->bits = tsc;
+	m->bits_len = tsc_len;
+	m->os = tsc_offset;
+
+	return 0;
+}
+
+
+void delete_mtsc(mtsc_s *m) {
+
+	if(!m)
+		return;
+	delete[] m->tsc;
+	delete m;
+}
+
+
+/*
+ * The known bits of a reference sequence and their offset into the burst.
+ *
+ * 	returns	0 if there is such a sequence
+ */
+int mtsc_sequence(const int type, const unsigned int index,
+   const unsigned char **bits_o, unsigned int *len_o, unsigned int *os_o) {
+
+	switch(type) {
+		case MTSC_NB:
+			if(index >= (unsigned int)N_TSC_NUM)
+				return -1;
+			*bits_o = n_tsc[index];
+			*len_o = N_TSC_CODE_LEN;
+			*os_o = N_TSC_OS;
+			return 0;
+
+		case MTSC_SB:
+			*bits_o = sb_etsc;
+			*len_o = SB_CODE_LEN;
+			*os_o = SB_ETS_OS;
+			break;
+
+		case MTSC_DUMMY:
+			*bits_o = d_mb;
+			*len_o = D_CODE_LEN;
+			*os_o = D_MB_OS;
+			break;
+
+		case MTSC_FB:
+			*bits_o = fc_fb;
+			*len_o = FC_CODE_LEN;
+			*os_o = FC_OS;
+			break;
+
+		default:
+			return -1;
+	}
+
+	return (index == 0)? 0 : -1;
+}
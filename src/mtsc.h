@@ -0,0 +1,38 @@
+#pragma once
+#include "usrp_complex.h"
+
+enum {
+	MTSC_NB,		// normal burst, index is the training sequence code
+	MTSC_SB,		// synchronization burst
+	MTSC_DUMMY,		// dummy burst
+	MTSC_FB			// frequency burst
+};
+
+typedef struct {
+	const complex *	tsc;		// modulated training sequence code
+	unsigned int	len;		// length of modulated tsc
+	float		toa;		// time of arrival for midamble into tsc
+	complex		gain;		// peak of correlation between midamble and tsc
+	const unsigned char *	bits;	// training sequence code
+	unsigned int	bits_len;
+	unsigned int	os;		// offset from start of burst to tsc (symbols)
+} mtsc_s;
+
+
+complex *generate_modulated_tsc(const float sps, const unsigned char *tsc,
+   const unsigned int tsc_len, const unsigned int tsc_offset,
+   float *toa_o, complex *gain_o, unsigned int *mtsc_len_o);
+
+int generate_modulated_tsc(const float sps, const unsigned char *tsc,
+   const unsigned int tsc_len, const unsigned int tsc_offset, mtsc_s **mtsc);
+
+void delete_mtsc(mtsc_s *m);
+
+int mtsc_sequence(const int type, const unsigned int index,
+   const unsigned char **bits_o, unsigned int *len_o, unsigned int *os_o);
+
+const mtsc_s *get_mtsc(const int type, const unsigned int index,
+   const float sps);
+
+const complex *get_ls_pinv(const mtsc_s *m, const unsigned int L,
+   unsigned int *rows_o);
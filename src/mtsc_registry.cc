@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <pthread.h>
+
+#include "dsp.h"
+#include "mtsc.h"
+#include "mtsc_registry.h"
+
+
+typedef struct mtsc_cache_s {
+	mtsc_table_s		e;
+	struct mtsc_cache_s *	next;
+} mtsc_cache_s;
+
+typedef struct ls_cache_s {
+	const unsigned char *	bits;
+	unsigned int		bits_len;
+	unsigned int		os;
+	unsigned int		L;
+	complex *		P;
+	unsigned int		rows;
+	struct ls_cache_s *	next;
+} ls_cache_s;
+
+static pthread_mutex_t	m_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mtsc_cache_s *	m_cache = 0;
+static ls_cache_s *	m_ls_cache = 0;
+
+
+/*
+ * get_mtsc
+ *
+ * The modulated reference sequence of the given type for sps samples per
+ * symbol.  For the sample rates in mtsc_tables this is the build time table,
+ * anything else is modulated on first use and kept.
+ *
+ * Either way the sequence is never freed or changed, so it can be shared
+ * between threads and must not be passed to delete_mtsc.
+ *
+ * 	index	training sequence code for MTSC_NB, otherwise 0
+ */
+const mtsc_s *get_mtsc(const int type, const unsigned int index,
+   const float sps) {
+
+	unsigned int i, len, os;
+	const unsigned char *bits;
+	mtsc_s *m = 0;
+	mtsc_cache_s *c;
+
+	for(i = 0; i < mtsc_tables_len; i++) {
+		if((mtsc_tables[i].type == type) && (mtsc_tables[i].index == index) && (mtsc_tables[i].sps == sps))
+			return &mtsc_tables[i].m;
+	}
+
+	if(mtsc_sequence(type, index, &bits, &len, &os)) {
+		fprintf(stderr, "error: get_mtsc: no sequence %d/%u\n", type, index);
+		return 0;
+	}
+
+	pthread_mutex_lock(&m_cache_mutex);
+	for(c = m_cache; c; c = c->next) {
+		if((c->e.type == type) && (c->e.index == index) && (c->e.sps == sps))
+			break;
+	}
+	if(!c && !generate_modulated_tsc(sps, bits, len, os, &m)) {
+		c = new mtsc_cache_s;
+		c->e.type = type;
+		c->e.index = index;
+		c->e.sps = sps;
+		c->e.m = *m;
+		c->next = m_cache;
+		m_cache = c;
+		delete m;
+	}
+	pthread_mutex_unlock(&m_cache_mutex);
+
+	return c? &c->e.m : 0;
+}
+
+
+/*
+ * get_ls_pinv
+ *
+ * The least squares pseudo-inverse (see ls_pseudo_inverse) for an L tap
+ * channel over the whole training sequence of m.  It is computed on first use
+ * and, like the sequences themselves, never freed or changed.
+ */
+const complex *get_ls_pinv(const mtsc_s *m, const unsigned int L,
+   unsigned int *rows_o) {
+
+	unsigned int rows;
+	complex *P;
+	ls_cache_s *c;
+
+	if(!m->bits)
+		return 0;
+
+	pthread_mutex_lock(&m_cache_mutex);
+	for(c = m_ls_cache; c; c = c->next) {
+		if((c->bits == m->bits) && (c->bits_len == m->bits_len) && (c->os == m->os) && (c->L == L))
+			break;
+	}
+	if(!c && (P = ls_pseudo_inverse(m->bits, m->bits_len, m->os, L, &rows))) {
+		c = new ls_cache_s;
+		c->bits = m->bits;
+		c->bits_len = m->bits_len;
+		c->os = m->os;
+		c->L = L;
+		c->P = P;
+		c->rows = rows;
+		c->next = m_ls_cache;
+		m_ls_cache = c;
+	}
+	pthread_mutex_unlock(&m_cache_mutex);
+
+	if(!c)
+		return 0;
+	if(rows_o)
+		*rows_o = c->rows;
+	return c->P;
+}
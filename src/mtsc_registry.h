@@ -0,0 +1,16 @@
+#pragma once
+#include "mtsc.h"
+
+/*
+ * Modulated reference sequences for common sample rates.  The table is
+ * generated when building by gen_mtsc_tables.
+ */
+typedef struct {
+	int		type;
+	unsigned int	index;
+	float		sps;
+	mtsc_s		m;
+} mtsc_table_s;
+
+extern const mtsc_table_s	mtsc_tables[];
+extern const unsigned int	mtsc_tables_len;
@@ -0,0 +1,105 @@
+#include <math.h>
+
+#include "nco.h"
+
+
+complex *nco::m_lut = 0;
+
+
+nco::nco(const double sample_rate) {
+
+	if(!m_lut)
+		build_lut();
+
+	m_sample_rate = sample_rate;
+	m_freq = 0.0;
+	m_phase = 0;
+	m_step = 0;
+}
+
+
+void nco::build_lut() {
+
+	unsigned int i;
+
+	m_lut = new complex[LUT_LEN];
+	for(i = 0; i < LUT_LEN; i++)
+		m_lut[i] = exp(complex(0, -2.0 * M_PI * i / LUT_LEN));
+}
+
+
+static uint32_t freq_to_step(const double freq, const double sample_rate) {
+
+	return (uint32_t)(int64_t)llrint(freq / sample_rate * 4294967296.0);
+}
+
+
+void nco::set_sample_rate(const double sample_rate) {
+
+	m_sample_rate = sample_rate;
+	m_step = freq_to_step(m_freq, m_sample_rate);
+}
+
+
+/*
+ * Frequency (Hz) to remove from the samples passed to mix.
+ */
+void nco::set_freq(const double freq) {
+
+	m_freq = freq;
+	m_step = freq_to_step(m_freq, m_sample_rate);
+}
+
+
+void nco::adjust(const double offset) {
+
+	set_freq(m_freq + offset);
+}
+
+
+double nco::freq() {
+
+	return m_freq;
+}
+
+
+/*
+ * Multiply v by the table entries for phase, phase + step, ... and return the
+ * phase after the last sample.
+ */
+uint32_t nco::rotate(complex *v, const unsigned int len, uint32_t phase, const uint32_t step) {
+
+	unsigned int i;
+
+	for(i = 0; i < len; i++) {
+		v[i] *= m_lut[phase >> (32 - LUT_BITS)];
+		phase += step;
+	}
+
+	return phase;
+}
+
+
+/*
+ * Derotate the next len samples of the stream in place.
+ */
+void nco::mix(complex *v, const unsigned int len) {
+
+	if(!m_step && !m_phase)
+		return;
+	m_phase = rotate(v, len, m_phase, m_step);
+}
+
+
+/*
+ * Remove an additional offset from the len samples that were mixed last (v
+ * ends at the current phase).  The correction is zero at the current phase
+ * so, after adjust(offset), the samples that follow line up with these.
+ */
+void nco::mix_back(complex *v, const unsigned int len, const double offset) {
+
+	uint32_t step;
+
+	step = freq_to_step(offset, m_sample_rate);
+	rotate(v, len, (uint32_t)(0 - step * len), step);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "usrp_complex.h"
+
+/*
+ * nco
+ *
+ * Numerically controlled oscillator used to take a known frequency offset out
+ * of the sample stream.
+ *
+ * The phase is a 32-bit accumulator that wraps for free; the top LUT_BITS of
+ * it index a table of exp(-j * phase).  Changing the frequency keeps the phase
+ * continuous.
+ */
+class nco {
+public:
+	nco(const double sample_rate = 1.0);
+
+	void set_sample_rate(const double sample_rate);
+	void set_freq(const double freq);
+	void adjust(const double offset);
+	double freq();
+
+	void mix(complex *v, const unsigned int len);
+	void mix_back(complex *v, const unsigned int len, const double offset);
+
+private:
+	static uint32_t rotate(complex *v, const unsigned int len, uint32_t phase, const uint32_t step);
+	static void build_lut();
+
+	static const unsigned int	LUT_BITS	= 12;
+	static const unsigned int	LUT_LEN		= (1 << LUT_BITS);
+
+	static complex *		m_lut;
+
+	double		m_sample_rate;
+	double		m_freq;
+	uint32_t	m_phase;
+	uint32_t	m_step;
+};
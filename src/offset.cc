@@ -28,29 +28,68 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <stdexcept>
 
 #include "usrp_source.h"
 #include "circular_buffer.h"
 #include "fcch_detector.h"
+#include "offset.h"
 #include "arfcn_freq.h"
 #include "util.h"
 #include "gsm.h"
 #include "dsp.h"
+#include "scan_pipeline.h"
+#include "channelizer.h"
+#include "power_scan.h"
+#include "cell_db.h"
+#include "offset_stats.h"
 
 
 static const unsigned int	AVG_COUNT		= 100;
-static const unsigned int	AVG_THRESHOLD		= (AVG_COUNT / 10);
+static const unsigned int	MIN_COUNT		= 10;	// bursts before stopping early
 static const float		ERROR_DETECT_OFFSET_MAX	= 40e3;
 static const unsigned int	NOTFOUND_MAX		= 10;
+static const double		CHAN_SPACING		= 200e3;
+static const unsigned int	WIDE_MIN_CHANS		= 8;
+static const float		WIDE_USE		= 0.8;	// of each capture
+static const unsigned int	MIN_TRIES		= 2;	// captures of a strong channel
 
 
-int offset_detect(usrp_source *u, fcch_detector *l, float *p_avg_offset, float *p_min, float *p_max, float *p_stddev) {
+typedef struct {
+	int		arfcn;
+	double		power;
+	unsigned int	tries;		// captures left
+} scan_cand_s;
 
-	int r = -1, l_in = 1;
-	unsigned int s_len, b_len, consumed, count, new_overruns = 0, overruns = 0, notfound_count = 0;
-	float offset = 0.0, min = 0.0, max = 0.0, avg_offset = 0.0, stddev = 0.0, sps, offsets[AVG_COUNT];
+
+/*
+ * offset_detect
+ *
+ * Measure the frequency offset of the carrier the source is tuned to from its
+ * frequency bursts.  The bursts come every 10 or 11 frames and are followed
+ * in one stream: once a burst is found, the samples up to where the next one
+ * can start are skipped and only the next frame and a bit are searched.  If
+ * that misses, the search goes back to 12 frames at a time.
+ *
+ * Measuring stops once the 95% confidence interval of the offset is within
+ * tolerance Hz, after AVG_COUNT bursts or after NOTFOUND_MAX misses in a row.
+ *
+ * 	p_avg_offset	mean offset, leaving out outliers
+ * 	p_min, p_max	10th and 90th percentiles of the offsets
+ * 	p_stddev	standard deviation of the offsets, leaving out outliers
+ */
+int offset_detect(usrp_source *u, fcch_detector *l, float *p_avg_offset,
+   float *p_min, float *p_max, float *p_stddev, const float tolerance) {
+
+	int r = -1, l_in = 1, following = 0;
+	unsigned int s_len, skip_len, next_len, len, b_len, consumed, new_overruns = 0, overruns = 0, notfound_count = 0;
+	float offset = 0.0, sps;
 	complex *cbuf;
 	circular_buffer *cb;
+	offset_stats *stats;
 
 	if(!l) {
 		l_in = 0;
@@ -60,48 +99,53 @@ int offset_detect(usrp_source *u, fcch_detector *l, float *p_avg_offset, float *
 			return -1;
 		}
 	}
+	stats = new offset_stats(AVG_COUNT);
 
 	/*
 	 * We deliberately grab 12 frames and 1 burst.  We are guaranteed to
-	 * find at least one FCCH burst in this much data.
+	 * find at least one FCCH burst in this much data.  After a burst, the
+	 * next one starts 10 or 11 frames after it.
 	 */
 	sps = u->sample_rate() / GSM_RATE;
 	s_len = (unsigned int)ceil((12 * FRAME_LEN + BURST_LEN) * sps);
+	skip_len = (unsigned int)floor((10 * FRAME_LEN - 3 * BURST_LEN) * sps);
+	next_len = (unsigned int)ceil((FRAME_LEN + 4 * BURST_LEN) * sps);
 	cb = u->get_buffer();
 
-	count = 0;
-	while(count < AVG_COUNT) {
+	u->flush();
+	while(stats->count() < AVG_COUNT) {
 
-		// ensure at least s_len contiguous samples are read from usrp
-		do {
-			u->flush();
-			if(u->fill(s_len, &new_overruns)) {
-				goto jump_leaving;
-			}
-			if(new_overruns) {
-				overruns += new_overruns;
-			}
-		} while(new_overruns);
+		// gaps don't matter, every burst is measured on its own
+		len = following? skip_len + next_len : s_len;
+		if(u->fill(len, &new_overruns))
+			goto jump_leaving;
+		overruns += new_overruns;
+
+		if(following)
+			cb->purge(skip_len);
 
 		// get a pointer to the next samples
 		cbuf = (complex *)cb->peek(&b_len);
+		len = following? next_len : b_len;
 
 		// search the buffer for a pure tone
-		if(l->scan(cbuf, b_len, &offset, &consumed)) {
+		if(l->scan(cbuf, len, &offset, &consumed)) {
 
 			// FCH is a sine wave at GSM_RATE / 4
 			offset = offset - FCCH_FREQ;
 
 			// sanity check offset
 			if(fabs(offset) < ERROR_DETECT_OFFSET_MAX) {
-				offsets[count] = offset;
-				count += 1;
+				stats->add(offset);
 				notfound_count = 0;
+				following = 1;
 			} else {
 				notfound_count += 1;
+				following = 0;
 			}
 		} else {
 			notfound_count += 1;
+			following = 0;
 		}
 
 		// consume used samples
@@ -109,178 +153,458 @@ int offset_detect(usrp_source *u, fcch_detector *l, float *p_avg_offset, float *
 
 		if(notfound_count >= NOTFOUND_MAX)
 			goto jump_leaving;
+
+		if((stats->inliers() >= MIN_COUNT) && (stats->interval() < tolerance))
+			break;
 	}
 	r = 0;
 
+	if(p_avg_offset)
+		*p_avg_offset = stats->mean();
+	if(p_min)
+		*p_min = stats->quantile(0.1);
+	if(p_max)
+		*p_max = stats->quantile(0.9);
+	if(p_stddev)
+		*p_stddev = stats->stddev();
+
 jump_leaving:
+	delete stats;
 	if(!l_in) {
 		delete l;
 	}
 
-	if(!r) {
-		// construct stats
-		sort(offsets, AVG_COUNT);
-		avg_offset = avg(offsets + AVG_THRESHOLD, AVG_COUNT - 2 * AVG_THRESHOLD, &stddev);
-		min = offsets[AVG_THRESHOLD];
-		max = offsets[AVG_COUNT - AVG_THRESHOLD - 1];
-
-		if(p_avg_offset)
-			*p_avg_offset = avg_offset;
-		if(p_min)
-			*p_min = min;
-		if(p_max)
-			*p_max = max;
-		if(p_stddev)
-			*p_stddev = stddev;
-	}
-
 	return r;
 }
 
 
-int c0_detect(usrp_source *u, int bi, int strict) {
+/*
+ * A channelizer for the source's sample rate if it spans at least
+ * WIDE_MIN_CHANS channels, otherwise 0.
+ */
+static channelizer *wide_channelizer(usrp_source *u, const unsigned int frames_len) {
+
+	unsigned int n_chans;
+	double fs = u->sample_rate();
+	channelizer *ch;
+
+	n_chans = (unsigned int)round(fs / CHAN_SPACING);
+	if((n_chans < WIDE_MIN_CHANS) || (fabs(fs - n_chans * CHAN_SPACING) > 1.0))
+		return 0;
+	try {
+		ch = new channelizer(fs, n_chans);
+	} catch(std::runtime_error &e) {
+		return 0;
+	}
 
-	int i, chan_count, ret = -1;
-	unsigned int overruns, b_len, frames_len, found_count, notfound_count, r;
-	float offset, spower[BUFSIZ], min, max, stddev;
-	double freq, sps, n, power[BUFSIZ], sum = 0, a;
-	complex *b;
-	circular_buffer *ub;
-	fcch_detector *l;
+	// a capture must fit in the source's buffer
+	if(ceil((frames_len + 128) * fs / ch->output_rate()) > u->get_buffer()->buf_len()) {
+		delete ch;
+		return 0;
+	}
+	return ch;
+}
 
 
-	if(bi == BI_NOT_DEFINED) {
-		fprintf(stderr, "error: c0_detect: band not defined\n");
-		return -1;
-	}
-	/*
-	if(u->tune_if(band_center(bi))) {
-		fprintf(stderr, "error: usrp_source::tune_if\n");
-		return -1;
-	}
-	 */
+/*
+ * Capture every channel of the band with want[chan] set and queue it for the
+ * given stages.
+ *
+ * Without a channelizer each channel is tuned and captured on its own.  With
+ * one, each capture is centred WIDE_USE / 2 of its width above the lowest
+ * channel still wanted and every wanted channel within that distance of the
+ * centre is taken from it.
+ */
+static int scan_pass(usrp_source *u, channelizer *ch, scan_pipeline *pipe,
+   const unsigned int frames_len, int bi, const int stages, int *want,
+   scan_result_s *res, unsigned int *n_o) {
 
-	l = new fcch_detector(u->sample_rate());
-	if(!l) {
-		fprintf(stderr, "error: new\n");
-		return -1;
+	int i, j, k, cbi;
+	unsigned int n = 0, r, len, b_len, overruns;
+	double freq, centre, half;
+	complex *b;
+	circular_buffer *ub, *cb;
+
+	if(!ch) {
+		for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+			if(!want[i])
+				continue;
+			cbi = bi;
+			freq = arfcn_to_freq(i, &cbi);
+			if(pipe->submit(u, freq, stages, &res[i]))
+				return -1;
+			n += 1;
+		}
+		if(n_o)
+			*n_o = n;
+		return 0;
 	}
 
-	sps = u->sample_rate() / GSM_RATE;
-	frames_len = (unsigned int)ceil((12 * FRAME_LEN + BURST_LEN) * sps);
 	ub = u->get_buffer();
+	r = (unsigned int)(WIDE_USE * ch->n_chans() / 2);
+	half = r * ch->spacing() + 1.0;
+	len = (unsigned int)ceil((frames_len + 128) * u->sample_rate() / ch->output_rate());
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+		if(!want[i])
+			continue;
 
-	// first, we calculate the power in each channel
-	// XXX should filter to 200kHz
-	u->start();
-	u->flush();
-	for(i = first_chan(bi); i > 0; i = next_chan(i, bi)) {
-		freq = arfcn_to_freq(i, &bi);
-		/*
-		if(u->fast_tune(freq)) {
-			fprintf(stderr, "error: usrp_source::fast_tune\n");
-			goto jump_leaving;
+		cbi = bi;
+		centre = arfcn_to_freq(i, &cbi) + r * ch->spacing();
+		ch->reset();
+		for(k = 0; k < (int)ch->n_chans(); k++)
+			ch->enable(k, 0);
+		for(j = first_chan(bi); j >= 0; j = next_chan(j, bi)) {
+			if(!want[j])
+				continue;
+			cbi = bi;
+			freq = arfcn_to_freq(j, &cbi);
+			if(fabs(freq - centre) < half)
+				ch->enable(ch->chan(freq - centre));
 		}
-		 */
 
-		if(u->tune(freq)) {
-			fprintf(stderr, "error: usrp_source::fast_tune\n");
-			goto jump_leaving;
+		if(u->tune(centre)) {
+			fprintf(stderr, "error: usrp_source::tune\n");
+			return -1;
 		}
 		do {
 			u->flush();
-			if(u->fill(frames_len, &overruns)) {
+			if(u->fill(len, &overruns)) {
 				fprintf(stderr, "error: usrp_source::fill\n");
-				goto jump_leaving;
+				return -1;
 			}
 		} while(overruns);
-
 		b = (complex *)ub->peek(&b_len);
-		n = sqrt(vectornorm2(b, frames_len));
-		power[i] = n;
+		ch->process(b, len);
+		ub->purge(len);
+
+		for(j = first_chan(bi); j >= 0; j = next_chan(j, bi)) {
+			cbi = bi;
+			freq = arfcn_to_freq(j, &cbi);
+			if((!want[j]) || (fabs(freq - centre) >= half))
+				continue;
+			cb = ch->get_buffer(ch->chan(freq - centre));
+			b = (complex *)cb->peek(&b_len);
+			if(pipe->submit(b, b_len, stages, &res[j]))
+				return -1;
+			want[j] = 0;
+			n += 1;
+		}
 	}
 
-	/*
-	 * We want to use the average to determine which channels have
-	 * power, and hence a possibility of being channel 0 on a BTS.
-	 * However, some channels in the band can be extremely noisy.  (E.g.,
-	 * CDMA traffic in GSM-850.)  Hence we won't consider the noisiest
-	 * channels when we construct the average.
-	 */
-	chan_count = 0;
-	for(i = first_chan(bi); i > 0; i = next_chan(i, bi)) {
-		spower[chan_count++] = power[i];
-	}
-	sort(spower, chan_count);
+	if(n_o)
+		*n_o = n;
+	return 0;
+}
 
-	// average the lowest %60
-	a = avg(spower, chan_count - 4 * chan_count / 10, 0);
 
-	// then we look for fcch bursts
-	printf("%s:\n", bi_to_str(bi));
-	found_count = 0;
-	notfound_count = 0;
-	sum = 0;
-	i = first_chan(bi);
-	do {
-		if(power[i] <= a) {
-			i = next_chan(i, bi);
+/*
+ * Order the candidates of a band, strongest first, and give each a number of
+ * captures to spend on it.  A carrier well above the noise shows its
+ * frequency burst in the first capture if it has one, so the stronger a
+ * channel the fewer captures it gets before we give up on it.
+ *
+ * 	noise	rms of an empty channel, 0 for cells known from earlier runs,
+ * 		which get MIN_TRIES each
+ *
+ * 	returns	the number of candidates
+ */
+static unsigned int rank_chans(int bi, const int *cand, const scan_result_s *res,
+   const double noise, scan_cand_s *c) {
+
+	int i;
+	unsigned int n = 0, j;
+	double snr;
+	scan_cand_s t;
+
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+		if(!cand[i])
 			continue;
+		c[n].arfcn = i;
+		c[n].power = res[i].power;
+		c[n].tries = NOTFOUND_MAX;
+		if(noise <= 0.0)
+			c[n].tries = MIN_TRIES;
+		else {
+			snr = (res[i].power * res[i].power) / (noise * noise);
+			if(snr * MIN_TRIES > NOTFOUND_MAX)
+				c[n].tries = MIN_TRIES;
+			else if(snr > 1.0)
+				c[n].tries = (unsigned int)ceil(NOTFOUND_MAX / snr);
 		}
 
-		freq = arfcn_to_freq(i, &bi);
-		/*
-		if(u->fast_tune(freq)) {
-			fprintf(stderr, "error: usrp_source::fast_tune\n");
-			goto jump_leaving;
+		// insertion keeps them sorted
+		for(j = n++; (j > 0) && (c[j - 1].power < c[j].power); j--) {
+			t = c[j];
+			c[j] = c[j - 1];
+			c[j - 1] = t;
+		}
+	}
+
+	return n;
+}
+
+
+/*
+ * Capture the strongest wave_len candidates that still have tries left and
+ * wait for the results.  A channel is done once its frequency burst is found
+ * or it runs out of tries.
+ *
+ * 	found	the channels found in this wave
+ *
+ * 	returns	the number of channels searched, 0 once every channel is done
+ * 		and -1 on error
+ */
+static int fcch_wave(usrp_source *u, channelizer *ch, scan_pipeline *pipe,
+   const unsigned int frames_len, int bi, scan_cand_s *c, const unsigned int c_len,
+   const unsigned int wave_len, scan_result_s *res, int *want, int *found,
+   unsigned int *n_found) {
+
+	int i;
+	unsigned int j, n = 0;
+
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi))
+		want[i] = 0;
+	for(j = 0; (j < c_len) && (n < wave_len); j++) {
+		if(!c[j].tries)
+			continue;
+		want[c[j].arfcn] = 1;
+		n += 1;
+	}
+	if(!n)
+		return 0;
+
+	if(scan_pass(u, ch, pipe, frames_len, bi, SCAN_FCCH, want, res, 0))
+		return -1;
+	pipe->drain();
+
+	*n_found = 0;
+	for(j = 0, n = 0; (j < c_len) && (n < wave_len); j++) {
+		if(!c[j].tries)
+			continue;
+		n += 1;
+		i = c[j].arfcn;
+		if(res[i].found && (fabsf(res[i].offset) < ERROR_DETECT_OFFSET_MAX)) {
+			c[j].tries = 0;
+			found[(*n_found)++] = i;
+		} else {
+			c[j].tries -= 1;
 		}
-		 */
+	}
+
+	return n;
+}
+
+
+static double elapsed(const struct timeval *start) {
+
+	struct timeval now;
+
+	gettimeofday(&now, 0);
+	return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+
+/*
+ * Print a carrier that was found and note it in the database.
+ *
+ * 	ppm	offsets of the carriers so far, as parts per million
+ */
+static int report_chan(usrp_source *u, int bi, const int i, const int strict,
+   const scan_result_s *r, cell_db *db, float *ppm, unsigned int *n_ppm) {
+
+	int cbi = bi;
+	float offset, min, max, stddev;
+	double freq;
+	cell_s *c;
+
+	freq = arfcn_to_freq(i, &cbi);
+	offset = r->offset;
+	if(strict) {
 		if(u->tune(freq)) {
-			fprintf(stderr, "error: usrp_source::fast_tune\n");
-			goto jump_leaving;
+			fprintf(stderr, "error: usrp_source::tune\n");
+			return -1;
 		}
+		if(offset_detect(u, 0, &offset, &min, &max, &stddev))
+			return 0;
+		printf("\tchan: %d (%.1fMHz ", i, freq / 1e6);
+		display_freq(offset);
+		printf(")\tpower: %6.2lf\t[min, max, range]: [%d, %d, %d]\tstddev: %f\n", r->power, (int)round(min), (int)round(max), (int)round(max - min), stddev);
+	} else {
+		printf("\tchan: %d (%.1fMHz ", i, freq / 1e6);
+		display_freq(offset);
+		printf(")\tpower: %6.2lf\n", r->power);
+	}
+	fflush(stdout);
 
-		do {
-			u->flush();
-			if(u->fill(frames_len, &overruns)) {
-				fprintf(stderr, "error: usrp_source::fill\n");
-				goto jump_leaving;
-			}
-		} while(overruns);
+	if(db && (c = db->update(bi, i))) {
+		c->power = r->power;
+		c->offset = offset;
+		c->last_seen = time(0);
+	}
+	ppm[(*n_ppm)++] = offset / freq * 1e6;
 
-		b = (complex *)ub->peek(&b_len);
-		r = l->scan(b, b_len, &offset, 0);
-		offset -= FCCH_FREQ;
-		if(r && (fabsf(offset) < ERROR_DETECT_OFFSET_MAX)) {
-			// found
-			if(strict) {
-				if(!offset_detect(u, l, &offset, &min, &max, &stddev)) {
-					printf("\tchan: %d (%.1fMHz ", i, freq / 1e6);
-					display_freq(offset);
-					printf(")\tpower: %6.2lf\t[min, max, range]: [%d, %d, %d]\tstddev: %f\n", power[i], (int)round(min), (int)round(max), (int)round(max - min), stddev);
-				}
-			} else {
-				printf("\tchan: %d (%.1fMHz ", i, freq / 1e6);
-				display_freq(offset);
-				printf(")\tpower: %6.2lf\n", power[i]);
+	return 0;
+}
+
+
+/*
+ * c0_detect
+ *
+ * Look for the C0 carriers in a band.  The power of every channel is measured
+ * first (band_power_scan); channels with more than the average power of the
+ * quietest 60% are then searched for a frequency burst.  The strongest are
+ * searched first, a few at a time, and each carrier is printed as soon as it
+ * is found.  Channels well above the noise get fewer captures than
+ * NOTFOUND_MAX before we give up on them.  The captures go through a
+ * scan_pipeline so the radio is tuning and capturing the next channel while
+ * workers analyze the previous ones.
+ *
+ * If the source's sample rate spans several channels, each capture is split
+ * with a channelizer and covers a few dozen channels at once.  Offsets are
+ * then those of the first look at each channel, even when strict.
+ *
+ * With a cell database, the cells it knows in the band are looked for first,
+ * MIN_TRIES captures each, and the band is only swept if none of them is
+ * found.  The carriers found and the clock error they imply are saved in it.
+ *
+ * 	strict		measure the offset of each carrier found (offset_detect)
+ * 	n_threads	analysis threads
+ * 	db		cell database, or 0
+ * 	max_time	seconds after which no more channels are searched, 0 for
+ * 			no limit
+ */
+int c0_detect(usrp_source *u, int bi, int strict, const unsigned int n_threads,
+   cell_db *db, const double max_time) {
+
+	int i, r, phase, chan_count, ret = -1, *cand, *want, *found;
+	unsigned int frames_len, wave_len, c_len, j, n_found, n = 0;
+	float spower[BUFSIZ], ppm[BUFSIZ];
+	double sps, a, *power;
+	struct timeval start;
+	scan_result_s *res;
+	scan_cand_s *c;
+	scan_pipeline *pipe;
+	channelizer *ch;
+	cell_s *cell;
+
+	if(bi == BI_NOT_DEFINED) {
+		fprintf(stderr, "error: c0_detect: band not defined\n");
+		return -1;
+	}
+	gettimeofday(&start, 0);
+
+	frames_len = (unsigned int)ceil(12 * FRAME_LEN + BURST_LEN);
+	if((ch = wide_channelizer(u, frames_len))) {
+		if(strict) {
+			fprintf(stderr, "c0_detect: wideband scan, offsets are not refined\n");
+			strict = 0;
+		}
+	} else {
+		sps = u->sample_rate() / GSM_RATE;
+		frames_len = (unsigned int)ceil((12 * FRAME_LEN + BURST_LEN) * sps);
+	}
+
+	// enough channels per wave to keep every worker busy
+	if(ch)
+		wave_len = (unsigned int)(WIDE_USE * ch->n_chans());
+	else
+		wave_len = 2 * (n_threads? n_threads : 1);
+
+	try {
+		pipe = new scan_pipeline(n_threads, ch? ch->output_rate() : u->sample_rate(), frames_len);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		delete ch;
+		return -1;
+	}
+	res = new scan_result_s[BUFSIZ];
+	memset(res, 0, BUFSIZ * sizeof(*res));
+	cand = new int[BUFSIZ];
+	want = new int[BUFSIZ];
+	found = new int[BUFSIZ];
+	power = new double[BUFSIZ];
+	c = new scan_cand_s[BUFSIZ];
+
+	u->start();
+	u->flush();
+
+	printf("%s:\n", bi_to_str(bi));
+	fflush(stdout);
+
+	/*
+	 * Cells found on earlier runs are checked first.  The band is only
+	 * swept if none of them is there.
+	 */
+	for(phase = db? 0 : 1; (phase < 2) && (!n); phase++) {
+		if(phase == 0) {
+			for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+				if((cand[i] = (cell = db->find(bi, i))? 1 : 0))
+					res[i].power = cell->power;
 			}
-			notfound_count = 0;
-			i = next_chan(i, bi);
+			c_len = rank_chans(bi, cand, res, 0.0, c);
 		} else {
-			// not found
-			notfound_count += 1;
-			if(notfound_count >= NOTFOUND_MAX) {
-				notfound_count = 0;
-				i = next_chan(i, bi);
+			if(max_time && (elapsed(&start) >= max_time))
+				break;
+
+			// we calculate the power in each channel
+			if(band_power_scan(u, bi, power))
+				goto jump_leaving;
+
+			/*
+			 * We want to use the average to determine which channels
+			 * have power, and hence a possibility of being channel 0
+			 * on a BTS.  However, some channels in the band can be
+			 * extremely noisy.  (E.g., CDMA traffic in GSM-850.)
+			 * Hence we won't consider the noisiest channels when we
+			 * construct the average.
+			 */
+			chan_count = 0;
+			for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+				res[i].power = power[i];
+				spower[chan_count++] = power[i];
 			}
+			sort(spower, chan_count);
+
+			// average the lowest %60
+			a = avg(spower, chan_count - 4 * chan_count / 10, 0);
+
+			// then we look for fcch bursts where there is power
+			for(i = first_chan(bi); i >= 0; i = next_chan(i, bi))
+				cand[i] = (res[i].power > a);
+			c_len = rank_chans(bi, cand, res, a, c);
 		}
-	} while(i > 0);
+
+		while((!max_time) || (elapsed(&start) < max_time)) {
+			if((r = fcch_wave(u, ch, pipe, frames_len, bi, c, c_len, wave_len, res, want, found, &n_found)) < 0)
+				goto jump_leaving;
+			if(!r)
+				break;
+			for(j = 0; j < n_found; j++)
+				if(report_chan(u, bi, found[j], strict, &res[found[j]], db, ppm, &n))
+					goto jump_leaving;
+		}
+	}
+
+	// base stations' clocks are far better than ours, so the carriers'
+	// offsets are our clock error; the median ignores a stray detection
+	if(db && n) {
+		sort(ppm, n);
+		db->set_clock_error((n & 1)? ppm[n / 2] : (ppm[n / 2 - 1] + ppm[n / 2]) / 2);
+		db->save();
+	}
 
 	ret = 0;
 jump_leaving:
 
 	u->stop();
-	delete l;
+	delete pipe;
+	delete ch;
+	delete[] c;
+	delete[] power;
+	delete[] found;
+	delete[] want;
+	delete[] cand;
+	delete[] res;
 
 	return ret;
 }
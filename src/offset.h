@@ -25,5 +25,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-int offset_detect(usrp_source *u, fcch_detector *l, float *p_avg_offset, float *p_min, float *p_max, float *p_stddev);
-int c0_detect(usrp_source *u, int bi, int strict);
+class cell_db;
+
+// tolerance is the 95% confidence interval (Hz) to stop at
+int offset_detect(usrp_source *u, fcch_detector *l, float *p_avg_offset, float *p_min, float *p_max, float *p_stddev, const float tolerance = 10.0);
+int c0_detect(usrp_source *u, int bi, int strict, const unsigned int n_threads = 2, cell_db *db = 0, const double max_time = 0.0);
@@ -0,0 +1,168 @@
+#include <math.h>
+#include <stdexcept>
+
+#include "util.h"
+#include "offset_stats.h"
+
+
+static const float		OUTLIER_MADS	= 4.0;	// from the median
+static const unsigned int	MIN_ROBUST	= 5;	// values before outliers are rejected
+
+
+offset_stats::offset_stats(const unsigned int max_len) {
+
+	if(!max_len)
+		throw std::runtime_error("offset_stats: bad length");
+
+	m_max_len = max_len;
+	m_sorted = new float[max_len];
+	m_dev = new float[max_len];
+	reset();
+}
+
+
+offset_stats::~offset_stats() {
+
+	delete[] m_dev;
+	delete[] m_sorted;
+}
+
+
+void offset_stats::reset() {
+
+	m_len = 0;
+	m_n = 0;
+	m_mean = 0.0;
+	m_m2 = 0.0;
+}
+
+
+/*
+ * Add a value.
+ *
+ * Until there are MIN_ROBUST values every one of them is an inlier.  After
+ * that the inliers are those within OUTLIER_MADS of the median, which may
+ * leave out values that were counted before.
+ *
+ * 	returns	1 if it counts towards the mean, 0 if it's an outlier and -1 if
+ * 		the sketch is full
+ */
+int offset_stats::add(const float x) {
+
+	unsigned int i;
+	float m, s, lim = HUGE_VAL;
+	double d;
+
+	if(m_len >= m_max_len)
+		return -1;
+
+	// insertion keeps the sketch sorted
+	for(i = m_len; (i > 0) && (m_sorted[i - 1] > x); i--)
+		m_sorted[i] = m_sorted[i - 1];
+	m_sorted[i] = x;
+	m_len += 1;
+
+	m = median();
+	if((m_len >= MIN_ROBUST) && ((s = spread()) > 0.0))
+		lim = OUTLIER_MADS * s;
+
+	// Welford over the inliers
+	m_n = 0;
+	m_mean = 0.0;
+	m_m2 = 0.0;
+	for(i = 0; i < m_len; i++) {
+		if(fabsf(m_sorted[i] - m) > lim)
+			continue;
+		m_n += 1;
+		d = m_sorted[i] - m_mean;
+		m_mean += d / m_n;
+		m_m2 += d * (m_sorted[i] - m_mean);
+	}
+
+	return (fabsf(x - m) > lim)? 0 : 1;
+}
+
+
+unsigned int offset_stats::count() {
+
+	return m_len;
+}
+
+
+unsigned int offset_stats::inliers() {
+
+	return m_n;
+}
+
+
+double offset_stats::mean() {
+
+	return m_mean;
+}
+
+
+double offset_stats::stddev() {
+
+	if(m_n < 2)
+		return 0.0;
+	return sqrt(m_m2 / (m_n - 1));
+}
+
+
+/*
+ * Half the width of the 95% confidence interval of the mean.
+ */
+double offset_stats::interval() {
+
+	if(m_n < 2)
+		return HUGE_VAL;
+	return 1.96 * stddev() / sqrt((double)m_n);
+}
+
+
+float offset_stats::median() {
+
+	if(!m_len)
+		return 0.0;
+	if(m_len & 1)
+		return m_sorted[m_len / 2];
+	return (m_sorted[m_len / 2 - 1] + m_sorted[m_len / 2]) / 2;
+}
+
+
+/*
+ * The median absolute deviation, scaled to match the standard deviation of
+ * normally distributed values.
+ */
+float offset_stats::spread() {
+
+	unsigned int i;
+	float m;
+
+	if(!m_len)
+		return 0.0;
+
+	m = median();
+	for(i = 0; i < m_len; i++)
+		m_dev[i] = fabsf(m_sorted[i] - m);
+	sort(m_dev, m_len);
+	if(m_len & 1)
+		return 1.4826 * m_dev[m_len / 2];
+	return 1.4826 * (m_dev[m_len / 2 - 1] + m_dev[m_len / 2]) / 2;
+}
+
+
+/*
+ * The value a fraction q of the way through the sorted values.
+ */
+float offset_stats::quantile(const float q) {
+
+	unsigned int i;
+
+	if(!m_len)
+		return 0.0;
+	i = (unsigned int)(q * (m_len - 1) + 0.5);
+	if(i >= m_len)
+		i = m_len - 1;
+	return m_sorted[i];
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+ * offset_stats
+ *
+ * Running statistics of frequency offset measurements, added one at a time.
+ *
+ * Every value goes into a small sorted sketch whose median and median
+ * absolute deviation stand up to the odd false detection.  The estimate and
+ * how well it is known are the mean and variance of the values close enough
+ * to the median.  They are worked out again from the sketch with each value,
+ * so a false detection that came before there were enough values to tell is
+ * left out once there are.
+ */
+class offset_stats {
+public:
+	offset_stats(const unsigned int max_len);
+	~offset_stats();
+
+	void reset();
+	int add(const float x);
+
+	unsigned int count();
+	unsigned int inliers();
+	double mean();
+	double stddev();
+	double interval();
+	float median();
+	float spread();
+	float quantile(const float q);
+
+private:
+	unsigned int	m_max_len;
+	float *		m_sorted;	// every value, ascending
+	float *		m_dev;		// scratch for spread
+	unsigned int	m_len;
+
+	// of the inliers, as of the last value added
+	unsigned int	m_n;
+	double		m_mean;
+	double		m_m2;		// sum of squared differences from the mean
+};
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "arfcn_freq.h"
+#include "circular_buffer.h"
+#include "fcch_detector.h"
+#include "power_scan.h"
+
+
+static const double		SCAN_RATE	= 6.4e6;	// 32 channels
+static const double		SCAN_BIN	= 12.5e3;	// FFT resolution
+static const double		CHAN_SPACING	= 200e3;
+static const float		SCAN_USE	= 0.8;		// of each capture
+static const unsigned int	MIN_FFT_LEN	= 32;
+
+
+power_scanner::power_scanner(const double sample_rate, const unsigned int fft_len) {
+
+	unsigned int i;
+
+	if(fft_len < 2)
+		throw std::runtime_error("power_scanner: bad fft length");
+
+	m_sample_rate = sample_rate;
+	m_fft_len = fft_len;
+
+	m_window = new float[fft_len];
+	m_window_power = 0.0;
+	for(i = 0; i < fft_len; i++) {
+		m_window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / fft_len);
+		m_window_power += m_window[i] * m_window[i];
+	}
+	m_psd = new double[fft_len];
+
+	m_in = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * fft_len);
+	m_out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * fft_len);
+	if((!m_in) || (!m_out))
+		throw std::runtime_error("power_scanner: fftw_malloc failed!");
+
+	pthread_mutex_lock(&g_fftw_mutex);
+	m_plan = fftw_plan_dft_1d(fft_len, m_in, m_out, FFTW_FORWARD, FFTW_MEASURE);
+	if(!m_plan) {
+		pthread_mutex_unlock(&g_fftw_mutex);
+		throw std::runtime_error("power_scanner: fftw plan failed!");
+	}
+	g_fftw_users += 1;
+	pthread_mutex_unlock(&g_fftw_mutex);
+
+	reset();
+}
+
+
+power_scanner::~power_scanner() {
+
+	pthread_mutex_lock(&g_fftw_mutex);
+	fftw_destroy_plan(m_plan);
+	if(--g_fftw_users == 0)
+		fftw_cleanup();
+	pthread_mutex_unlock(&g_fftw_mutex);
+
+	fftw_free(m_in);
+	fftw_free(m_out);
+	delete[] m_psd;
+	delete[] m_window;
+}
+
+
+void power_scanner::reset() {
+
+	memset(m_psd, 0, m_fft_len * sizeof(double));
+	m_segments = 0;
+}
+
+
+unsigned int power_scanner::segments() {
+
+	return m_segments;
+}
+
+
+/*
+ * Add the segments of s, overlapping by half, to the average.
+ */
+void power_scanner::measure(const complex *s, const unsigned int s_len) {
+
+	unsigned int i, os;
+
+	for(os = 0; os + m_fft_len <= s_len; os += m_fft_len / 2) {
+		for(i = 0; i < m_fft_len; i++) {
+			m_in[i][0] = m_window[i] * s[os + i].real();
+			m_in[i][1] = m_window[i] * s[os + i].imag();
+		}
+		fftw_execute(m_plan);
+		for(i = 0; i < m_fft_len; i++)
+			m_psd[i] += m_out[i][0] * m_out[i][0] + m_out[i][1] * m_out[i][1];
+		m_segments += 1;
+	}
+}
+
+
+/*
+ * Mean power per sample in width Hz centred offset Hz from the tuned
+ * frequency.  Bins on the edges count for the part of them inside.  The whole
+ * spectrum sums to the mean power of the samples.
+ */
+double power_scanner::chan_power(const double offset, const double width) {
+
+	int b, lo, hi;
+	double df, f, w, p = 0.0;
+
+	if(!m_segments)
+		return 0.0;
+
+	df = m_sample_rate / m_fft_len;
+	lo = (int)floor((offset - width / 2) / df + 0.5);
+	hi = (int)floor((offset + width / 2) / df + 0.5);
+	for(b = lo; b <= hi; b++) {
+		if((b < -(int)m_fft_len / 2) || (b >= (int)m_fft_len / 2))
+			continue;
+
+		// the part of bin b, [f - df / 2, f + df / 2], inside the channel
+		f = b * df;
+		w = fmin(f + df / 2, offset + width / 2) - fmax(f - df / 2, offset - width / 2);
+		if(w <= 0.0)
+			continue;
+		p += (w / df) * m_psd[(b + m_fft_len) % m_fft_len];
+	}
+
+	return p / (m_segments * m_fft_len * m_window_power);
+}
+
+
+/*
+ * band_power_scan
+ *
+ * Measure the power of every channel of a band, a few dozen channels per
+ * capture.  Each capture is centred half a channel off a channel so the
+ * radio's DC offset falls between two channels, and only the inner SCAN_USE
+ * of it is used.  A narrowband source is switched to SCAN_RATE for the scan
+ * and back afterwards.  Streaming must already be started.
+ *
+ * 	power	rms per ARFCN, indexed by ARFCN
+ */
+int band_power_scan(usrp_source *u, int bi, double *power) {
+
+	int i, j, cbi, ret = -1;
+	unsigned int n, fft_len, len, b_len, overruns;
+	double fs, rate, centre, freq;
+	complex *b;
+	circular_buffer *ub;
+	power_scanner *ps;
+
+	if(bi == BI_NOT_DEFINED) {
+		fprintf(stderr, "error: band_power_scan: band not defined\n");
+		return -1;
+	}
+
+	rate = u->sample_rate();
+	if(rate < SCAN_RATE) {
+		u->stop();
+		if(u->set_sample_rate(SCAN_RATE)) {
+			fprintf(stderr, "error: usrp_source::set_sample_rate\n");
+			u->start();
+			return -1;
+		}
+		u->start();
+	}
+	fs = u->sample_rate();
+
+	// an even number of channels per capture so none sits on DC
+	n = 2 * (unsigned int)(SCAN_USE * fs / (2 * CHAN_SPACING));
+	for(fft_len = MIN_FFT_LEN; fft_len < fs / SCAN_BIN; fft_len *= 2);
+	ub = u->get_buffer();
+	len = (unsigned int)ceil((12 * FRAME_LEN + BURST_LEN) * fs / GSM_RATE);
+	if(len > ub->buf_len())
+		len = ub->buf_len();
+
+	try {
+		ps = new power_scanner(fs, fft_len);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		goto jump_restore;
+	}
+
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi))
+		power[i] = -1.0;
+
+	for(i = first_chan(bi); i >= 0; i = next_chan(i, bi)) {
+		if(power[i] >= 0.0)
+			continue;
+
+		cbi = bi;
+		centre = arfcn_to_freq(i, &cbi);
+		if(n)
+			centre += (n / 2 - 0.5) * CHAN_SPACING;
+		if(u->tune(centre)) {
+			fprintf(stderr, "error: usrp_source::tune\n");
+			goto jump_leaving;
+		}
+		do {
+			u->flush();
+			if(u->fill(len, &overruns)) {
+				fprintf(stderr, "error: usrp_source::fill\n");
+				goto jump_leaving;
+			}
+		} while(overruns);
+
+		b = (complex *)ub->peek(&b_len);
+		ps->reset();
+		ps->measure(b, len);
+		ub->purge(len);
+
+		for(j = first_chan(bi); j >= 0; j = next_chan(j, bi)) {
+			cbi = bi;
+			freq = arfcn_to_freq(j, &cbi);
+			if((power[j] >= 0.0) || ((j != i) && (fabs(freq - centre) >= n * CHAN_SPACING / 2)))
+				continue;
+			power[j] = sqrt(ps->chan_power(freq - centre, CHAN_SPACING));
+		}
+	}
+
+	ret = 0;
+jump_leaving:
+	delete ps;
+
+jump_restore:
+	if(rate < SCAN_RATE) {
+		u->stop();
+		if(u->set_sample_rate(rate)) {
+			fprintf(stderr, "error: usrp_source::set_sample_rate\n");
+			ret = -1;
+		}
+		u->start();
+	}
+
+	return ret;
+}
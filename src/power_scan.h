@@ -0,0 +1,38 @@
+#pragma once
+
+#include <fftw3.h>
+
+#include "usrp_source.h"
+#include "usrp_complex.h"
+
+/*
+ * power_scanner
+ *
+ * Welch estimate of the power spectrum of a capture: Hann windowed FFTs of
+ * overlapping segments, averaged.  Channel power is the sum of the bins a
+ * channel covers, so neighbouring channels and the radio's DC offset don't
+ * count towards it.
+ */
+class power_scanner {
+public:
+	power_scanner(const double sample_rate, const unsigned int fft_len);
+	~power_scanner();
+
+	void reset();
+	void measure(const complex *s, const unsigned int s_len);
+	double chan_power(const double offset, const double width);
+	unsigned int segments();
+
+private:
+	double			m_sample_rate;
+	unsigned int		m_fft_len;
+	float *			m_window;
+	float			m_window_power;
+	double *		m_psd;		// summed over m_segments
+	unsigned int		m_segments;
+
+	fftw_complex		*m_in, *m_out;
+	fftw_plan		m_plan;
+};
+
+int band_power_scan(usrp_source *u, int bi, double *power);
@@ -0,0 +1,81 @@
+#include "sample_source.h"
+
+
+sample_source::sample_source(const unsigned int cb_len) {
+
+	m_sample_rate = 0.0;
+	m_cb = new circular_buffer(cb_len, sizeof(complex), 0);
+}
+
+
+sample_source::~sample_source() {
+
+	delete m_cb;
+}
+
+
+/*
+ * Drop whatever is buffered.
+ */
+int sample_source::flush() {
+
+	m_cb->flush();
+
+	// sample indices start over so the clock is no longer valid
+	m_clock.reset();
+
+	return 0;
+}
+
+
+double sample_source::sample_rate() {
+
+	return m_sample_rate;
+}
+
+
+circular_buffer *sample_source::get_buffer() {
+
+	return m_cb;
+}
+
+
+tdma_clock *sample_source::get_clock() {
+
+	return &m_clock;
+}
+
+
+nco *sample_source::get_nco() {
+
+	return &m_nco;
+}
+
+
+/*
+ * Remove an additional carrier offset (Hz) from the stream, starting with the
+ * samples already in the buffer.
+ */
+void sample_source::correct(const double offset) {
+
+	unsigned int len;
+	complex *c;
+
+	c = (complex *)m_cb->peek(&len);
+	m_nco.mix_back(c, len, offset);
+	m_nco.adjust(offset);
+}
+
+
+/*
+ * Frame number and time slot of the next sample in the buffer.
+ *
+ * 	returns	-1 if the clock has not been synchronized
+ */
+int sample_source::get_fn_ts(int *fn, int *ts) {
+
+	if(!m_clock.synced())
+		return -1;
+	m_clock.fn_ts((double)m_cb->consumed(), fn, ts);
+	return 0;
+}
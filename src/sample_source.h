@@ -0,0 +1,40 @@
+#pragma once
+
+#include "usrp_complex.h"
+#include "circular_buffer.h"
+#include "tdma_clock.h"
+#include "nco.h"
+
+/*
+ * sample_source
+ *
+ * A stream of samples at a fixed rate, with the circular buffer they are read
+ * from, the clock that maps them to frame numbers and the NCO that takes out
+ * the carrier offset.
+ *
+ * Demodulation (see gsm_demod and camp) only needs what is here, so it runs
+ * the same on a usrp_source or on samples made in memory.  fill must keep the
+ * buffer going until it holds at least num_samples or is full, mixing each
+ * new sample with the NCO before it is written.
+ */
+class sample_source {
+public:
+	sample_source(const unsigned int cb_len);
+	virtual ~sample_source();
+
+	virtual int fill(unsigned int num_samples, unsigned int *overrun) = 0;
+	virtual int flush();
+
+	double sample_rate();
+	circular_buffer *get_buffer();
+	tdma_clock *get_clock();
+	nco *get_nco();
+	void correct(const double offset);
+	int get_fn_ts(int *fn, int *ts);
+
+protected:
+	double			m_sample_rate;
+	circular_buffer *	m_cb;
+	tdma_clock		m_clock;
+	nco			m_nco;
+};
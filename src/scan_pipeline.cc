@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "dsp.h"
+#include "scan_pipeline.h"
+
+
+/*
+ * Captures capture_len samples per channel.  One more buffer than workers lets
+ * the radio fill the next buffer while every worker is busy.
+ */
+scan_pipeline::scan_pipeline(const unsigned int n_threads,
+   const double sample_rate, const unsigned int capture_len) {
+
+	unsigned int i;
+
+	if((!n_threads) || (n_threads >= MAX_SLOTS))
+		throw std::runtime_error("scan_pipeline: bad number of threads");
+
+	m_sample_rate = sample_rate;
+	m_capture_len = capture_len;
+	m_n_slots = n_threads + 1;
+	m_pending = 0;
+	m_started = 0;
+	m_stop = 0;
+
+	// planning FFTs is slow, get it over with before the radio starts
+	for(i = 0; i < n_threads; i++) {
+		try {
+			m_detectors[i] = new fcch_detector(sample_rate);
+		} catch(std::runtime_error &e) {
+			while(i > 0)
+				delete m_detectors[--i];
+			throw;
+		}
+	}
+
+	for(i = 0; i < m_n_slots; i++) {
+		memset(&m_slots[i], 0, sizeof(m_slots[i]));
+		m_slots[i].state = SLOT_FREE;
+		m_slots[i].s = new complex[capture_len];
+	}
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_work, 0);
+	pthread_cond_init(&m_space, 0);
+
+	m_threads = new pthread_t[n_threads];
+	for(m_n_threads = 0; m_n_threads < n_threads; m_n_threads++) {
+		if(pthread_create(&m_threads[m_n_threads], 0, worker_thread, this)) {
+			perror("pthread_create");
+			break;
+		}
+	}
+	if(!m_n_threads) {
+		delete[] m_threads;
+		for(i = 0; i < m_n_slots; i++)
+			delete[] m_slots[i].s;
+		for(i = 0; i < n_threads; i++)
+			delete m_detectors[i];
+		throw std::runtime_error("scan_pipeline: pthread_create");
+	}
+	for(i = m_n_threads; i < n_threads; i++)
+		delete m_detectors[i];
+}
+
+
+scan_pipeline::~scan_pipeline() {
+
+	unsigned int i;
+
+	drain();
+
+	pthread_mutex_lock(&m_mutex);
+	m_stop = 1;
+	pthread_cond_broadcast(&m_work);
+	pthread_mutex_unlock(&m_mutex);
+
+	for(i = 0; i < m_n_threads; i++)
+		pthread_join(m_threads[i], 0);
+	delete[] m_threads;
+
+	for(i = 0; i < m_n_slots; i++)
+		delete[] m_slots[i].s;
+	for(i = 0; i < m_n_threads; i++)
+		delete m_detectors[i];
+
+	pthread_cond_destroy(&m_space);
+	pthread_cond_destroy(&m_work);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+/*
+ * Tune to freq, capture and queue the capture for the given stages.  The
+ * stages fill in the matching fields of res, which must stay valid until
+ * drain returns.
+ */
+int scan_pipeline::submit(usrp_source *u, const double freq, const int stages,
+   scan_result_s *res) {
+
+	int r;
+	unsigned int b_len, overruns;
+	complex *b;
+	circular_buffer *ub;
+
+	if(u->tune(freq)) {
+		fprintf(stderr, "error: usrp_source::tune\n");
+		return -1;
+	}
+	ub = u->get_buffer();
+	do {
+		u->flush();
+		if(u->fill(m_capture_len, &overruns)) {
+			fprintf(stderr, "error: usrp_source::fill\n");
+			return -1;
+		}
+	} while(overruns);
+
+	b = (complex *)ub->peek(&b_len);
+	r = submit(b, b_len, stages, res);
+	ub->purge(m_capture_len);
+
+	return r;
+}
+
+
+/*
+ * Queue a capture made elsewhere, such as one channel of a channelizer.  Only
+ * the first capture_len samples are used.
+ */
+int scan_pipeline::submit(const complex *s, const unsigned int s_len,
+   const int stages, scan_result_s *res) {
+
+	unsigned int i;
+	scan_slot_s *slot = 0;
+
+	if(s_len < m_capture_len) {
+		fprintf(stderr, "error: scan_pipeline::submit: capture too short\n");
+		return -1;
+	}
+
+	pthread_mutex_lock(&m_mutex);
+	for(;;) {
+		for(i = 0; i < m_n_slots; i++) {
+			if(m_slots[i].state == SLOT_FREE) {
+				slot = &m_slots[i];
+				break;
+			}
+		}
+		if(slot)
+			break;
+		pthread_cond_wait(&m_space, &m_mutex);
+	}
+	slot->state = SLOT_BUSY;
+	m_pending += 1;
+	pthread_mutex_unlock(&m_mutex);
+
+	// the slot is ours until it is queued
+	memcpy(slot->s, s, m_capture_len * sizeof(complex));
+
+	pthread_mutex_lock(&m_mutex);
+	slot->res = res;
+	slot->stages = stages;
+	if(stages & SCAN_POWER) {
+		slot->state = SLOT_POWER;
+	} else if(stages & SCAN_FCCH) {
+		slot->state = SLOT_FCCH;
+	} else {
+		slot->state = SLOT_FREE;
+		m_pending -= 1;
+	}
+	pthread_cond_signal(&m_work);
+	pthread_mutex_unlock(&m_mutex);
+
+	return 0;
+}
+
+
+/*
+ * Wait until every capture has been through its stages.
+ */
+void scan_pipeline::drain() {
+
+	pthread_mutex_lock(&m_mutex);
+	while(m_pending)
+		pthread_cond_wait(&m_space, &m_mutex);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void *scan_pipeline::worker_thread(void *arg) {
+
+	((scan_pipeline *)arg)->worker();
+	return 0;
+}
+
+
+/*
+ * Power measurements are cheap and keep the pipeline moving, so they go
+ * first.
+ */
+scan_pipeline::scan_slot_s *scan_pipeline::next_job_nolock() {
+
+	unsigned int i;
+
+	for(i = 0; i < m_n_slots; i++)
+		if(m_slots[i].state == SLOT_POWER)
+			return &m_slots[i];
+	for(i = 0; i < m_n_slots; i++)
+		if(m_slots[i].state == SLOT_FCCH)
+			return &m_slots[i];
+	return 0;
+}
+
+
+void scan_pipeline::worker() {
+
+	int stage;
+	unsigned int r;
+	float offset;
+	scan_slot_s *slot;
+	fcch_detector *l;
+
+	pthread_mutex_lock(&m_mutex);
+	l = m_detectors[m_started++];
+	for(;;) {
+		while((!(slot = next_job_nolock())) && (!m_stop))
+			pthread_cond_wait(&m_work, &m_mutex);
+		if(!slot)
+			break;
+		stage = (slot->state == SLOT_POWER)? SCAN_POWER : SCAN_FCCH;
+		slot->state = SLOT_BUSY;
+		pthread_mutex_unlock(&m_mutex);
+
+		if(stage == SCAN_POWER) {
+			slot->res->power = sqrt(vectornorm2(slot->s, m_capture_len));
+		} else {
+			offset = 0.0;
+			r = l->scan(slot->s, m_capture_len, &offset, 0);
+			slot->res->found = r? 1 : 0;
+			slot->res->offset = offset - FCCH_FREQ;
+		}
+
+		pthread_mutex_lock(&m_mutex);
+		slot->stages &= ~stage;
+		if(slot->stages & SCAN_FCCH) {
+			slot->state = SLOT_FCCH;
+			pthread_cond_signal(&m_work);
+		} else {
+			slot->state = SLOT_FREE;
+			m_pending -= 1;
+			pthread_cond_broadcast(&m_space);
+		}
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "usrp_source.h"
+#include "fcch_detector.h"
+
+// stages a capture goes through
+enum {
+	SCAN_POWER	= 1,
+	SCAN_FCCH	= 2
+};
+
+typedef struct {
+	double		power;		// rms of the capture, SCAN_POWER
+	int		found;		// a frequency burst was seen, SCAN_FCCH
+	float		offset;		// its frequency offset (Hz)
+} scan_result_s;
+
+
+/*
+ * scan_pipeline
+ *
+ * Overlaps tuning and capturing one channel with the analysis of the ones
+ * before it.
+ *
+ * The caller's thread owns the radio: submit tunes, captures into one of a
+ * few buffers and returns as soon as the samples are copied out, so the next
+ * channel can be tuned while workers are still looking at this one.  Power
+ * measurement and the FCCH search are separate stages.  A worker takes any
+ * buffer waiting for the power stage before one waiting for the FCCH stage,
+ * and each worker has its own fcch_detector.  A buffer goes back to the radio
+ * once the stages asked for are done, so submit only waits when every buffer
+ * is still being analyzed.
+ */
+class scan_pipeline {
+public:
+	scan_pipeline(const unsigned int n_threads, const double sample_rate,
+	   const unsigned int capture_len);
+	~scan_pipeline();
+
+	int submit(usrp_source *u, const double freq, const int stages,
+	   scan_result_s *res);
+	int submit(const complex *s, const unsigned int s_len, const int stages,
+	   scan_result_s *res);
+	void drain();
+
+private:
+	enum {
+		SLOT_FREE,
+		SLOT_POWER,	// waiting for the power stage
+		SLOT_FCCH,	// waiting for the FCCH stage
+		SLOT_BUSY	// a worker has it
+	};
+
+	typedef struct {
+		int		state;
+		int		stages;		// stages still to run
+		complex *	s;
+		scan_result_s *	res;
+	} scan_slot_s;
+
+	static void *worker_thread(void *arg);
+	void worker();
+	scan_slot_s *next_job_nolock();
+
+	static const unsigned int	MAX_SLOTS	= 16;	// and workers
+
+	double			m_sample_rate;
+	unsigned int		m_capture_len;
+
+	scan_slot_s		m_slots[MAX_SLOTS];
+	fcch_detector *		m_detectors[MAX_SLOTS];	// one per worker
+	unsigned int		m_started;	// workers that took their detector
+	unsigned int		m_n_slots;
+	unsigned int		m_pending;	// slots not free
+	int			m_stop;
+
+	unsigned int		m_n_threads;
+	pthread_t *		m_threads;
+
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_work;		// a slot has a stage to run
+	pthread_cond_t		m_space;	// a slot was freed
+};
@@ -2,10 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include "gsm.h"
-#include "usrp_source.h"
 #include "fcch_detector.h"
 #include "gsm_bursts.h"
 #include "gsm_demod.h"
+#include "bitvec.h"
+#include "sch.h"
 
 
 /*
@@ -27,44 +28,44 @@ static const unsigned int PARITY_SIZE		= 10;
 static const unsigned int TAIL_BITS_SIZE	= 4;
 static const unsigned int PARITY_OUTPUT_SIZE	= (DATA_BLOCK_SIZE + PARITY_SIZE + TAIL_BITS_SIZE);
 
-static const unsigned char parity_polynomial[PARITY_SIZE + 1] = {
-	1, 0, 1, 0, 1, 1, 1, 0, 1, 0, 1
-};
-
-static const unsigned char parity_remainder[PARITY_SIZE] = {
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1
-};
+/*
+ * The data block, parity and tail bits are all held in a single word, bit i
+ * of the block in bit i of the word.  Bit i of the polynomial word is the
+ * coefficient of x^(10 - i).  (The polynomial is palindromic anyway.)
+ */
+static const uint64_t parity_polynomial	= 0x575;
+static const uint64_t parity_remainder	= 0x3ff;
 
 
-static inline void parity_encode(unsigned char *d, unsigned char *p) {
+/*
+ * Long division of the first DATA_BLOCK_SIZE bits of d by the parity
+ * polynomial.  Returns the PARITY_SIZE bits following the data block.
+ */
+static inline uint64_t parity_divide(uint64_t d) {
 
 	unsigned int i;
-	unsigned char buf[DATA_BLOCK_SIZE + PARITY_SIZE], *q;
 
-	memcpy(buf, d, DATA_BLOCK_SIZE);
-	memset(buf + DATA_BLOCK_SIZE, 0, PARITY_SIZE);
-
-	for(q = buf; q < buf + DATA_BLOCK_SIZE; q++)
-		if(*q)
-			for(i = 0; i < PARITY_SIZE + 1; i++)
-				q[i] ^= parity_polynomial[i];
-	for(i = 0; i < PARITY_SIZE; i++)
-		p[i] = !buf[DATA_BLOCK_SIZE + i];
+	for(i = 0; i < DATA_BLOCK_SIZE; i++)
+		if((d >> i) & 1)
+			d ^= parity_polynomial << i;
+	return (d >> DATA_BLOCK_SIZE) & bv_mask(PARITY_SIZE);
 }
 
 
-static inline int parity_check(unsigned char *d) {
+/*
+ * Returns the data block with parity appended (and tail bits clear).
+ */
+static inline uint64_t parity_encode(const uint64_t d) {
+
+	uint64_t data = d & bv_mask(DATA_BLOCK_SIZE);
+
+	return data | ((~parity_divide(data) & bv_mask(PARITY_SIZE)) << DATA_BLOCK_SIZE);
+}
 
-	unsigned int i;
-	unsigned char buf[DATA_BLOCK_SIZE + PARITY_SIZE], *q;
 
-	memcpy(buf, d, DATA_BLOCK_SIZE + PARITY_SIZE);
+static inline int parity_check(const uint64_t d) {
 
-	for(q = buf; q < buf + DATA_BLOCK_SIZE; q++)
-		if(*q)
-			for(i = 0; i < PARITY_SIZE + 1; i++)
-				q[i] ^= parity_polynomial[i];
-	return memcmp(buf + DATA_BLOCK_SIZE, parity_remainder, PARITY_SIZE);
+	return parity_divide(d) != parity_remainder;
 }
 
 
@@ -85,6 +86,7 @@ static const unsigned int CONV_INPUT_SIZE	= PARITY_OUTPUT_SIZE;
 static const unsigned int CONV_SIZE		= (2 * CONV_INPUT_SIZE);
 static const unsigned int K			= 5;
 static const unsigned int MAX_ERROR		= (2 * CONV_INPUT_SIZE + 1);
+static const int MAX_METRIC			= (2 * CONV_SIZE * LLR_MAX + 1);
 
 
 /*
@@ -146,27 +148,47 @@ static inline unsigned int hamming_distance2(unsigned int w) {
 }
 
 
-static inline void conv_encode(unsigned char *data, unsigned char *output) {
+/*
+ * Spread the low 32 bits of x to the even bit positions of a word.
+ */
+static inline uint64_t spread32(uint64_t x) {
+
+	x &= 0xffffffffULL;
+	x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+	x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+	x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x << 2)) & 0x3333333333333333ULL;
+	x = (x | (x << 1)) & 0x5555555555555555ULL;
+	return x;
+}
 
-	unsigned int i, state = 0, o;
 
-	// encode data
-	for(i = 0; i < CONV_INPUT_SIZE; i++) {
-		o = encode[state][data[i]];
-		state = next_state[state][data[i]];
-		*output++ = !!(o & 2);
-		*output++ = o & 1;
-	}
+/*
+ * Both generator polynomials are evaluated for every input bit at once and
+ * then interleaved into the output.
+ */
+static inline void conv_encode(const uint64_t data, bitvec_s *output) {
+
+	uint64_t u, g0, g1;
+
+	u = data & bv_mask(CONV_INPUT_SIZE);
+	g0 = (u ^ (u << 3) ^ (u << 4)) & bv_mask(CONV_INPUT_SIZE);
+	g1 = (u ^ (u << 1) ^ (u << 3) ^ (u << 4)) & bv_mask(CONV_INPUT_SIZE);
+
+	bv_clear(output, CONV_SIZE);
+	output->w[0] = spread32(g0) | (spread32(g1) << 1);
+	output->w[1] = spread32(g0 >> 32) | (spread32(g1 >> 32) << 1);
 }
 
 
-static inline int conv_decode(unsigned char *data, unsigned char *output) {
+static inline int conv_decode(const bitvec_s *data, uint64_t *output) {
 
-	unsigned int i, t, rdata, state, nstate, b, o, distance, accumulated_error, min_state, min_error, cur_state;
+	unsigned int i, t, x, rdata, state, nstate, b, o, distance, accumulated_error, min_state, min_error, cur_state;
+	uint64_t out;
 
 	unsigned int ae[1 << (K - 1)];
 	unsigned int nae[1 << (K - 1)]; // next accumulated error
-	unsigned int state_history[1 << (K - 1)][CONV_INPUT_SIZE + 1];
+	unsigned char state_history[1 << (K - 1)][CONV_INPUT_SIZE + 1];
 
 	// initialize accumulated error, assume starting state is 0
 	for(i = 0; i < (1 << (K - 1)); i++)
@@ -176,8 +198,9 @@ static inline int conv_decode(unsigned char *data, unsigned char *output) {
 	// build trellis
 	for(t = 0; t < CONV_INPUT_SIZE; t++) {
 
-		// get received data symbol
-		rdata = (data[2 * t] << 1) | data[2 * t + 1];
+		// get received data symbol, c_{2t} in bit 1
+		x = bv_extract(data, 2 * t, 2);
+		rdata = ((x & 1) << 1) | (x >> 1);
 
 		// for each state
 		for(state = 0; state < (1 << (K - 1)); state++) {
@@ -229,44 +252,57 @@ static inline int conv_decode(unsigned char *data, unsigned char *output) {
 	}
 
 	// trace the path
+	out = 0;
 	cur_state = min_state;
 	for(t = CONV_INPUT_SIZE; t >= 1; t--) {
 		min_state = cur_state;
 		cur_state = state_history[cur_state][t]; // get previous
-		output[t - 1] = prev_next_state[cur_state][min_state];
+		out |= (uint64_t)prev_next_state[cur_state][min_state] << (t - 1);
 	}
+	*output = out;
 
 	// return the number of errors detected (hard-decision)
 	return min_error;
 }
 
 
-static inline float conv_decode_soft(float *data, unsigned char *output) {
+/*
+ * Cost of deciding bit b when the soft value is l.
+ */
+static inline int llr_cost(const unsigned int b, const int l) {
+
+	if(b)
+		return (l > 0)? l : 0;
+	return (l < 0)? -l : 0;
+}
+
+
+static inline int conv_decode_llr(const llr_t *data, uint64_t *output) {
 
 	unsigned int i, t, state, nstate, b, min_state, cur_state, o;
-	unsigned int state_history[1 << (K - 1)][CONV_INPUT_SIZE + 1];
-	double ae[1 << (K - 1)];
-	double nae[1 << (K - 1)]; // next accumulated error
-	double rd1, rd2, distance, accumulated_error, min_error;
-	unsigned int o1, o2;
+	unsigned char state_history[1 << (K - 1)][CONV_INPUT_SIZE + 1];
+	int ae[1 << (K - 1)];
+	int nae[1 << (K - 1)]; // next accumulated error
+	int bm[4], accumulated_error, min_error;
+	uint64_t out;
 
 	// initialize accumulated error, assume starting state is 0
 	for(i = 0; i < (1 << (K - 1)); i++)
-		ae[i] = nae[i] = MAX_ERROR;
+		ae[i] = nae[i] = MAX_METRIC;
 	ae[0] = 0;
 
 	// build trellis
 	for(t = 0; t < CONV_INPUT_SIZE; t++) {
 
-		// get received data symbol
-		rd1 = data[2 * t];
-		rd2 = data[2 * t + 1];
+		// branch metric for each possible output pair, c_{2t} in bit 1
+		for(o = 0; o < 4; o++)
+			bm[o] = llr_cost(o >> 1, data[2 * t]) + llr_cost(o & 1, data[2 * t + 1]);
 
 		// for each state
 		for(state = 0; state < (1 << (K - 1)); state++) {
 
 			// make sure this state is possible
-			if(ae[state] >= MAX_ERROR)
+			if(ae[state] >= MAX_METRIC)
 				continue;
 
 			// find all states we lead to
@@ -275,17 +311,8 @@ static inline float conv_decode_soft(float *data, unsigned char *output) {
 				// get next state given input bit b
 				nstate = next_state[state][b];
 
-				// find output for this transition
-				o = encode[state][b];
-
-				o1 = (o & 2) >> 1;
-				o2 = (o & 1);
-
-				// calculate distance from received data
-				distance = fabs((double)o1 - rd1) + fabs((double)o2 - rd2);
-
 				// choose surviving path
-				accumulated_error = ae[state] + distance;
+				accumulated_error = ae[state] + bm[encode[state][b]];
 				if(accumulated_error < nae[nstate]) {
 
 					// save error for surviving state
@@ -300,13 +327,13 @@ static inline float conv_decode_soft(float *data, unsigned char *output) {
 		// get accumulated error ready for next time slice
 		for(i = 0; i < (1 << (K - 1)); i++) {
 			ae[i] = nae[i];
-			nae[i] = MAX_ERROR;
+			nae[i] = MAX_METRIC;
 		}
 	}
 
 	// the final state is the state with the fewest errors
 	min_state = (unsigned int)-1;
-	min_error = MAX_ERROR;
+	min_error = MAX_METRIC;
 	for(i = 0; i < (1 << (K - 1)); i++) {
 		if(ae[i] < min_error) {
 			min_state = i;
@@ -315,69 +342,37 @@ static inline float conv_decode_soft(float *data, unsigned char *output) {
 	}
 
 	// trace the path
+	out = 0;
 	cur_state = min_state;
 	for(t = CONV_INPUT_SIZE; t >= 1; t--) {
 		min_state = cur_state;
 		cur_state = state_history[cur_state][t]; // get previous
-		output[t - 1] = prev_next_state[cur_state][min_state];
+		out |= (uint64_t)prev_next_state[cur_state][min_state] << (t - 1);
 	}
+	*output = out;
 
 	// return the magnitude of errors detected
 	return min_error;
 }
 
 
-int decode_sch(const unsigned char *buf, int *fn_o, int *bsic_o) {
-
-	int errors, bsic, t1, t2, t3p, t3, fn, tt;
-	unsigned char data[CONV_SIZE], decoded_data[PARITY_OUTPUT_SIZE];
+/*
+ * Synchronization channel information, 44.018 page 171. (V7.2.0)
+ *
+ * BSIC: Base Station Identification Code
+ * 	BCC: Base station Color Code
+ * 	NCC: Network Color Code
+ *
+ * FN: Frame Number
+ */
+static void sch_info(const uint64_t d, int *fn_o, int *bsic_o) {
 
-	// extract encoded data from synchronization burst
-	memcpy(data, buf + SB_EDATA_OS_1, SB_EDATA_LEN_1);
-	memcpy(data + SB_EDATA_LEN_1, buf + SB_EDATA_OS_2, SB_EDATA_LEN_2);
+	int bsic, t1, t2, t3p, t3, fn, tt;
 
-	// Viterbi decode
-	if((errors = conv_decode(data, decoded_data))) {
-		// fprintf(stderr, "error: sch: conv_decode (%d)\n", errors);
-		return errors;
-	}
-
-	// check parity
-	if(parity_check(decoded_data)) {
-		// fprintf(stderr, "error: sch: parity failed\n");
-		return 1;
-	}
-
-	// Synchronization channel information, 44.018 page 171. (V7.2.0)
-	bsic =
-	   (decoded_data[ 7] << 5)  |
-	   (decoded_data[ 6] << 4)  |
-	   (decoded_data[ 5] << 3)  |
-	   (decoded_data[ 4] << 2)  |
-	   (decoded_data[ 3] << 1)  |
-	   (decoded_data[ 2] << 0);
-	t1 =
-	   (decoded_data[ 1] << 10) |
-	   (decoded_data[ 0] << 9)  |
-	   (decoded_data[15] << 8)  |
-	   (decoded_data[14] << 7)  |
-	   (decoded_data[13] << 6)  |
-	   (decoded_data[12] << 5)  |
-	   (decoded_data[11] << 4)  |
-	   (decoded_data[10] << 3)  |
-	   (decoded_data[ 9] << 2)  |
-	   (decoded_data[ 8] << 1)  |
-	   (decoded_data[23] << 0);
-	t2 = 
-	   (decoded_data[22] << 4)  |
-	   (decoded_data[21] << 3)  |
-	   (decoded_data[20] << 2)  |
-	   (decoded_data[19] << 1)  |
-	   (decoded_data[18] << 0);
-	t3p =
-	   (decoded_data[17] << 2)  |
-	   (decoded_data[16] << 1)  |
-	   (decoded_data[24] << 0);
+	bsic = (d >> 2) & 0x3f;
+	t1 = ((d & 0x3) << 9) | (((d >> 8) & 0xff) << 1) | ((d >> 23) & 1);
+	t2 = (d >> 18) & 0x1f;
+	t3p = (((d >> 16) & 0x3) << 1) | ((d >> 24) & 1);
 
 	t3 = 10 * t3p + 1;
 
@@ -388,13 +383,6 @@ int decode_sch(const unsigned char *buf, int *fn_o, int *bsic_o) {
         tt = (tt - t2) % 26;
 	fn = (51 * 26 * t1) + (51 * tt) + t3;
 
-	/*
-	 * BSIC: Base Station Identification Code
-	 * 	BCC: Base station Color Code
-	 * 	NCC: Network Color Code
-	 *
-	 * FN: Frame Number
-	 */
         /*
 	printf("bsic: %x (bcc: %u; ncc: %u)\tFN: %u\n", bsic, bsic & 7,
 	   (bsic >> 3) & 7, fn);
@@ -404,88 +392,212 @@ int decode_sch(const unsigned char *buf, int *fn_o, int *bsic_o) {
 		*fn_o = fn;
 	if(bsic_o)
 		*bsic_o = bsic;
+}
 
-	return 0;
+
+/*
+ * The inverse of sch_info, without parity.
+ */
+static uint64_t sch_data(const int fn, const int bsic) {
+
+	uint64_t t1, t2, t3p;
+
+	t1 = fn / (51 * 26);
+	t2 = fn % 26;
+	t3p = ((fn % 51) - 1) / 10;
+
+	return
+	   ((uint64_t)(bsic & 0x3f) << 2) |
+	   ((t1 >> 9) & 0x3) | (((t1 >> 1) & 0xff) << 8) | ((t1 & 1) << 23) |
+	   ((t2 & 0x1f) << 18) |
+	   (((t3p >> 1) & 0x3) << 16) | ((t3p & 1) << 24);
 }
 
 
-int decode_sch_soft(const float *buf, int *fn_o, int *bsic_o) {
+static inline int is_sch_frame(const int fn) {
 
-	int i, bsic, t1, t2, t3p, t3, fn, tt;
-	unsigned char decoded_data[PARITY_OUTPUT_SIZE];
-	float data[CONV_SIZE], errors;
+	int t3 = fn % 51;
 
-	// extract encoded data from synchronization burst
+	return (t3 % 10 == 1) && (t3 <= 41);
+}
+
+
+/*
+ * The synchronization burst for a frame, DATA_LEN bits from tail to tail.
+ */
+void encode_sch(const int fn, const int bsic, unsigned char *burst) {
+
+	int i;
+	bitvec_s c;
+
+	conv_encode(parity_encode(sch_data(fn, bsic)), &c);
+
+	memcpy(burst + TB_OS1, tail_bits, TB_LEN);
 	for(i = 0; i < SB_EDATA_LEN_1; i++)
-		data[i] = buf[SB_EDATA_OS_1 + i];
+		burst[SB_EDATA_OS_1 + i] = bv_get(&c, i);
+	memcpy(burst + SB_ETS_OS, sb_etsc, SB_CODE_LEN);
 	for(i = 0; i < SB_EDATA_LEN_2; i++)
-		data[SB_EDATA_LEN_1 + i] = buf[SB_EDATA_OS_2 + i];
+		burst[SB_EDATA_OS_2 + i] = bv_get(&c, SB_EDATA_LEN_1 + i);
+	memcpy(burst + TB_OS2, tail_bits, TB_LEN);
+}
+
+
+int decode_sch(const bitvec_s *buf, int *fn_o, int *bsic_o) {
+
+	int errors;
+	uint64_t decoded_data;
+	bitvec_s data;
+
+	// extract encoded data from synchronization burst
+	bv_clear(&data, CONV_SIZE);
+	bv_copy(&data, 0, buf, SB_EDATA_OS_1, SB_EDATA_LEN_1);
+	bv_copy(&data, SB_EDATA_LEN_1, buf, SB_EDATA_OS_2, SB_EDATA_LEN_2);
 
 	// Viterbi decode
-	errors = conv_decode_soft(data, decoded_data);
+	if((errors = conv_decode(&data, &decoded_data))) {
+		// fprintf(stderr, "error: sch: conv_decode (%d)\n", errors);
+		return errors;
+	}
 
 	// check parity
 	if(parity_check(decoded_data)) {
-		// fprintf(stderr, "error: decode_sch_soft: parity failed (viterbi errors = %f)\n", errors);
+		// fprintf(stderr, "error: sch: parity failed\n");
+		return 1;
+	}
+
+	sch_info(decoded_data, fn_o, bsic_o);
+
+	return 0;
+}
+
+
+int decode_sch_llr(const llr_t *buf, int *fn_o, int *bsic_o, int *metric_o) {
+
+	int errors;
+	uint64_t decoded_data;
+	llr_t data[CONV_SIZE];
+
+	// extract encoded data from synchronization burst
+	memcpy(data, buf + SB_EDATA_OS_1, SB_EDATA_LEN_1 * sizeof(llr_t));
+	memcpy(data + SB_EDATA_LEN_1, buf + SB_EDATA_OS_2, SB_EDATA_LEN_2 * sizeof(llr_t));
+
+	// Viterbi decode
+	errors = conv_decode_llr(data, &decoded_data);
+
+	// check parity
+	if(parity_check(decoded_data)) {
+		// fprintf(stderr, "error: decode_sch_llr: parity failed (viterbi errors = %d)\n", errors);
 		return -1;
 	}
 
-	// Synchronization channel information, 44.018 page 171. (V7.2.0)
-	bsic =
-	   (decoded_data[ 7] << 5)  |
-	   (decoded_data[ 6] << 4)  |
-	   (decoded_data[ 5] << 3)  |
-	   (decoded_data[ 4] << 2)  |
-	   (decoded_data[ 3] << 1)  |
-	   (decoded_data[ 2] << 0);
-	t1 =
-	   (decoded_data[ 1] << 10) |
-	   (decoded_data[ 0] << 9)  |
-	   (decoded_data[15] << 8)  |
-	   (decoded_data[14] << 7)  |
-	   (decoded_data[13] << 6)  |
-	   (decoded_data[12] << 5)  |
-	   (decoded_data[11] << 4)  |
-	   (decoded_data[10] << 3)  |
-	   (decoded_data[ 9] << 2)  |
-	   (decoded_data[ 8] << 1)  |
-	   (decoded_data[23] << 0);
-	t2 = 
-	   (decoded_data[22] << 4)  |
-	   (decoded_data[21] << 3)  |
-	   (decoded_data[20] << 2)  |
-	   (decoded_data[19] << 1)  |
-	   (decoded_data[18] << 0);
-	t3p =
-	   (decoded_data[17] << 2)  |
-	   (decoded_data[16] << 1)  |
-	   (decoded_data[24] << 0);
+	sch_info(decoded_data, fn_o, bsic_o);
+	if(metric_o)
+		*metric_o = errors;
 
-	t3 = 10 * t3p + 1;
+	return 0;
+}
 
-	// modulo arithmetic
-        tt = t3;
-        while(tt < t2)
-                tt += 26;
-        tt = (tt - t2) % 26;
-	fn = (51 * 26 * t1) + (51 * tt) + t3;
 
-	/*
-	 * BSIC: Base Station Identification Code
-	 * 	BCC: Base station Color Code
-	 * 	NCC: Network Color Code
-	 *
-	 * FN: Frame Number
-	 */
-        /*
-	printf("bsic: %x (bcc: %u; ncc: %u)\tFN: %u\n", bsic, bsic & 7,
-	   (bsic >> 3) & 7, fn);
-         */
+int decode_sch_soft(const float *buf, int *fn_o, int *bsic_o) {
+
+	llr_t l[SB_EDATA_OS_2 + SB_EDATA_LEN_2];
+
+	llr_from_soft(l, buf, SB_EDATA_OS_2 + SB_EDATA_LEN_2);
+	return decode_sch_llr(l, fn_o, bsic_o);
+}
+
+
+/*
+ * decode_sch_combined
+ *
+ * Decode soft bits accumulated over several synchronization bursts.
+ *
+ * 	bufs		soft bits for each burst (as for decode_sch_llr)
+ * 	fn_delta	frame number of each burst relative to bufs[0]
+ * 	n		number of bursts
+ *
+ * Only T1, T2 and T3' change between bursts.  Since the code is linear, the
+ * coded bits of burst k differ from those of burst 0 by the encoding of the
+ * difference in the data.  That difference depends on FN mod (51 * 26), which
+ * we don't know, so we try every such FN where burst 0 is a synchronization
+ * burst.  The soft bits of each burst are flipped into the frame of burst 0,
+ * averaged and decoded, and the decoded FN must agree with the hypothesis.
+ *
+ * Hypotheses where T1 would change between the bursts are skipped.  This only
+ * happens in the last few frames of each superframe and the caller simply
+ * tries again with later bursts.
+ *
+ * 	returns	0 and the FN of bufs[0] if successful
+ */
+int decode_sch_combined(const llr_t * const *bufs, const int *fn_delta,
+   const unsigned int n, int *fn_o, int *bsic_o, int *metric_o) {
+
+	unsigned int h, k, j, os;
+	int acc, fn, bsic, metric, best_metric = -1, best_fn = 0, best_bsic = 0;
+	uint64_t d, decoded_data;
+	bitvec_s flip[n];
+	llr_t data[CONV_SIZE];
+
+	if(!n)
+		return -1;
+
+	for(h = 0; h < 51 * 26; h++) {
+		if(!is_sch_frame(h))
+			continue;
+
+		// the coded difference between burst k and burst 0
+		for(k = 0; k < n; k++) {
+			fn = h + fn_delta[k];
+			if((fn < 0) || (fn >= 51 * 26) || !is_sch_frame(fn))
+				break;
+			d = sch_data(h, 0) ^ sch_data(fn, 0);
+			d |= parity_divide(d) << DATA_BLOCK_SIZE;
+			conv_encode(d, &flip[k]);
+		}
+		if(k < n)
+			continue;
+
+		// combine
+		for(j = 0; j < CONV_SIZE; j++) {
+			if(j < SB_EDATA_LEN_1)
+				os = SB_EDATA_OS_1 + j;
+			else
+				os = SB_EDATA_OS_2 + j - SB_EDATA_LEN_1;
+			for(acc = 0, k = 0; k < n; k++) {
+				if(bv_get(&flip[k], j))
+					acc -= bufs[k][os];
+				else
+					acc += bufs[k][os];
+			}
+			if(acc >= 0)
+				data[j] = (acc + (int)n / 2) / (int)n;
+			else
+				data[j] = -((-acc + (int)n / 2) / (int)n);
+		}
+
+		metric = conv_decode_llr(data, &decoded_data);
+		if(parity_check(decoded_data))
+			continue;
+		sch_info(decoded_data, &fn, &bsic);
+		if(fn % (51 * 26) != (int)h)
+			continue;
+
+		if((best_metric < 0) || (metric < best_metric)) {
+			best_metric = metric;
+			best_fn = fn;
+			best_bsic = bsic;
+		}
+	}
+
+	if(best_metric < 0)
+		return -1;
 
 	if(fn_o)
-		*fn_o = fn;
+		*fn_o = best_fn;
 	if(bsic_o)
-		*bsic_o = bsic;
+		*bsic_o = best_bsic;
+	if(metric_o)
+		*metric_o = best_metric;
 
 	return 0;
 }
@@ -1,3 +1,9 @@
-#include "usrp_source.h"
+#pragma once
+#include "bitvec.h"
 
+void encode_sch(const int fn, const int bsic, unsigned char *burst);
+int decode_sch(const bitvec_s *buf, int *fn_o, int *bsic_o);
+int decode_sch_llr(const llr_t *buf, int *fn_o, int *bsic_o, int *metric_o = 0);
 int decode_sch_soft(const float *buf, int *fn_o, int *bsic_o);
+int decode_sch_combined(const llr_t * const *bufs, const int *fn_delta,
+   const unsigned int n, int *fn_o, int *bsic_o, int *metric_o = 0);
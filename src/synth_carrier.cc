@@ -0,0 +1,170 @@
+/*
+ * Writes a C0 carrier made by synth_source to a file, for playing through
+ * other receivers or back into this one.
+ *
+ * Samples are interleaved 32-bit floats (I, Q), on the scale of usrp_source
+ * samples, at the GSM symbol rate times the samples per symbol.  The carrier
+ * offset is the one the receiver would see, so a recording made with -o 0 is
+ * centred on the carrier.  The time spent making the samples is reported on
+ * stderr against the signal time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <math.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "synth_source.h"
+
+static const unsigned int	CHUNK	= 1 << 14;	// samples written at once
+
+
+static void usage(char *prog) {
+
+	printf("Usage:\n");
+	printf("\t%s [options] <file>|-\n", basename(prog));
+	printf("\n");
+	printf("Where options are:\n");
+	printf("\t-S <sps>\tsamples per symbol (1, 2 or 4), defaults to 1\n");
+	printf("\t-b <bsic>\tBSIC, defaults to 0\n");
+	printf("\t-f <fn>\t\tfirst frame number, defaults to 0\n");
+	printf("\t-n <frames>\tframes to write, defaults to 1326 (about 6 s)\n");
+	printf("\t-s <dB>\t\tSNR, defaults to no noise\n");
+	printf("\t-o <Hz>\t\tcarrier offset, defaults to 0\n");
+	printf("\t-p <profile>\tchannel, e.g., TU50 or HT100, defaults to static\n");
+	printf("\t-c <Hz>\t\tcarrier frequency for the Doppler, defaults to 900e6\n");
+	printf("\t-d <ppm>\tsample clock error, defaults to 0\n");
+	printf("\t-l <load>\tfraction of time slots 1-7 with traffic, defaults to 0\n");
+	printf("\t-r <seed>\trandom seed, defaults to 1\n");
+	printf("\t-h\t\thelp\n");
+	exit(-1);
+}
+
+
+int main(int argc, char **argv) {
+
+	int c, bsic = 0, fn = 0;
+	unsigned int frames = 1326, seed = 1, len, overrun;
+	float sps = 1.0, snr = HUGE_VAL, load = 0.0;
+	double offset = 0.0, freq = 900e6, drift = 0.0, total, done = 0.0;
+	const char *channel = 0;
+	complex *s;
+	FILE *out;
+	synth_source *src;
+
+	while((c = getopt(argc, argv, "S:b:f:n:s:o:p:c:d:l:r:h?")) != EOF) {
+		switch(c) {
+			case 'S':
+				sps = strtod(optarg, 0);
+				if((sps != 1.0) && (sps != 2.0) && (sps != 4.0))
+					usage(argv[0]);
+				break;
+
+			case 'b':
+				bsic = strtol(optarg, 0, 0);
+				if((bsic < 0) || (bsic > 0x3f))
+					usage(argv[0]);
+				break;
+
+			case 'f':
+				fn = strtol(optarg, 0, 0);
+				if((fn < 0) || (fn >= MAX_FN))
+					usage(argv[0]);
+				break;
+
+			case 'n':
+				frames = strtoul(optarg, 0, 0);
+				break;
+
+			case 's':
+				snr = strtod(optarg, 0);
+				break;
+
+			case 'o':
+				offset = strtod(optarg, 0);
+				break;
+
+			case 'p':
+				channel = optarg;
+				break;
+
+			case 'c':
+				freq = strtod(optarg, 0);
+				break;
+
+			case 'd':
+				drift = strtod(optarg, 0);
+				break;
+
+			case 'l':
+				load = strtod(optarg, 0);
+				if((load < 0.0) || (load > 1.0))
+					usage(argv[0]);
+				break;
+
+			case 'r':
+				seed = strtoul(optarg, 0, 0);
+				break;
+
+			case 'h':
+			case '?':
+			default:
+				usage(argv[0]);
+				break;
+		}
+	}
+
+	if(optind != argc - 1)
+		usage(argv[0]);
+
+	if(!strcmp(argv[optind], "-"))
+		out = stdout;
+	else if(!(out = fopen(argv[optind], "wb"))) {
+		perror("fopen");
+		return -1;
+	}
+
+	try {
+		src = new synth_source(sps * GSM_RATE, bsic, seed);
+	} catch(std::runtime_error &e) {
+		fprintf(stderr, "error: %s\n", e.what());
+		return -1;
+	}
+	if(src->set_channel(channel, freq))
+		return -1;
+	src->set_snr(snr);
+	src->set_offset(offset);
+	src->set_drift(drift);
+	src->set_load(load);
+	src->set_frame(fn);
+
+	s = new complex[CHUNK];
+	total = floor(sps * FRAME_LEN * frames);
+	while(done < total) {
+		len = (total - done < CHUNK)? (unsigned int)(total - done) : CHUNK;
+		if(src->fill(len, &overrun)) {
+			fprintf(stderr, "error: fill\n");
+			return -1;
+		}
+		len = src->get_buffer()->read(s, len);
+		if(fwrite(s, sizeof(*s), len, out) != len) {
+			perror("fwrite");
+			return -1;
+		}
+		done += len;
+	}
+
+	fprintf(stderr, "%.0f samples, %.3f s of signal made in %.3f s (%.1fx real time)\n",
+	   done, done / src->sample_rate(), src->gen_time(),
+	   (src->gen_time() > 0.0)? done / src->sample_rate() / src->gen_time() : 0.0);
+
+	delete[] s;
+	delete src;
+	if(out != stdout)
+		fclose(out);
+
+	return 0;
+}
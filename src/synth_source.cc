@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <sys/time.h>
+#include <stdexcept>
+
+#include "gsm.h"
+#include "gsm_bursts.h"
+#include "dsp.h"
+#include "sch.h"
+#include "synth_source.h"
+
+
+static const unsigned int	CB_LEN		= (1 << 20);
+static const unsigned int	FRAME_BITS	= 1250;
+static const float		AMPLITUDE	= 1000.0;	// on the scale of usrp_source samples
+static const int		LOOKAHEAD	= 2;		// samples the delay interpolation reads ahead
+static const int		Y_HIST		= 3;		// samples the drift interpolation reads behind
+static const unsigned int	FADE_STEP	= 32;		// samples between fading gain updates
+static const double		LIGHT		= 299792458.0;
+
+// an empty paging request type 1
+static const uint8_t empty_paging[XCCH_L2_LEN] = {
+	0x15, 0x06, 0x21, 0x00, 0x01, 0xf0, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b
+};
+
+
+/*
+ * Channel profiles, 45.005 annex C.3 (6 tap settings).  The speed follows the
+ * name, e.g., TU50 or HT100.  Every tap is Rayleigh faded with the classical
+ * Doppler spectrum, including the first tap of RA.
+ */
+typedef struct {
+	const char *	name;
+	unsigned int	n_taps;
+	float		delay[6];	// us
+	float		power[6];	// dB
+} profile_s;
+
+static const profile_s profiles[] = {
+	{"TU", 6, {0.0, 0.2, 0.5, 1.6, 2.3, 5.0}, {-3.0, 0.0, -2.0, -6.0, -8.0, -10.0}},
+	{"HT", 6, {0.0, 0.1, 0.3, 0.5, 15.0, 17.2}, {0.0, -1.5, -4.5, -7.5, -8.0, -17.7}},
+	{"RA", 6, {0.0, 0.1, 0.2, 0.3, 0.4, 0.5}, {0.0, -4.0, -8.0, -12.0, -16.0, -20.0}},
+	{"EQ", 6, {0.0, 3.2, 6.4, 9.6, 12.8, 16.0}, {0.0, 0.0, 0.0, 0.0, 0.0, 0.0}}
+};
+static const unsigned int PROFILES_LEN = sizeof(profiles) / sizeof(profiles[0]);
+
+
+static double now() {
+
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+/*
+ * First bit of a time slot.  Bursts are 156 or 157 bits long so that a frame
+ * is a whole number of bits.
+ */
+static unsigned int burst_os(const int ts) {
+
+	return (unsigned int)(ts * BURST_LEN + 0.5);
+}
+
+
+/*
+ * Cubic Lagrange interpolation: the value mu of the way from s[1] to s[2] is
+ * c[0] s[0] + c[1] s[1] + c[2] s[2] + c[3] s[3].
+ */
+static void lagrange(const float mu, float *c) {
+
+	c[0] = -mu * (mu - 1) * (mu - 2) / 6;
+	c[1] = (mu + 1) * (mu - 1) * (mu - 2) / 2;
+	c[2] = -(mu + 1) * mu * (mu - 2) / 2;
+	c[3] = (mu + 1) * mu * (mu - 1) / 6;
+}
+
+
+static inline complex interpolate(const complex *s, const float *c) {
+
+	return c[0] * s[0] + c[1] * s[1] + c[2] * s[2] + c[3] * s[3];
+}
+
+
+synth_source::synth_source(const double sample_rate, const int bsic, const unsigned int seed) : sample_source(CB_LEN) {
+
+	double sps = sample_rate / GSM_RATE;
+
+	// modulate only handles whole samples per symbol
+	if((sps < 1.0) || (fabs(sps - floor(sps + 0.5)) > 1e-6))
+		throw std::runtime_error("synth_source: bad sample rate");
+
+	m_sample_rate = sample_rate;
+	m_clock.set_sps(sps);
+	m_nco.set_sample_rate(sample_rate);
+
+	m_bsic = bsic & 0x3f;
+	m_seed = seed;
+	m_load = 0.0;
+	m_frames = 0;
+
+	// an empty block
+	m_bcch[0] = 0x01;
+	memset(m_bcch + 1, 0x2b, XCCH_L2_LEN - 1);
+
+	m_snr = HUGE_VAL;
+	m_phase = 1.0;
+	m_rot = 1.0;
+	m_taps = 0;
+	m_n_taps = 0;
+	m_step = 1.0;
+
+	m_frame_len = (unsigned int)ceil(sps * FRAME_BITS);
+	m_hist = LOOKAHEAD + 2;
+	m_x = new complex[m_hist + m_frame_len];
+	m_y = new complex[Y_HIST + m_frame_len];
+	m_frame = new complex[m_frame_len + m_frame_len / 64 + 8];	// room for drift
+
+	m_pos = 0.0;
+	m_cb_pos = 0.0;
+	m_gen_time = 0.0;
+
+	set_frame(0);
+}
+
+
+synth_source::~synth_source() {
+
+	delete[] m_frame;
+	delete[] m_y;
+	delete[] m_x;
+	delete[] m_taps;
+}
+
+
+/*
+ * Continue the stream skip samples into frame fn.
+ */
+void synth_source::set_frame(const int fn, const unsigned int skip) {
+
+	m_fn = fn % MAX_FN;
+	m_fn0 = m_fn;
+	m_block_fn = -1;
+
+	memset(m_x, 0, (m_hist + m_frame_len) * sizeof(complex));
+	memset(m_y, 0, (Y_HIST + m_frame_len) * sizeof(complex));
+	m_tau = skip % m_frame_len;
+	m_out_len = 0;
+	m_frame_pos = 0;
+
+	m_anchor_pos = m_pos;
+	m_anchor_tau = m_tau;
+}
+
+
+/*
+ * Signal to noise ratio in dB, HUGE_VAL for none.
+ */
+void synth_source::set_snr(const float snr) {
+
+	m_snr = snr;
+}
+
+
+/*
+ * Carrier offset in Hz.
+ */
+void synth_source::set_offset(const double offset) {
+
+	double w = 2.0 * M_PI * offset / m_sample_rate;
+
+	m_rot = std::complex<double>(cos(w), sin(w));
+}
+
+
+/*
+ * Error of the receiver's sample clock in ppm; positive if it runs fast.
+ */
+void synth_source::set_drift(const double ppm) {
+
+	m_anchor_tau += (m_pos - m_anchor_pos) * m_step;
+	m_anchor_pos = m_pos;
+	m_step = 1.0 / (1.0 + ppm * 1e-6);
+}
+
+
+/*
+ * A channel profile and speed in km/h, e.g., "TU50", at carrier frequency
+ * freq (Hz).  "static" (or 0) is no multipath at all.
+ *
+ * 	returns	-1 if the profile is unknown
+ */
+int synth_source::set_channel(const char *profile, const double freq) {
+
+	unsigned int i, j;
+	int os;
+	float d, max_d = 0.0, p = 0.0;
+	double speed = 0.0, fd;
+	const profile_s *pr = 0;
+	char *end;
+
+	if(profile && strcasecmp(profile, "static")) {
+		for(i = 0; i < PROFILES_LEN; i++)
+			if(!strncasecmp(profile, profiles[i].name, strlen(profiles[i].name)))
+				pr = &profiles[i];
+		if(!pr) {
+			fprintf(stderr, "error: synth_source: unknown channel profile: %s\n", profile);
+			return -1;
+		}
+		speed = strtod(profile + strlen(pr->name), &end);
+		if(*end || (speed < 0.0)) {
+			fprintf(stderr, "error: synth_source: bad speed: %s\n", profile);
+			return -1;
+		}
+	}
+
+	delete[] m_taps;
+	m_taps = 0;
+	m_n_taps = 0;
+
+	if(pr) {
+		// Doppler shift at the speed in m/s
+		fd = speed / 3.6 * freq / LIGHT;
+
+		m_taps = new tap_s[pr->n_taps];
+		m_n_taps = pr->n_taps;
+		for(i = 0; i < m_n_taps; i++)
+			p += pow(10.0, pr->power[i] / 10.0);
+		for(i = 0; i < m_n_taps; i++) {
+			d = pr->delay[i] * 1e-6 * m_sample_rate;
+			if(d > max_d)
+				max_d = d;
+			os = (int)floor(-d);
+			m_taps[i].os = os;
+			lagrange(-d - os, m_taps[i].c);
+			m_taps[i].amplitude = sqrt(pow(10.0, pr->power[i] / 10.0) / p / FADE_SINES);
+			for(j = 0; j < FADE_SINES; j++) {
+				m_taps[i].w[j] = 2.0 * M_PI * fd * cos(2.0 * M_PI * rand_r(&m_seed) / RAND_MAX) / m_sample_rate;
+				m_taps[i].phi[j] = 2.0 * M_PI * rand_r(&m_seed) / RAND_MAX;
+			}
+			m_taps[i].g = 0.0;
+		}
+	}
+
+	delete[] m_x;
+	m_hist = LOOKAHEAD + 2 + (unsigned int)ceil(max_d);
+	m_x = new complex[m_hist + m_frame_len];
+	memset(m_x, 0, (m_hist + m_frame_len) * sizeof(complex));
+
+	return 0;
+}
+
+
+/*
+ * Fraction of the bursts on time slots 1-7 that are normal bursts rather than
+ * dummy bursts.
+ */
+void synth_source::set_load(const float load) {
+
+	m_load = load;
+}
+
+
+/*
+ * The layer 2 block sent on the BCCH, XCCH_L2_LEN octets.
+ */
+void synth_source::set_bcch(const uint8_t *l2) {
+
+	memcpy(m_bcch, l2, XCCH_L2_LEN);
+	m_block_fn = -1;
+}
+
+
+int synth_source::bsic() {
+
+	return m_bsic;
+}
+
+
+/*
+ * Samples made so far.
+ */
+double synth_source::position() {
+
+	return m_pos;
+}
+
+
+/*
+ * The frame number (and time slot) sample i of the buffer belongs to, as
+ * counted by tdma_clock.
+ */
+int synth_source::frame_at(const double i, int *ts) {
+
+	double d, bl = m_frame_len / FRAME_LEN * BURST_LEN;
+	long long n;
+
+	d = m_anchor_tau + (m_cb_pos + i - m_anchor_pos) * m_step;
+	n = (long long)floor(d / m_frame_len);
+	if(ts)
+		*ts = (int)floor((d - (double)n * m_frame_len) / bl) & 7;
+	return (int)((m_fn0 + n % MAX_FN + MAX_FN) % MAX_FN);
+}
+
+
+/*
+ * Wall clock seconds spent making frames, so a caller timing the receiver
+ * can leave them out.
+ */
+double synth_source::gen_time() {
+
+	return m_gen_time;
+}
+
+
+/*
+ * Box-Muller, a complex sample of unit power.
+ */
+complex synth_source::noise() {
+
+	double u, v, r;
+
+	do {
+		u = (double)rand_r(&m_seed) / RAND_MAX;
+	} while(u <= 0.0);
+	v = 2.0 * M_PI * rand_r(&m_seed) / RAND_MAX;
+	r = sqrt(-log(u));
+	return complex(r * cos(v), r * sin(v));
+}
+
+
+/*
+ * Gains of the taps t samples into the stream, each a sum of sinusoids with
+ * random arrival angles and phases.
+ */
+void synth_source::fade(const double t) {
+
+	unsigned int i, j;
+	double re, im;
+
+	for(i = 0; i < m_n_taps; i++) {
+		re = im = 0.0;
+		for(j = 0; j < FADE_SINES; j++) {
+			re += cos(m_taps[i].w[j] * t + m_taps[i].phi[j]);
+			im += sin(m_taps[i].w[j] * t + m_taps[i].phi[j]);
+		}
+		m_taps[i].g = m_taps[i].amplitude * complex(re, im);
+	}
+}
+
+
+/*
+ * The bits of frame m_fn.
+ */
+void synth_source::gen_bits(unsigned char *bits) {
+
+	unsigned int i, k, os, len;
+	int ts, t3;
+	unsigned char *b, *bp[XCCH_BURSTS];
+
+	t3 = m_fn % 51;
+
+	// the guard periods are random too
+	for(i = 0; i < FRAME_BITS; i++)
+		bits[i] = rand_r(&m_seed) & 1;
+
+	for(ts = 0; ts < 8; ts++) {
+		os = burst_os(ts);
+		len = burst_os(ts + 1) - os;
+		b = bits + os;
+
+		if(ts == 0) {
+			if((t3 % 10 == 0) && (t3 != 50)) {
+				memset(b, 0, len);
+				continue;
+			}
+			if(t3 % 10 == 1) {
+				encode_sch(m_fn, m_bsic, b);
+				continue;
+			}
+			if(t3 != 50) {
+				// BCCH on 2-5, CCCH on the other blocks of four
+				k = (t3 % 10 - 2) % XCCH_BURSTS;
+				if(m_block_fn != m_fn - (int)k) {
+					m_block_fn = m_fn - k;
+					for(i = 0; i < XCCH_BURSTS; i++) {
+						bp[i] = m_block[i];
+						memcpy(m_block[i] + TB_OS1, tail_bits, TB_LEN);
+						m_block[i][N_EDATA_OS_1 + N_EDATA_LEN_1 - 1] = 1;
+						memcpy(m_block[i] + N_TSC_OS, n_tsc[m_bsic & 7], N_TSC_CODE_LEN);
+						m_block[i][N_EDATA_OS_2] = 1;
+						memcpy(m_block[i] + TB_OS2, tail_bits, TB_LEN);
+					}
+					encode_xcch((t3 < 6)? m_bcch : empty_paging, bp);
+				}
+				memcpy(b, m_block[k], DATA_LEN);
+				continue;
+			}
+		} else if((float)rand_r(&m_seed) / RAND_MAX < m_load) {
+			memcpy(b + TB_OS1, tail_bits, TB_LEN);
+			memcpy(b + N_TSC_OS, n_tsc[m_bsic & 7], N_TSC_CODE_LEN);
+			memcpy(b + TB_OS2, tail_bits, TB_LEN);
+			continue;
+		}
+
+		memcpy(b + TB_OS1, tail_bits, TB_LEN);
+		memcpy(b + D_MB_OS, d_mb, D_CODE_LEN);
+		memcpy(b + TB_OS2, tail_bits, TB_LEN);
+	}
+}
+
+
+void synth_source::gen_frame() {
+
+	unsigned int i, n, k, m_len;
+	int r, j;
+	float sps, sigma = 0.0, c[4];
+	double p = 0.0;
+	unsigned char bits[FRAME_BITS];
+	complex *m, *x, *y, acc;
+
+	sps = m_sample_rate / GSM_RATE;
+
+	gen_bits(bits);
+	if(!(m = modulate(bits, FRAME_BITS, 0, sps, &m_len)) || (m_len < m_frame_len))
+		throw std::runtime_error("synth_source: modulate");
+
+	// modulate rotates each bit by j^i; carry that on from the last frame
+	if(m_frames & 1)
+		scale(m, m_frame_len, -1.0);
+
+	memmove(m_x, m_x + m_frame_len, m_hist * sizeof(complex));
+	x = m_x + m_hist;
+	memcpy(x, m, m_frame_len * sizeof(complex));
+	delete[] m;
+	for(i = 0; i < m_frame_len; i++)
+		p += norm(x[i]);
+
+	/*
+	 * Multipath.  The delays are interpolated from samples either side
+	 * so y runs LOOKAHEAD samples behind x; y[0] is LOOKAHEAD samples
+	 * before the start of the frame.
+	 */
+	memmove(m_y, m_y + m_frame_len, Y_HIST * sizeof(complex));
+	y = m_y + Y_HIST;
+	for(n = 0; n < m_frame_len; n++) {
+		r = (int)n - LOOKAHEAD;
+		if(!m_n_taps) {
+			y[n] = x[r];
+			continue;
+		}
+		if(n % FADE_STEP == 0)
+			fade((double)m_frames * m_frame_len + r);
+		acc = 0.0;
+		for(k = 0; k < m_n_taps; k++)
+			acc += m_taps[k].g * interpolate(x + r + m_taps[k].os - 1, m_taps[k].c);
+		y[n] = acc;
+	}
+
+	// clock drift, y now indexed from the start of the frame
+	y += LOOKAHEAD;
+	m_out_len = 0;
+	for(; (j = (int)floor(m_tau)) <= (int)m_frame_len - LOOKAHEAD - 3; m_tau += m_step) {
+		if(m_tau == j) {
+			m_frame[m_out_len++] = y[j];
+		} else {
+			lagrange(m_tau - j, c);
+			m_frame[m_out_len++] = interpolate(y + j - 1, c);
+		}
+	}
+	m_tau -= m_frame_len;
+
+	// carrier offset and noise
+	if(m_snr < HUGE_VAL)
+		sigma = sqrt(p / m_frame_len / pow(10.0, m_snr / 10.0));
+	for(i = 0; i < m_out_len; i++) {
+		m_frame[i] = AMPLITUDE * (m_frame[i] * complex(m_phase.real(), m_phase.imag()) + sigma * noise());
+		m_phase *= m_rot;
+	}
+	m_phase /= abs(m_phase);
+
+	m_frame_pos = 0;
+	m_fn = (m_fn + 1) % MAX_FN;
+	m_frames += 1;
+}
+
+
+int synth_source::fill(unsigned int num_samples, unsigned int *overrun) {
+
+	unsigned int n, space;
+	double start;
+	complex *c;
+
+	while(m_cb->data_available() < num_samples) {
+		c = (complex *)m_cb->poke(&space);
+		if(!space)
+			break;
+		if(m_frame_pos >= m_out_len) {
+			start = now();
+			gen_frame();
+			m_gen_time += now() - start;
+		}
+		n = m_out_len - m_frame_pos;
+		if(n > space)
+			n = space;
+		memcpy(c, m_frame + m_frame_pos, n * sizeof(complex));
+		m_frame_pos += n;
+		m_pos += n;
+
+		// take out the carrier offset we know about
+		m_nco.mix(c, n);
+		m_cb->wrote(n);
+	}
+
+	if(overrun)
+		*overrun = 0;
+	if(m_cb->data_available() < num_samples) {
+		fprintf(stderr, "warning: local overrun\n");
+		if(overrun)
+			*overrun = 1;
+	}
+
+	return 0;
+}
+
+
+int synth_source::flush() {
+
+	m_cb_pos = m_pos;
+	return sample_source::flush();
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <complex>
+
+#include "usrp_complex.h"
+#include "gsm.h"
+#include "xcch.h"
+#include "sample_source.h"
+
+/*
+ * synth_source
+ *
+ * A C0 carrier made in memory, for running the receiver without a device.
+ *
+ * Time slot 0 follows the 51-multiframe of a non-combined BCCH: frequency
+ * bursts on frames 0, 10, 20, 30 and 40, synchronization bursts carrying the
+ * frame number and BSIC on the frame after each, the BCCH on frames 2-5, the
+ * CCCH on the other blocks of four and a dummy burst on frame 50.  BCCH and
+ * CCCH blocks are coded with encode_xcch; the BCCH carries whatever was given
+ * to set_bcch and the CCCH empty paging requests.  Time slots 1-7 carry dummy
+ * bursts, except that a fraction given by set_load of them are normal bursts
+ * of random bits, as on a busy cell.  Normal bursts use the training sequence
+ * given by the BSIC.
+ *
+ * Frames are modulated one at a time as fill asks for them and then go
+ * through the impairments, in the order they happen on the air:
+ *
+ * 	multipath	a fading channel profile such as TU50 or HT100
+ * 	clock drift	the receiver's sample clock off by some ppm
+ * 	carrier offset	the receiver's LO off by some Hz
+ * 	noise		AWGN for an SNR relative to the mean signal power
+ *
+ * Impairments should be set before set_frame; later changes take effect from
+ * the next frame made.
+ *
+ * The stream position counts every sample made since the source was created;
+ * the buffer's indices start over when it is flushed, as with a usrp_source.
+ */
+class synth_source : public sample_source {
+public:
+	synth_source(const double sample_rate, const int bsic, const unsigned int seed = 1);
+	~synth_source();
+
+	int fill(unsigned int num_samples, unsigned int *overrun);
+	int flush();
+
+	void set_frame(const int fn, const unsigned int skip = 0);
+	void set_snr(const float snr);
+	void set_offset(const double offset);
+	void set_drift(const double ppm);
+	int set_channel(const char *profile, const double freq = 900e6);
+	void set_load(const float load);
+	void set_bcch(const uint8_t *l2);
+
+	int bsic();
+	double position();
+	int frame_at(const double i, int *ts = 0);
+	double gen_time();
+
+private:
+	static const unsigned int	FADE_SINES	= 16;
+
+	typedef struct {
+		int		os;		// whole samples of delay, negated
+		float		c[4];		// interpolates the rest
+		float		amplitude;
+		double		w[FADE_SINES];	// Doppler of each sinusoid, radians per sample
+		double		phi[FADE_SINES];
+		complex		g;		// current gain
+	} tap_s;
+
+	void gen_frame();
+	void gen_bits(unsigned char *bits);
+	void fade(const double t);
+	complex noise();
+
+	int		m_bsic;
+	unsigned int	m_seed;
+	float		m_load;
+
+	int		m_fn;		// next frame to make
+	int		m_fn0;		// frame set_frame started with
+	unsigned int	m_frames;	// frames made
+
+	// the BCCH or CCCH block being sent
+	uint8_t		m_bcch[XCCH_L2_LEN];
+	int		m_block_fn;
+	unsigned char	m_block[XCCH_BURSTS][DATA_LEN];
+
+	float		m_snr;		// dB
+	std::complex<double>	m_phase;	// carrier phase
+	std::complex<double>	m_rot;		// carrier phase step per sample
+
+	// multipath
+	tap_s *		m_taps;
+	unsigned int	m_n_taps;
+	unsigned int	m_hist;		// modulated samples kept for the delays
+
+	// drift
+	double		m_step;		// transmitted samples per received sample
+	double		m_tau;		// next received sample, in this frame's samples
+
+	// the transmitted sample at a stream position, for frame_at
+	double		m_anchor_pos;
+	double		m_anchor_tau;	// from the start of m_fn0
+
+	unsigned int	m_frame_len;	// transmitted samples per frame
+	complex *	m_x;		// modulated, m_hist samples of history first
+	complex *	m_y;		// through the channel, with history
+	complex *	m_frame;	// received
+	unsigned int	m_out_len;
+	unsigned int	m_frame_pos;	// next sample of m_frame to write
+
+	double		m_pos;		// samples made
+	double		m_cb_pos;	// stream position of buffer index 0
+	double		m_gen_time;	// seconds spent making samples
+};
@@ -0,0 +1,101 @@
+#include <math.h>
+
+#include "gsm.h"
+#include "tdma_clock.h"
+
+
+tdma_clock::tdma_clock(const double sps) {
+
+	set_sps(sps);
+	reset();
+}
+
+
+void tdma_clock::set_sps(const double sps) {
+
+	m_sps = sps;
+	m_burst_len = BURST_LEN * sps;
+}
+
+
+double tdma_clock::sps() {
+
+	return m_sps;
+}
+
+
+/*
+ * Anchor the clock: burst (fn, ts) starts at sample pos.
+ */
+void tdma_clock::sync(const int fn, const int ts, const double pos) {
+
+	m_fn = fn % MAX_FN;
+	m_ts = ts & 7;
+	m_pos = pos;
+	m_synced = 1;
+}
+
+
+/*
+ * Move the anchor by a (small) number of samples to follow timing drift.
+ */
+void tdma_clock::adjust(const double samples) {
+
+	m_pos += samples;
+}
+
+
+void tdma_clock::reset() {
+
+	m_fn = 0;
+	m_ts = 0;
+	m_pos = 0.0;
+	m_synced = 0;
+}
+
+
+int tdma_clock::synced() {
+
+	return m_synced;
+}
+
+
+/*
+ * Sample index where burst (fn, ts) starts.
+ *
+ * The frame number is taken to be within half a hyperframe of the anchor so
+ * that bursts just before the anchor, and bursts after the frame number
+ * wraps, come out right.
+ */
+double tdma_clock::burst_pos(const int fn, const int ts) {
+
+	int d;
+
+	d = (fn - m_fn) % MAX_FN;
+	if(d >= MAX_FN / 2)
+		d -= MAX_FN;
+	else if(d < -MAX_FN / 2)
+		d += MAX_FN;
+
+	return m_pos + ((double)d * 8 + (ts - m_ts)) * m_burst_len;
+}
+
+
+/*
+ * Frame number and time slot of the burst that contains sample pos.
+ */
+void tdma_clock::fn_ts(const double pos, int *fn, int *ts) {
+
+	long long n, f;
+
+	n = (long long)floor((pos - m_pos) / m_burst_len) + m_ts;
+	f = (n >= 0)? n / 8 : -((7 - n) / 8);
+
+	if(fn) {
+		*fn = (int)((m_fn + f) % MAX_FN);
+		if(*fn < 0)
+			*fn += MAX_FN;
+	}
+	if(ts)
+		*ts = (int)(n - f * 8);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * tdma_clock
+ *
+ * Maps GSM frame numbers and time slots to absolute sample indices.
+ *
+ * The clock is anchored by a decoded synchronization burst: the frame number
+ * it carried and the (fractional) index of the sample where the burst began.
+ * Sample indices are absolute, i.e., they count every sample consumed from
+ * the circular buffer since it was last flushed (see
+ * circular_buffer::consumed).  A burst is 156.25 bits long so burst positions
+ * are kept as doubles and only rounded when a window is handed out.
+ */
+class tdma_clock {
+public:
+	tdma_clock(const double sps = 1.0);
+
+	void set_sps(const double sps);
+	double sps();
+
+	void sync(const int fn, const int ts, const double pos);
+	void adjust(const double samples);
+	void reset();
+	int synced();
+
+	double burst_pos(const int fn, const int ts);
+	void fn_ts(const double pos, int *fn, int *ts);
+
+private:
+	double		m_sps;		// samples per symbol
+	double		m_burst_len;	// samples per burst
+	int		m_fn;		// frame number of the anchor
+	int		m_ts;		// time slot of the anchor
+	double		m_pos;		// sample index of the anchor
+	int		m_synced;
+};
@@ -35,16 +35,16 @@
 #include <complex>
 #include <stdexcept>
 
+#include "gsm.h"
 #include "usrp_source.h"
 
 
-usrp_source::usrp_source(double sample_rate, char *device_address, long int fpga_master_clock_freq, bool external_ref) {
+usrp_source::usrp_source(double sample_rate, char *device_address, long int fpga_master_clock_freq, bool external_ref) : sample_source(CB_LEN) {
 
 	m_desired_sample_rate = sample_rate;
 	m_device_address = device_address;
 	m_fpga_master_clock_freq = fpga_master_clock_freq;
 	m_external_ref = external_ref;
-	m_sample_rate = 0.0;
 	m_freq_band_center = -1.0;
 
 	m_two_series = 0;
@@ -52,8 +52,6 @@ usrp_source::usrp_source(double sample_rate, char *device_address, long int fpga
 	m_u.reset();
 	m_dev.reset();
 
-	m_cb = new circular_buffer(CB_LEN, sizeof(complex), 0);
-
 	pthread_mutex_init(&m_u_mutex, 0);
 
 }
@@ -63,7 +61,6 @@ usrp_source::~usrp_source() {
 
 	stop();
 	pthread_mutex_destroy(&m_u_mutex);
-	delete m_cb;
 }
 
 
@@ -89,10 +86,28 @@ void usrp_source::start() {
 }
 
 
-double usrp_source::sample_rate() {
+/*
+ * Change the sample rate.  Stop streaming first; whatever was buffered at the
+ * old rate is dropped.
+ */
+int usrp_source::set_sample_rate(const double sample_rate) {
+
+	lock();
+	if(!m_u) {
+		unlock();
+		fprintf(stderr, "error: set_sample_rate: device not open\n");
+		return -1;
+	}
+	m_desired_sample_rate = sample_rate;
+	m_u->set_rx_rate(m_desired_sample_rate);
+	m_sample_rate = m_u->get_rx_rate();
+	m_clock.set_sps(m_sample_rate / GSM_RATE);
+	m_nco.set_sample_rate(m_sample_rate);
+	unlock();
 
-	return m_sample_rate;
+	flush();
 
+	return 0;
 }
 
 
@@ -151,6 +166,10 @@ int usrp_source::fast_tune(double freq) {
  */
 
 
+/*
+ * The carrier offset the NCO takes out belongs to the carrier we were on, so
+ * it starts over at zero.
+ */
 int usrp_source::tune(double freq) {
 
 	static const double MAX_ALLOWED_ERROR = 1.0; // Hz
@@ -159,6 +178,7 @@ int usrp_source::tune(double freq) {
 
 	lock();
 	tr = m_u->set_rx_freq(freq);
+	m_nco.set_freq(0.0);
 	unlock();
 
 	if(std::abs(tr.target_dsp_freq - tr.actual_dsp_freq) > MAX_ALLOWED_ERROR)
@@ -281,6 +301,8 @@ int usrp_source::open() {
 			m_u->set_master_clock_rate(m_fpga_master_clock_freq);
 		m_u->set_rx_rate(m_desired_sample_rate);
 		m_sample_rate = m_u->get_rx_rate();
+		m_clock.set_sps(m_sample_rate / GSM_RATE);
+		m_nco.set_sample_rate(m_sample_rate);
 
 		if(m_two_series) {
 			uhd::clock_config_t clock_config;
@@ -338,6 +360,9 @@ int usrp_source::fill(unsigned int num_samples, unsigned int *overrun_o) {
 		for(unsigned int i = 0; i < r; i++)
 			c[i] *= 32767.0;
 
+		// take out the carrier offset we know about
+		m_nco.mix(c, r);
+
 		if((m_cb->data_available() == 0) && (metadata.has_time_spec))
 			m_packet_time = metadata.time_spec;
 
@@ -381,19 +406,13 @@ int usrp_source::read(complex *buf, unsigned int num_samples, unsigned int *samp
 }
 
 
-circular_buffer *usrp_source::get_buffer() {
-
-	return m_cb;
-}
-
-
 int usrp_source::flush() {
 
 	unsigned int space;
 	complex *c;
 	uhd::rx_metadata_t metadata;
 
-	m_cb->flush();
+	sample_source::flush();
 	m_packet_time = 0.0;
 
 	// get complex<float> buffer just to put samples somewhere
@@ -428,9 +447,3 @@ double usrp_source::get_packet_time() {
 	
 	return m_packet_time.get_real_secs();
 }
-
-void usrp_source::get_fn_ts(int *fn, int *ts) {
-
-	*fn = m_fn;
-	*ts = m_ts;
-}
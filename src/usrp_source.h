@@ -30,10 +30,10 @@
 #include <uhd/types/time_spec.hpp>
 
 #include "usrp_complex.h"
-#include "circular_buffer.h"
+#include "sample_source.h"
 
 
-class usrp_source {
+class usrp_source : public sample_source {
 public:
 	usrp_source(double sample_rate, char *device_address = 0, long int fpga_master_clock_freq = 0, bool external_ref = false);
 	~usrp_source();
@@ -57,15 +57,12 @@ public:
 	void set_subdev(int ss);
 	char *get_subdev_name();
 
-	double sample_rate();
+	int set_sample_rate(const double sample_rate);
 	double band_center();
 
 	void set_usrp2();
 
-	circular_buffer *get_buffer();
-
 	double get_packet_time();
-	void get_fn_ts(int *fn, int *ts);
 
 	static const unsigned int side_A = 0;
 	static const unsigned int side_B = 1;
@@ -80,7 +77,6 @@ private:
 
 	char *			m_device_address;
 
-	double			m_sample_rate;
 	double			m_desired_sample_rate;
 
 	long int		m_fpga_master_clock_freq;
@@ -88,15 +84,11 @@ private:
 
 	double			m_freq_band_center;
 
-	circular_buffer *	m_cb;
-
 	unsigned int		m_recv_samples_per_packet;
 
 	int			m_two_series;
 
 	uhd::time_spec_t	m_packet_time;
-	int			m_fn;
-	int			m_ts;
 
 	/*
 	 * This mutex protects access to the USRP and daughterboards but not
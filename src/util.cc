@@ -96,7 +96,7 @@ static int compare(const void *a, const void *b) {
 void sort(float *b, unsigned int len) {
 
 #ifdef HAVE_QSORT
-	qsort(b, sizeof(float), len, compare);
+	qsort(b, len, sizeof(float), compare);
 #else
 	return bubble_sort(b, len);
 #endif /* HAVE_QSORT */
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <string.h>
+#include "gsm_bursts.h"
+#include "xcch.h"
+
+
+/*
+ * Control channels (BCCH, CCCH, SDCCH, SACCH), 45.003 section 4.1.
+ *
+ * 184 data bits are protected by a 40 bit Fire code and 4 tail bits, encoded
+ * at rate 1/2 into 456 bits and interleaved over the 114 data bits of 4
+ * normal bursts.
+ */
+static const unsigned int DATA_BITS		= 8 * XCCH_L2_LEN;
+static const unsigned int PARITY_BITS		= 40;
+static const unsigned int TAIL_BITS		= 4;
+static const unsigned int CONV_INPUT_SIZE	= DATA_BITS + PARITY_BITS + TAIL_BITS;
+static const unsigned int CONV_SIZE		= 2 * CONV_INPUT_SIZE;
+static const unsigned int BURST_BITS		= CONV_SIZE / XCCH_BURSTS;
+static const unsigned int K			= 5;
+static const unsigned int STATES		= 1 << (K - 1);
+static const int MAX_METRIC			= 2 * CONV_SIZE * LLR_MAX + 1;
+
+/*
+ * Fire code
+ *
+ * 	g(x) = (x^23 + 1)(x^17 + x^3 + 1) = x^40 + x^26 + x^23 + x^17 + x^3 + 1
+ *
+ * The remainder of the data followed by the parity is 1 + x + ... + x^39.
+ */
+static const uint64_t fire_polynomial	= 0x0004820009ULL;
+static const uint64_t fire_mask		= 0xffffffffffULL;
+
+
+/*
+ * Remainder of d(x) x^40 with the first data bit the highest power.  Bit 39
+ * of the result is the first parity bit.
+ */
+static uint64_t fire_remainder(const unsigned char *d) {
+
+	unsigned int i;
+	uint64_t r = 0, fb;
+
+	for(i = 0; i < DATA_BITS; i++) {
+		fb = ((r >> (PARITY_BITS - 1)) & 1) ^ d[i];
+		r = (r << 1) & fire_mask;
+		if(fb)
+			r ^= fire_polynomial;
+	}
+	return r;
+}
+
+
+/*
+ * Where coded bit k goes: burst k mod 4, bit 2((49k) mod 57) + ((k mod 8) div
+ * 4) of its 114 data bits.  The data bits are either side of the stealing
+ * flags, which are not part of the code.
+ */
+static inline unsigned int interleave_burst(const unsigned int k) {
+
+	return k % XCCH_BURSTS;
+}
+
+
+static inline unsigned int interleave_bit(const unsigned int k) {
+
+	unsigned int j = 2 * ((49 * k) % 57) + ((k % 8) / 4);
+
+	return (j < BURST_BITS / 2)? N_EDATA_OS_1 + j : N_EDATA_OS_2 + 1 + j - BURST_BITS / 2;
+}
+
+
+/*
+ * The coder state holds the previous 4 input bits, u_{k - 1} in bit 3.
+ *
+ * 	c_{2k} = u_k + u_{k - 3} + u_{k - 4}
+ * 	c_{2k + 1} = u_k + u_{k - 1} + u_{k - 3} + u_{k - 4}
+ */
+static inline unsigned int conv_output(const unsigned int state, const unsigned int b) {
+
+	unsigned int c0, c1;
+
+	c0 = b ^ ((state >> 1) & 1) ^ (state & 1);
+	c1 = c0 ^ ((state >> 3) & 1);
+	return (c0 << 1) | c1;
+}
+
+
+static void conv_encode(const unsigned char *u, unsigned char *c) {
+
+	unsigned int k, state = 0, o;
+
+	for(k = 0; k < CONV_INPUT_SIZE; k++) {
+		o = conv_output(state, u[k]);
+		c[2 * k] = o >> 1;
+		c[2 * k + 1] = o & 1;
+		state = (state >> 1) | (u[k] << (K - 2));
+	}
+}
+
+
+/*
+ * Cost of deciding bit b when the soft value is l.
+ */
+static inline int llr_cost(const unsigned int b, const int l) {
+
+	if(b)
+		return (l > 0)? l : 0;
+	return (l < 0)? -l : 0;
+}
+
+
+/*
+ * Soft decision Viterbi decoding.  The coder starts and, thanks to the tail
+ * bits, ends in state 0.
+ */
+static void conv_decode_llr(const llr_t *c, unsigned char *u) {
+
+	unsigned int t, state, nstate, b, o;
+	int ae[STATES], nae[STATES], bm[4], e;
+	unsigned char history[CONV_INPUT_SIZE][STATES];
+
+	for(state = 0; state < STATES; state++)
+		ae[state] = MAX_METRIC;
+	ae[0] = 0;
+
+	for(t = 0; t < CONV_INPUT_SIZE; t++) {
+
+		// branch metric for each possible output pair, c_{2t} in bit 1
+		for(o = 0; o < 4; o++)
+			bm[o] = llr_cost(o >> 1, c[2 * t]) + llr_cost(o & 1, c[2 * t + 1]);
+
+		for(state = 0; state < STATES; state++)
+			nae[state] = MAX_METRIC;
+		for(state = 0; state < STATES; state++) {
+			if(ae[state] >= MAX_METRIC)
+				continue;
+			for(b = 0; b < 2; b++) {
+				nstate = (state >> 1) | (b << (K - 2));
+				e = ae[state] + bm[conv_output(state, b)];
+				if(e < nae[nstate]) {
+					nae[nstate] = e;
+					history[t][nstate] = state;
+				}
+			}
+		}
+		memcpy(ae, nae, sizeof(ae));
+	}
+
+	// trace back from state 0, the input bit is the top bit of each state
+	state = 0;
+	for(t = CONV_INPUT_SIZE; t > 0; t--) {
+		u[t - 1] = state >> (K - 2);
+		state = history[t - 1][state];
+	}
+}
+
+
+/*
+ * Encode 23 octets of layer 2 data into the data bits of 4 bursts.
+ *
+ * 	bursts	DATA_LEN bits each (tail to tail), only the data bits are
+ * 		written
+ *
+ * Octets are sent least significant bit first.
+ */
+void encode_xcch(const uint8_t *l2, unsigned char * const *bursts) {
+
+	unsigned int i, k;
+	uint64_t r;
+	unsigned char u[CONV_INPUT_SIZE], c[CONV_SIZE];
+
+	for(i = 0; i < DATA_BITS; i++)
+		u[i] = (l2[i / 8] >> (i % 8)) & 1;
+	r = fire_remainder(u) ^ fire_mask;
+	for(i = 0; i < PARITY_BITS; i++)
+		u[DATA_BITS + i] = (r >> (PARITY_BITS - 1 - i)) & 1;
+	for(i = 0; i < TAIL_BITS; i++)
+		u[DATA_BITS + PARITY_BITS + i] = 0;
+
+	conv_encode(u, c);
+	for(k = 0; k < CONV_SIZE; k++)
+		bursts[interleave_burst(k)][interleave_bit(k)] = c[k];
+}
+
+
+/*
+ * decode_xcch
+ *
+ * 	bursts	soft bits of the 4 bursts of a block in order, as handed to
+ * 		a burst_cb_t
+ * 	l2	23 octets, written even if the block doesn't check
+ * 	biterr	coded bits whose hard decision disagrees with the decoded
+ * 		block
+ *
+ * 	returns	0 if the Fire code checks
+ */
+int decode_xcch(const llr_t * const *bursts, uint8_t *l2, int *biterr_o) {
+
+	unsigned int i, k;
+	int biterr;
+	uint64_t r, p;
+	llr_t c[CONV_SIZE];
+	unsigned char u[CONV_INPUT_SIZE], re[CONV_SIZE];
+
+	for(k = 0; k < CONV_SIZE; k++)
+		c[k] = bursts[interleave_burst(k)][interleave_bit(k)];
+
+	conv_decode_llr(c, u);
+
+	memset(l2, 0, XCCH_L2_LEN);
+	for(i = 0; i < DATA_BITS; i++)
+		l2[i / 8] |= u[i] << (i % 8);
+
+	if(biterr_o) {
+		conv_encode(u, re);
+		for(biterr = 0, k = 0; k < CONV_SIZE; k++)
+			if(re[k] != (c[k] < 0))
+				biterr += 1;
+		*biterr_o = biterr;
+	}
+
+	for(p = 0, i = 0; i < PARITY_BITS; i++)
+		p = (p << 1) | u[DATA_BITS + i];
+	r = fire_remainder(u);
+
+	return ((r ^ p) == fire_mask)? 0 : -1;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+#include "bitvec.h"
+
+static const unsigned int XCCH_BURSTS		= 4;	// bursts in a block
+static const unsigned int XCCH_L2_LEN		= 23;	// octets of layer 2 data in a block
+
+void encode_xcch(const uint8_t *l2, unsigned char * const *bursts);
+int decode_xcch(const llr_t * const *bursts, uint8_t *l2, int *biterr_o = 0);